@@ -0,0 +1,35 @@
+//***************************************************************************************
+// Windows.h (benchmark compatibility shim)
+//
+// The simulation and geometry sources include <Windows.h> only for its integer
+// typedefs.  On non-Windows hosts the benchmark puts this directory first on the
+// include path so those sources build unchanged.  Never used on Windows.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_WIN32)
+#error "compat/Windows.h must not be used on Windows builds"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+typedef unsigned char BYTE;
+typedef unsigned short USHORT;
+typedef unsigned short WORD;
+typedef unsigned int UINT;
+typedef std::uint32_t DWORD;
+typedef int BOOL;
+typedef std::int32_t LONG;
+typedef std::int32_t HRESULT;
+typedef std::uint64_t UINT64;
+typedef std::int64_t INT64;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
@@ -0,0 +1,37 @@
+//***************************************************************************************
+// sal.h (benchmark compatibility shim)
+//
+// DirectXMath annotates its API with Microsoft SAL, which only the MSVC code
+// analyzer understands.  Outside Windows the annotations expand to nothing.
+//***************************************************************************************
+
+#pragma once
+
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_reads_(s)
+#define _In_reads_opt_(s)
+#define _In_reads_bytes_(s)
+#define _In_range_(lb, ub)
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(s)
+#define _Out_writes_opt_(s)
+#define _Out_writes_all_(s)
+#define _Out_writes_bytes_(s)
+#define _Out_writes_to_(s, c)
+#define _Out_writes_bytes_to_(s, c)
+#define _Out_range_(lb, ub)
+#define _Inout_
+#define _Inout_opt_
+#define _Inout_updates_(s)
+#define _Inout_updates_bytes_(s)
+#define _Outptr_
+#define _Outptr_opt_
+#define _Ret_maybenull_
+#define _Check_return_
+#define _Success_(e)
+#define _Analysis_assume_(e)
+#define _Use_decl_annotations_
+#define _Printf_format_string_
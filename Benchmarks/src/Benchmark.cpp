@@ -0,0 +1,220 @@
+//=======================================================================================
+// Benchmark.cpp
+//=======================================================================================
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<unsigned long long> g_AllocationCount(0);
+    std::atomic<unsigned long long> g_AllocatedBytes(0);
+
+    void* CountedAlloc(std::size_t size)
+    {
+        g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+        g_AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+        return std::malloc(size ? size : 1);
+    }
+
+    // Nearest-rank percentile of sorted samples.
+    double Percentile(const std::vector<double>& sorted, double q)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+        return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+    }
+
+    void WriteJsonString(std::ostream& out, const std::string& s)
+    {
+        out << '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out << '\\' << c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            }
+            else
+            {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    void* p = CountedAlloc(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+Benchmark::Benchmark(const Options& options)
+    : m_Options(options)
+{
+}
+
+void Benchmark::Run(const std::string& group, const std::string& name, const std::string& params,
+    const Work& work, const std::function<void()>& body, const std::function<void()>& setup)
+{
+    std::string id = group + "/" + name + "/" + params;
+    if (!m_Options.Filter.empty() && id.find(m_Options.Filter) == std::string::npos)
+    {
+        return;
+    }
+
+    std::fprintf(stderr, "%-48s", id.c_str());
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<double> samples;
+    samples.reserve(m_Options.MinIterations);
+
+    unsigned long long allocationCount = 0;
+    unsigned long long allocatedBytes = 0;
+    double totalNs = 0.0;
+
+    while (samples.size() < m_Options.MaxIterations &&
+        (samples.size() < m_Options.MinIterations || totalNs < m_Options.MinSeconds * 1.0e9))
+    {
+        if (setup)
+        {
+            setup();
+        }
+
+        unsigned long long countBefore = AllocationCount();
+        unsigned long long bytesBefore = AllocatedBytes();
+        Clock::time_point start = Clock::now();
+
+        body();
+
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        allocationCount += AllocationCount() - countBefore;
+        allocatedBytes += AllocatedBytes() - bytesBefore;
+
+        samples.push_back(ns);
+        totalNs += ns;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.Group = group;
+    result.Name = name;
+    result.Params = params;
+    result.PerIteration = work;
+    result.Iterations = static_cast<unsigned>(samples.size());
+    result.MinNs = samples.front();
+    result.MeanNs = totalNs / samples.size();
+    result.P50Ns = Percentile(samples, 0.50);
+    result.P99Ns = Percentile(samples, 0.99);
+    result.AllocationsPerIteration = static_cast<double>(allocationCount) / samples.size();
+    result.AllocatedBytesPerIteration = static_cast<double>(allocatedBytes) / samples.size();
+    m_Results.push_back(result);
+
+    std::fprintf(stderr, " p50 %12.0f ns  p99 %12.0f ns  %8u iters\n", result.P50Ns, result.P99Ns, result.Iterations);
+}
+
+void Benchmark::WriteJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context) const
+{
+    out << "{\n  \"context\": {";
+    for (size_t i = 0; i < context.size(); ++i)
+    {
+        out << (i ? ",\n    " : "\n    ");
+        WriteJsonString(out, context[i].first);
+        out << ": ";
+        WriteJsonString(out, context[i].second);
+    }
+    out << "\n  },\n  \"results\": [";
+
+    for (size_t i = 0; i < m_Results.size(); ++i)
+    {
+        const Result& r = m_Results[i];
+        double seconds = r.P50Ns * 1.0e-9;
+
+        out << (i ? ",\n    {" : "\n    {");
+        out << "\"group\": ";
+        WriteJsonString(out, r.Group);
+        out << ", \"name\": ";
+        WriteJsonString(out, r.Name);
+        out << ", \"params\": ";
+        WriteJsonString(out, r.Params);
+        out << ", \"iterations\": " << r.Iterations;
+        out << ", \"min_ns\": " << r.MinNs;
+        out << ", \"mean_ns\": " << r.MeanNs;
+        out << ", \"p50_ns\": " << r.P50Ns;
+        out << ", \"p99_ns\": " << r.P99Ns;
+        out << ", \"unit\": ";
+        WriteJsonString(out, r.PerIteration.ItemName);
+        out << ", \"items_per_iteration\": " << r.PerIteration.Items;
+        out << ", \"items_per_second\": " << (seconds > 0.0 ? r.PerIteration.Items / seconds : 0.0);
+        out << ", \"bytes_per_iteration\": " << r.PerIteration.Bytes;
+        out << ", \"gb_per_second\": " << (seconds > 0.0 ? r.PerIteration.Bytes / seconds * 1.0e-9 : 0.0);
+        out << ", \"allocations_per_iteration\": " << r.AllocationsPerIteration;
+        out << ", \"allocated_bytes_per_iteration\": " << r.AllocatedBytesPerIteration;
+        out << "}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+unsigned long long Benchmark::AllocationCount()
+{
+    return g_AllocationCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long Benchmark::AllocatedBytes()
+{
+    return g_AllocatedBytes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+//***************************************************************************************
+// Benchmark.h
+//
+// A small harness for the headless benchmarks.  Each case is run repeatedly and
+// timed per iteration; the heap allocations made while it runs are counted by
+// replacing the global operator new; the results are written as JSON.
+//***************************************************************************************
+
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+class Benchmark
+{
+public:
+    struct Options
+    {
+        Options() : MinSeconds(0.25), MinIterations(20), MaxIterations(100000) {}
+
+        // Each case runs until both minimums are met, or MaxIterations is reached.
+        double MinSeconds;
+        unsigned MinIterations;
+        unsigned MaxIterations;
+
+        // Only cases whose "group/name/params" contains this substring run.
+        std::string Filter;
+    };
+
+    // Describes the work one iteration does, for the throughput figures.
+    struct Work
+    {
+        Work() : Items(0.0), Bytes(0.0) {}
+        Work(const char* itemName, double items, double bytes) : ItemName(itemName), Items(items), Bytes(bytes) {}
+
+        std::string ItemName;   // "cells", "vertices", ...
+        double Items;
+        double Bytes;           // Bytes the iteration must read plus write.
+    };
+
+    struct Result
+    {
+        std::string Group;
+        std::string Name;
+        std::string Params;
+        Work PerIteration;
+
+        unsigned Iterations;
+        double MinNs;
+        double MeanNs;
+        double P50Ns;
+        double P99Ns;
+
+        double AllocationsPerIteration;
+        double AllocatedBytesPerIteration;
+    };
+
+public:
+    explicit Benchmark(const Options& options);
+
+    // Runs body until the options are satisfied.  setup, if given, runs untimed
+    // before every iteration.
+    void Run(const std::string& group, const std::string& name, const std::string& params,
+        const Work& work, const std::function<void()>& body,
+        const std::function<void()>& setup = std::function<void()>());
+
+    const std::vector<Result>& Results() const { return m_Results; }
+
+    // Writes {"context": {...}, "results": [...]}; items_per_second and
+    // gb_per_second use the p50 time.
+    void WriteJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context) const;
+
+    // Heap allocations made through operator new since the process started.
+    static unsigned long long AllocationCount();
+    static unsigned long long AllocatedBytes();
+
+private:
+    Options m_Options;
+    std::vector<Result> m_Results;
+};
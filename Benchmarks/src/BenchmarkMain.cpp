@@ -0,0 +1,1029 @@
+//=======================================================================================
+// BenchmarkMain.cpp
+//
+// Headless benchmarks for the wave simulation, the wave clipmap, buoyancy, the
+// spectral ocean, the procedural geometry and the text mesh loader.  Needs no window
+// or GPU, so it runs on the Linux build boxes.
+//
+//   WavesBenchmark [--out results.json] [--filter substring] [--min-time seconds]
+//                  [--data directory] [--quick]
+//
+// Results go to stdout as JSON unless --out is given; progress goes to stderr.
+//=======================================================================================
+
+#include "Benchmark.h"
+#include "Waves.h"
+#include "FixedWaves.h"
+#include "CompactWaves.h"
+#include "WaveClipmap.h"
+#include "WaveBuoyancy.h"
+#include "WaveSnapshot.h"
+#include "SpectralOcean.h"
+#include "WorkerPool.h"
+#include "GeometryGenerator.h"
+#include "HillTerrain.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef BENCHMARK_DATA_DIR
+#define BENCHMARK_DATA_DIR "."
+#endif
+
+namespace
+{
+    // Demo wave parameters (WaveModel::InitializeBuffers).
+    constexpr float WaveSpatialStep = 1.0f;
+    constexpr float WaveTimeStep = 0.03f;
+    constexpr float WaveSpeed = 3.25f;
+    constexpr float WaveDamping = 0.4f;
+
+    constexpr WaveConstants DemoWaveConstants(WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+    static_assert(DemoWaveConstants.IsStable(), "Demo wave parameters are unstable.");
+
+    // One step streams the previous and current heights through the stencil and
+    // writes the previous heights (12 bytes/cell), then the normal pass reads the
+    // heights and writes three normal and two tangent planes (24 bytes/cell).
+    const double WaveStepBytesPerCell = 36.0;
+
+    const UINT DisturbBatch = 256;
+
+    const UINT SampleBatch = 4096;
+
+    // CompactWaves steps the 16-bit heights like Waves (6 bytes/cell) and the normal
+    // pass reads them and writes one packed normal (6 bytes/cell).
+    const double CompactStepBytesPerCell = 12.0;
+
+    typedef std::vector<std::pair<std::string, std::string>> Context;
+
+    std::string GridParams(UINT n)
+    {
+        std::ostringstream ss;
+        ss << n << "x" << n;
+        return ss.str();
+    }
+
+    // Written and removed by the checkpoint cases.  In the temporary directory, so a
+    // run that is cut short leaves nothing in the working directory.
+    std::string CheckpointPath()
+    {
+#if defined(_WIN32)
+        const char* dir = std::getenv("TEMP");
+        const char* fallback = ".";
+#else
+        const char* dir = std::getenv("TMPDIR");
+        const char* fallback = "/tmp";
+#endif
+        return std::string(dir && *dir ? dir : fallback) + "/WavesBenchmark.checkpoint";
+    }
+
+    double MeshBytes(const GeometryGenerator::MeshData& mesh)
+    {
+        return static_cast<double>(mesh.Vertices.size() * sizeof(GeometryGenerator::Vertex) +
+            mesh.Indices.size() * sizeof(UINT));
+    }
+
+    // Runs one Create* call once to size the work, then benchmarks it.
+    template<typename Create>
+    void RunGeometry(Benchmark& bench, const char* name, const std::string& params, const Create& create)
+    {
+        GeometryGenerator::MeshData mesh;
+        create(mesh);
+
+        Benchmark::Work work("vertices", static_cast<double>(mesh.Vertices.size()), MeshBytes(mesh));
+        bench.Run("geometry", name, params, work, [&]()
+        {
+            GeometryGenerator::MeshData out;
+            create(out);
+        });
+    }
+
+    void RunWaves(Benchmark& bench, const std::vector<UINT>& sizes, WorkerPool& pool)
+    {
+        for (UINT n : sizes)
+        {
+            std::string params = GridParams(n);
+            double cells = static_cast<double>(n) * n;
+
+            {
+                Waves waves;
+                bench.Run("waves", "Init", params, Benchmark::Work("cells", cells, 7.0 * sizeof(float) * cells), [&]()
+                {
+                    waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                });
+            }
+
+            {
+                // A warmed-up sea state saved once, then restored.  Loading maps the
+                // file, so its cost is flat; the first Update after it pays for
+                // reading the pages it touches.
+                Waves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                waves.Disturb(n / 2, n / 2, 1.0f);
+                waves.Step(64);
+
+                const std::string checkpointPath = CheckpointPath();
+                double planeBytes = 7.0 * sizeof(float) * waves.RowPitch() * n;
+                bench.Run("waves", "SaveCheckpoint", params, Benchmark::Work("cells", cells, planeBytes), [&]()
+                {
+                    waves.SaveCheckpoint(checkpointPath.c_str());
+                });
+
+                Waves restored;
+                bench.Run("waves", "LoadCheckpoint", params, Benchmark::Work("cells", cells, 0.0), [&]()
+                {
+                    restored.LoadCheckpoint(checkpointPath.c_str());
+                });
+
+                bench.Run("waves", "LoadCheckpoint/Update", params,
+                    Benchmark::Work("cells", cells, WaveStepBytesPerCell * cells), [&]()
+                {
+                    restored.LoadCheckpoint(checkpointPath.c_str());
+                    restored.Update(restored.TimeStep());
+                });
+
+                std::remove(checkpointPath.c_str());
+            }
+
+            struct Variant
+            {
+                const char* Name;
+                WavesKernels::Isa Isa;
+                bool Parallel;
+            };
+
+            const Variant variants[] =
+            {
+                { "Update/scalar", WavesKernels::Isa::Scalar, false },
+                { "Update", WavesKernels::Isa::AVX512, false },
+                { "Update/pool", WavesKernels::Isa::AVX512, true },
+            };
+
+            for (const Variant& variant : variants)
+            {
+                Waves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                waves.SetKernelIsa(variant.Isa);
+                waves.SetWorkerPool(variant.Parallel ? &pool : nullptr);
+                waves.Disturb(n / 2, n / 2, 1.0f);
+
+                // One fixed step per call.
+                bench.Run("waves", variant.Name, params,
+                    Benchmark::Work("cells", cells, WaveStepBytesPerCell * cells), [&]()
+                {
+                    waves.Update(waves.TimeStep());
+                });
+            }
+
+            {
+                // Update writing straight into an interleaved Position/Normal vertex array.
+                Waves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                waves.Disturb(n / 2, n / 2, 1.0f);
+
+                std::vector<XMFLOAT3> vertices(2 * waves.VertexCount());
+                Waves::VertexStream stream;
+                stream.Data = vertices.data();
+                stream.Stride = 2 * sizeof(XMFLOAT3);
+                stream.PositionOffset = 0;
+                stream.NormalOffset = sizeof(XMFLOAT3);
+
+                bench.Run("waves", "Update/stream", params,
+                    Benchmark::Work("cells", cells, (WaveStepBytesPerCell + stream.Stride) * cells), [&]()
+                {
+                    waves.Update(waves.TimeStep(), &stream);
+                });
+            }
+
+            {
+                Waves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+
+                UINT seed = 1;
+                bench.Run("waves", "Disturb", params, Benchmark::Work("disturbances", DisturbBatch, 0.0), [&]()
+                {
+                    for (UINT k = 0; k < DisturbBatch; ++k)
+                    {
+                        seed = seed * 1664525u + 1013904223u;
+                        UINT i = 2 + (seed >> 8) % (n - 4);
+                        UINT j = 2 + (seed >> 20) % (n - 4);
+                        waves.Disturb(i, j, 0.001f);
+                    }
+                });
+            }
+
+            {
+                // Floating objects scattered over the whole grid, so the gathers
+                // miss cache about as often as they would in a scene.
+                Waves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                waves.Disturb(n / 2, n / 2, 1.0f);
+
+                std::vector<float> x(SampleBatch), z(SampleBatch);
+                std::vector<float> heights(SampleBatch), nx(SampleBatch), ny(SampleBatch), nz(SampleBatch);
+                float extent = 0.5f * (n - 1) * WaveSpatialStep;
+                UINT seed = 1;
+                for (UINT k = 0; k < SampleBatch; ++k)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    x[k] = extent * (2.0f * (seed >> 8) / 16777216.0f - 1.0f);
+                    seed = seed * 1664525u + 1013904223u;
+                    z[k] = extent * (2.0f * (seed >> 8) / 16777216.0f - 1.0f);
+                }
+
+                Waves::SurfaceQuery query;
+                query.X = x.data();
+                query.Z = z.data();
+                query.Count = SampleBatch;
+                query.Heights = heights.data();
+                query.NormalX = nx.data();
+                query.NormalY = ny.data();
+                query.NormalZ = nz.data();
+
+                // 12 gathered heights plus 2 coordinates in and 4 results out per point.
+                bench.Run("waves", "SampleSurface", params,
+                    Benchmark::Work("points", SampleBatch, 18.0 * sizeof(float) * SampleBatch), [&]()
+                {
+                    waves.SampleSurface(query);
+                });
+            }
+        }
+    }
+
+    // The same step cases as RunWaves on a FixedWaves<N, N>, so "Update/fixed" and
+    // "Update" of one size compare the compile-time and runtime sized solvers.
+    template<UINT N>
+    void RunFixedWaves(Benchmark& bench, WorkerPool& pool)
+    {
+        std::string params = GridParams(N);
+        double cells = static_cast<double>(N) * N;
+
+        struct Variant
+        {
+            const char* Name;
+            WavesKernels::Isa Isa;
+            bool Parallel;
+        };
+
+        const Variant variants[] =
+        {
+            { "Update/fixed/scalar", WavesKernels::Isa::Scalar, false },
+            { "Update/fixed", WavesKernels::Isa::AVX512, false },
+            { "Update/fixed/pool", WavesKernels::Isa::AVX512, true },
+        };
+
+        for (const Variant& variant : variants)
+        {
+            FixedWaves<N, N> waves;
+            waves.Init(DemoWaveConstants);
+            waves.SetKernelIsa(variant.Isa);
+            waves.SetWorkerPool(variant.Parallel ? &pool : nullptr);
+            waves.Disturb(N / 2, N / 2, 1.0f);
+
+            bench.Run("waves", variant.Name, params,
+                Benchmark::Work("cells", cells, WaveStepBytesPerCell * cells), [&]()
+            {
+                waves.Update(waves.TimeStep());
+            });
+        }
+    }
+
+    // Steps a CompactWaves per height format, and adds to the report how far its
+    // heights drift from a Waves driven by the same disturbances.
+    void RunCompactWaves(Benchmark& bench, const std::vector<UINT>& sizes, bool quick, WorkerPool& pool,
+        Context& report)
+    {
+        struct Variant
+        {
+            const char* Name;
+            CompactWaves::HeightFormat Format;
+        };
+
+        const Variant variants[] =
+        {
+            { "fixed16", CompactWaves::HeightFormat::Fixed16 },
+            { "half", CompactWaves::HeightFormat::Half },
+        };
+
+        for (const Variant& variant : variants)
+        {
+            for (UINT n : sizes)
+            {
+                double cells = static_cast<double>(n) * n;
+
+                CompactWaves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping, variant.Format);
+                waves.SetWorkerPool(&pool);
+                waves.Disturb(n / 2, n / 2, 1.0f);
+
+                bench.Run("waves", std::string("Update/compact/") + variant.Name, GridParams(n),
+                    Benchmark::Work("cells", cells, CompactStepBytesPerCell * cells), [&]()
+                {
+                    waves.Update(WaveTimeStep);
+                });
+            }
+        }
+
+        // The demo grid and disturbances: one of magnitude 1-2 every 8 steps (a
+        // quarter second), from a fixed seed.
+        const UINT n = 160;
+        const UINT stepCount = quick ? 500 : 2000;
+
+        for (const Variant& variant : variants)
+        {
+            Waves reference;
+            reference.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+
+            CompactWaves waves;
+            waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping, variant.Format);
+
+            UINT seed = 1;
+            double maxError = 0.0;
+            double sumSquares = 0.0;
+            float peak = 0.0f;
+
+            for (UINT s = 0; s < stepCount; ++s)
+            {
+                if (s % 8 == 0)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    UINT i = 5 + (seed >> 8) % (n - 10);
+                    seed = seed * 1664525u + 1013904223u;
+                    UINT j = 5 + (seed >> 8) % (n - 10);
+                    seed = seed * 1664525u + 1013904223u;
+                    float magnitude = 1.0f + (seed >> 8) / 16777216.0f;
+
+                    reference.Disturb(i, j, magnitude);
+                    waves.Disturb(i, j, magnitude);
+                }
+
+                reference.Step(1);
+                waves.Step(1);
+            }
+
+            for (UINT i = 0; i < n; ++i)
+            {
+                for (UINT j = 0; j < n; ++j)
+                {
+                    double error = std::fabs(static_cast<double>(waves.Height(i, j)) - reference.Height(i, j));
+                    maxError = std::max(maxError, error);
+                    sumSquares += error * error;
+                    peak = std::max(peak, std::fabs(reference.Height(i, j)));
+                }
+            }
+
+            char line[160];
+            std::snprintf(line, sizeof(line), "max %.5f, rms %.5f after %u steps (peak %.3f)",
+                maxError, std::sqrt(sumSquares / (static_cast<double>(n) * n)), stepCount, peak);
+            std::fprintf(stderr, "compact error %-8s %s\n", variant.Name, line);
+
+            report.push_back(std::make_pair(std::string("compact_error/") + variant.Name + "/" + GridParams(n),
+                std::string(line)));
+        }
+    }
+
+    void RunClipmap(Benchmark& bench, bool quick)
+    {
+        // Same water area as one (n-1)*2^(levels-1)+1 grid at the finest spacing,
+        // which the single-grid waves cases time directly.
+        const UINT levelCounts[] = { 1, 3, 5 };
+        const UINT sizes[] = { 65, 129 };
+        for (UINT n : sizes)
+        {
+            for (UINT levelCount : levelCounts)
+            {
+                if (quick && levelCount == 5)
+                {
+                    continue;
+                }
+
+                WaveClipmap clipmap;
+                clipmap.Init(levelCount, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                clipmap.Level(0).Disturb(n / 2, n / 2, 1.0f);
+
+                // Level l steps once every 2^l fine steps.
+                double cells = 0.0;
+                for (UINT level = 0; level < levelCount; ++level)
+                {
+                    cells += static_cast<double>(n) * n / (1u << level);
+                }
+
+                std::ostringstream params;
+                params << GridParams(n) << "x" << levelCount;
+
+                // One finest-level step per call.
+                bench.Run("clipmap", "Update", params.str(),
+                    Benchmark::Work("cells", cells, WaveStepBytesPerCell * cells), [&]()
+                {
+                    clipmap.Update(WaveTimeStep);
+                });
+            }
+        }
+    }
+
+    void RunBuoyancy(Benchmark& bench, WorkerPool& pool)
+    {
+        const UINT n = 256;
+        const UINT bodyCounts[] = { 1000, 10000, 100000 };
+
+        for (UINT bodyCount : bodyCounts)
+        {
+            std::ostringstream params;
+            params << bodyCount << " bodies";
+
+            for (int variant = 0; variant < 3; ++variant)
+            {
+                Waves waves;
+                waves.Init(n, n, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+                waves.Disturb(n / 2, n / 2, 1.0f);
+
+                // Scattered over the whole grid, half in and half out of the water.
+                WaveBuoyancy buoyancy;
+                buoyancy.Reserve(bodyCount);
+                float extent = 0.5f * (n - 1) * WaveSpatialStep;
+                UINT seed = 1;
+                for (UINT k = 0; k < bodyCount; ++k)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    float x = extent * (2.0f * (seed >> 8) / 16777216.0f - 1.0f);
+                    seed = seed * 1664525u + 1013904223u;
+                    float z = extent * (2.0f * (seed >> 8) / 16777216.0f - 1.0f);
+                    buoyancy.AddBody(XMFLOAT3(x, (k & 1) ? 0.0f : 0.4f, z), 0.3f, 0.5f);
+                }
+
+                const char* name = "Step";
+                if (variant == 1)
+                {
+                    name = "Step/pool";
+                    buoyancy.SetWorkerPool(&pool);
+                }
+                else if (variant == 2)
+                {
+                    name = "Step/pool/wakes";
+                    buoyancy.SetWorkerPool(&pool);
+                    WaveBuoyancy::Parameters parameters;
+                    parameters.WakeGain = 0.1f;
+                    parameters.WakeMinSpeed = 0.0f;
+                    buoyancy.SetParameters(parameters);
+                }
+
+                // Wakes go to a list the caller would queue, so repeated steps do not
+                // pile up disturbances on a grid that never steps.
+                WaveSnapshot frame;
+                waves.CaptureSnapshot(frame, Waves::SnapshotFormat::HeightsOnly);
+                std::vector<Waves::Disturbance> wakes;
+
+                // Per body: 12 gathered heights, 14 planes read, 11 written.
+                bench.Run("buoyancy", name, params.str(),
+                    Benchmark::Work("bodies", bodyCount, 37.0 * sizeof(float) * bodyCount), [&]()
+                {
+                    if (variant == 2)
+                    {
+                        wakes.clear();
+                        buoyancy.Step(frame, WaveTimeStep, &wakes);
+                    }
+                    else
+                    {
+                        buoyancy.Step(waves, WaveTimeStep);
+                    }
+                });
+            }
+        }
+    }
+
+    void RunOcean(Benchmark& bench, bool quick, WorkerPool& pool)
+    {
+        const UINT sizes[] = { 128, 256, 512, 1024 };
+        for (UINT n : sizes)
+        {
+            if (quick && n > 256)
+            {
+                continue;
+            }
+
+            // Three inverse 2D FFTs of n x n complex values, each reading and writing
+            // every value once per pass over rows and columns.
+            double cells = static_cast<double>(n) * n;
+            double fftBytes = 3.0 * 2.0 * 2.0 * sizeof(float) * 2.0 * cells;
+
+            for (int parallel = 0; parallel < 2; ++parallel)
+            {
+                SpectralOcean ocean;
+                ocean.SetWorkerPool(parallel ? &pool : nullptr);
+                ocean.Init(n, static_cast<float>(n), SpectralOcean::Parameters());
+
+                bench.Run("ocean", parallel ? "Update/pool" : "Update", GridParams(n),
+                    Benchmark::Work("cells", cells, fftBytes), [&]()
+                {
+                    ocean.Update(1.0f / 60.0f);
+                });
+            }
+        }
+    }
+
+    // Position and color, the vertex layout of the DrawingExamples models.
+    struct ColorVertex
+    {
+        XMFLOAT3 Position;
+        XMFLOAT4 Color;
+    };
+
+    void WriteColorVertex(ColorVertex& out, const GeometryGenerator::Vertex& v)
+    {
+        out.Position = v.Position;
+        out.Color = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    // Fills a model's vertex and index arrays both ways: through a MeshData and a copy
+    // loop, as the models used to, and with the templated Create* writing straight
+    // into them with only positions computed.
+    template<typename Create, typename CreateDirect>
+    void RunVertexLayout(Benchmark& bench, const char* name, const std::string& params,
+        const GeometryGenerator::MeshSize& size, const Create& create, const CreateDirect& createDirect)
+    {
+        std::vector<ColorVertex> vertices(size.VertexCount);
+        std::vector<UINT> indices(size.IndexCount);
+
+        double bytes = static_cast<double>(size.VertexCount * sizeof(ColorVertex) + size.IndexCount * sizeof(UINT));
+        Benchmark::Work work("vertices", static_cast<double>(size.VertexCount), bytes);
+
+        bench.Run("geometry", name, params + "/copy", work, [&]()
+        {
+            GeometryGenerator::MeshData mesh;
+            create(mesh);
+
+            for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+            {
+                WriteColorVertex(vertices[i], mesh.Vertices[i]);
+            }
+
+            std::copy(mesh.Indices.begin(), mesh.Indices.end(), indices.begin());
+        });
+
+        bench.Run("geometry", name, params + "/direct", work, [&]()
+        {
+            createDirect(vertices.data(), indices.data());
+        });
+    }
+
+    // Builds a batch of small primitives the way a scene load would, each into its own
+    // MeshData.  With an arena, the meshes come out of one buffer sized up front by
+    // ArenaBytes, so an iteration should make no heap allocations at all.
+    void RunGeometryBatch(Benchmark& bench, UINT batchSize, bool useArena)
+    {
+        GeometryGenerator geoGen;
+
+        GeometryGenerator::MeshSize sizes[] =
+        {
+            GeometryGenerator::BoxSize(),
+            GeometryGenerator::SphereSize(20, 20),
+            GeometryGenerator::CylinderSize(20, 20),
+            GeometryGenerator::GridSize(20, 20),
+            GeometryGenerator::GeosphereSize(2)
+        };
+
+        const UINT kindCount = sizeof(sizes) / sizeof(sizes[0]);
+
+        size_t arenaBytes = 0;
+        double vertexCount = 0.0;
+        double meshBytes = 0.0;
+        for (UINT i = 0; i < batchSize; ++i)
+        {
+            const GeometryGenerator::MeshSize& size = sizes[i % kindCount];
+            arenaBytes += GeometryGenerator::ArenaBytes(size);
+            if (i % kindCount == 4)
+            {
+                arenaBytes += GeometryGenerator::GeosphereScratchBytes(2);
+            }
+            vertexCount += size.VertexCount;
+            meshBytes += size.VertexCount * sizeof(GeometryGenerator::Vertex) + size.IndexCount * sizeof(UINT);
+        }
+
+        std::vector<BYTE> buffer(arenaBytes);
+        std::vector<GeometryGenerator::MeshData> meshes;
+        meshes.reserve(batchSize);
+
+        std::ostringstream params;
+        params << batchSize << (useArena ? "/arena" : "/heap");
+
+        Benchmark::Work work("vertices", vertexCount, meshBytes);
+        bench.Run("geometry", "CreateBatch", params.str(), work, [&]()
+        {
+            MeshArena arena(buffer.data(), buffer.size());
+
+            meshes.clear();
+            for (UINT i = 0; i < batchSize; ++i)
+            {
+                if (useArena)
+                {
+                    meshes.emplace_back(arena);
+                }
+                else
+                {
+                    meshes.emplace_back();
+                }
+
+                GeometryGenerator::MeshData& mesh = meshes.back();
+                switch (i % kindCount)
+                {
+                case 0: geoGen.CreateBox(1.0f, 1.0f, 1.0f, mesh); break;
+                case 1: geoGen.CreateSphere(1.0f, 20, 20, mesh); break;
+                case 2: geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, 20, 20, mesh); break;
+                case 3: geoGen.CreateGrid(10.0f, 10.0f, 20, 20, mesh); break;
+                default: geoGen.CreateGeosphere(1.0f, 2, mesh); break;
+                }
+            }
+
+            // Before the arena goes out of scope.
+            meshes.clear();
+        });
+    }
+
+    // Position and normal, the vertex layout of the LightingExamples land.
+    struct HillVertex
+    {
+        XMFLOAT3 Position;
+        XMFLOAT3 Normal;
+    };
+
+    // Raises an n x n grid onto the hills: vertex by vertex through Height() and
+    // Normal(), as WaveModel used to, then with HillTerrain's row kernels.
+    void RunHillTerrain(Benchmark& bench, bool quick, WorkerPool& pool)
+    {
+        const UINT sizes[] = { 160, 1024, 4096 };
+        for (UINT n : sizes)
+        {
+            if (quick && n > 1024)
+            {
+                continue;
+            }
+
+            GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(n, n);
+            std::vector<HillVertex> vertices(size.VertexCount);
+            std::vector<UINT> indices(size.IndexCount);
+
+            double bytes = static_cast<double>(size.VertexCount * sizeof(HillVertex) + size.IndexCount * sizeof(UINT));
+            Benchmark::Work work("vertices", static_cast<double>(size.VertexCount), bytes);
+
+            GeometryGenerator geoGen;
+            bench.Run("geometry", "HillTerrain/pervertex", GridParams(n), work, [&]()
+            {
+                geoGen.CreateGrid<GeometryGenerator::PositionOnly>(160.0f, 160.0f, n, n, vertices.data(), indices.data(),
+                    [](HillVertex& out, const GeometryGenerator::Vertex& v)
+                {
+                    out.Position = XMFLOAT3(v.Position.x, HillTerrain::Height(v.Position.x, v.Position.z), v.Position.z);
+                    out.Normal = HillTerrain::Normal(v.Position.x, v.Position.z);
+                });
+            });
+
+            struct Variant
+            {
+                const char* Name;
+                WavesKernels::Isa Isa;
+                bool Parallel;
+            };
+
+            const Variant variants[] =
+            {
+                { "HillTerrain/scalar", WavesKernels::Isa::Scalar, false },
+                { "HillTerrain", WavesKernels::Isa::AVX512, false },
+                { "HillTerrain/pool", WavesKernels::Isa::AVX512, true },
+            };
+
+            for (const Variant& variant : variants)
+            {
+                HillTerrain terrain;
+                terrain.SetKernelIsa(variant.Isa);
+                terrain.SetWorkerPool(variant.Parallel ? &pool : nullptr);
+
+                bench.Run("geometry", variant.Name, GridParams(n), work, [&]()
+                {
+                    terrain.BuildGrid(160.0f, 160.0f, n, n, &vertices[0].Position, &vertices[0].Normal,
+                        sizeof(HillVertex), indices.data());
+                });
+            }
+        }
+    }
+
+    void RunGeometry(Benchmark& bench, bool quick)
+    {
+        GeometryGenerator geoGen;
+
+        RunGeometry(bench, "CreateBox", "1x1x1", [&](GeometryGenerator::MeshData& mesh)
+        {
+            geoGen.CreateBox(1.0f, 1.0f, 1.0f, mesh);
+        });
+
+        RunGeometry(bench, "CreateFullscreenQuad", "-", [&](GeometryGenerator::MeshData& mesh)
+        {
+            geoGen.CreateFullscreenQuad(mesh);
+        });
+
+        const UINT tessellations[] = { 20, 80, 320 };
+        for (UINT t : tessellations)
+        {
+            std::string params = GridParams(t);
+
+            RunGeometry(bench, "CreateSphere", params, [&](GeometryGenerator::MeshData& mesh)
+            {
+                geoGen.CreateSphere(1.0f, t, t, mesh);
+            });
+
+            RunGeometry(bench, "CreateCylinder", params, [&](GeometryGenerator::MeshData& mesh)
+            {
+                geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, t, t, mesh);
+            });
+        }
+
+        for (UINT depth = 0; depth <= (quick ? 3u : 7u); ++depth)
+        {
+            RunGeometry(bench, "CreateGeosphere", std::to_string(depth), [&](GeometryGenerator::MeshData& mesh)
+            {
+                geoGen.CreateGeosphere(1.0f, depth, mesh);
+            });
+        }
+
+        const UINT gridSizes[] = { 50, 160, 512, 1024 };
+        for (UINT n : gridSizes)
+        {
+            if (quick && n > 160)
+            {
+                continue;
+            }
+
+            RunGeometry(bench, "CreateGrid", GridParams(n), [&](GeometryGenerator::MeshData& mesh)
+            {
+                geoGen.CreateGrid(160.0f, 160.0f, n, n, mesh);
+            });
+        }
+
+        GeometryGenerator::MeshSize sphereSize = GeometryGenerator::SphereSize(80, 80);
+        RunVertexLayout(bench, "CreateSphere", "80x80", sphereSize, [&](GeometryGenerator::MeshData& mesh)
+        {
+            geoGen.CreateSphere(1.0f, 80, 80, mesh);
+        },
+        [&](ColorVertex* vertices, UINT* indices)
+        {
+            geoGen.CreateSphere<GeometryGenerator::PositionOnly>(1.0f, 80, 80, vertices, indices, WriteColorVertex);
+        });
+
+        GeometryGenerator::MeshSize cylinderSize = GeometryGenerator::CylinderSize(80, 80);
+        RunVertexLayout(bench, "CreateCylinder", "80x80", cylinderSize, [&](GeometryGenerator::MeshData& mesh)
+        {
+            geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, 80, 80, mesh);
+        },
+        [&](ColorVertex* vertices, UINT* indices)
+        {
+            geoGen.CreateCylinder<GeometryGenerator::PositionOnly>(1.0f, 0.5f, 3.0f, 80, 80, vertices, indices, WriteColorVertex);
+        });
+
+        GeometryGenerator::MeshSize geosphereSize = GeometryGenerator::GeosphereSize(5);
+        RunVertexLayout(bench, "CreateGeosphere", "5", geosphereSize, [&](GeometryGenerator::MeshData& mesh)
+        {
+            geoGen.CreateGeosphere(1.0f, 5, mesh);
+        },
+        [&](ColorVertex* vertices, UINT* indices)
+        {
+            geoGen.CreateGeosphere<GeometryGenerator::PositionOnly>(1.0f, 5, vertices, indices, WriteColorVertex);
+        });
+
+        // The direct write again with its scratch memory in an arena: no heap at all.
+        {
+            std::vector<ColorVertex> vertices(geosphereSize.VertexCount);
+            std::vector<UINT> indices(geosphereSize.IndexCount);
+            std::vector<BYTE> buffer(GeometryGenerator::GeosphereScratchBytes(5));
+
+            double bytes = static_cast<double>(vertices.size() * sizeof(ColorVertex) + indices.size() * sizeof(UINT));
+            Benchmark::Work work("vertices", static_cast<double>(geosphereSize.VertexCount), bytes);
+            bench.Run("geometry", "CreateGeosphere", "5/direct/arena", work, [&]()
+            {
+                MeshArena scratch(buffer.data(), buffer.size());
+                geoGen.CreateGeosphere<GeometryGenerator::PositionOnly>(1.0f, 5, vertices.data(), indices.data(),
+                    WriteColorVertex, scratch);
+            });
+        }
+
+        GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(512, 512);
+        RunVertexLayout(bench, "CreateGrid", GridParams(512), gridSize, [&](GeometryGenerator::MeshData& mesh)
+        {
+            geoGen.CreateGrid(160.0f, 160.0f, 512, 512, mesh);
+        },
+        [&](ColorVertex* vertices, UINT* indices)
+        {
+            geoGen.CreateGrid<GeometryGenerator::PositionOnly>(160.0f, 160.0f, 512, 512, vertices, indices, WriteColorVertex);
+        });
+
+        UINT batchSize = quick ? 256 : 4096;
+        RunGeometryBatch(bench, batchSize, false);
+        RunGeometryBatch(bench, batchSize, true);
+    }
+
+    void RunLoaders(Benchmark& bench, const std::string& dataDir)
+    {
+        const char* files[] = { "skull.txt", "car.txt" };
+        for (const char* file : files)
+        {
+            std::string path = dataDir + "/" + file;
+
+            std::ifstream probe(path, std::ios::binary | std::ios::ate);
+            MeshLoader::MeshData mesh;
+            if (!probe.is_open() || !MeshLoader::LoadTextMesh(path.c_str(), mesh))
+            {
+                std::fprintf(stderr, "skipping %s: cannot load\n", path.c_str());
+                continue;
+            }
+
+            double fileBytes = static_cast<double>(probe.tellg());
+            bench.Run("loader", "LoadTextMesh", file,
+                Benchmark::Work("vertices", static_cast<double>(mesh.Positions.size()), fileBytes), [&]()
+            {
+                MeshLoader::MeshData out;
+                MeshLoader::LoadTextMesh(path.c_str(), out);
+            });
+        }
+    }
+
+    // Times the vertex cache pass on one mesh, and adds the FIFO cache figures before
+    // and after both passes to the report.
+    void RunMeshOptimizer(Benchmark& bench, const std::string& params, const UINT* indices, UINT indexCount,
+        UINT vertexCount, Context& report)
+    {
+        std::vector<UINT> optimized(indices, indices + indexCount);
+
+        bench.Run("mesh", "OptimizeVertexCache", params,
+            Benchmark::Work("triangles", indexCount / 3.0, static_cast<double>(indexCount * sizeof(UINT))), [&]()
+        {
+            MeshOptimizer::OptimizeVertexCache(optimized.data(), indexCount, vertexCount);
+        },
+        [&]()
+        {
+            std::copy(indices, indices + indexCount, optimized.begin());
+        });
+
+        std::copy(indices, indices + indexCount, optimized.begin());
+        MeshOptimizer::OptimizeVertexCache(optimized.data(), indexCount, vertexCount);
+
+        std::vector<UINT> remap(vertexCount);
+        MeshOptimizer::BuildFetchRemap(optimized.data(), indexCount, vertexCount, remap.data());
+        MeshOptimizer::RemapIndices(optimized.data(), indexCount, remap.data());
+
+        MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(indices, indexCount, vertexCount);
+        MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(optimized.data(), indexCount, vertexCount);
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "acmr %.3f -> %.3f, atvr %.3f -> %.3f (fifo %u)",
+            before.Acmr, after.Acmr, before.Atvr, after.Atvr, MeshOptimizer::DefaultCacheSize);
+        std::fprintf(stderr, "vertex cache %-35s %s\n", params.c_str(), line);
+
+        report.push_back(std::make_pair("vertex_cache/" + params, std::string(line)));
+    }
+
+    void RunMeshOptimizer(Benchmark& bench, bool quick, const std::string& dataDir, Context& report)
+    {
+        GeometryGenerator geoGen;
+        GeometryGenerator::MeshData mesh;
+
+        // The land and water grids share CreateGrid's index order.
+        const UINT gridSizes[] = { 50, 160, 512 };
+        for (UINT n : gridSizes)
+        {
+            if (quick && n > 160)
+            {
+                continue;
+            }
+
+            geoGen.CreateGrid(160.0f, 160.0f, n, n, mesh);
+            RunMeshOptimizer(bench, "CreateGrid/" + GridParams(n), mesh.Indices.data(),
+                static_cast<UINT>(mesh.Indices.size()), static_cast<UINT>(mesh.Vertices.size()), report);
+        }
+
+        geoGen.CreateSphere(1.0f, 80, 80, mesh);
+        RunMeshOptimizer(bench, "CreateSphere/80x80", mesh.Indices.data(),
+            static_cast<UINT>(mesh.Indices.size()), static_cast<UINT>(mesh.Vertices.size()), report);
+
+        geoGen.CreateGeosphere(1.0f, 5, mesh);
+        RunMeshOptimizer(bench, "CreateGeosphere/5", mesh.Indices.data(),
+            static_cast<UINT>(mesh.Indices.size()), static_cast<UINT>(mesh.Vertices.size()), report);
+
+        const char* files[] = { "skull.txt", "car.txt" };
+        for (const char* file : files)
+        {
+            MeshLoader::MeshData loaded;
+            if (!MeshLoader::LoadTextMesh((dataDir + "/" + file).c_str(), loaded))
+            {
+                continue;
+            }
+
+            RunMeshOptimizer(bench, file, loaded.Indices.data(),
+                static_cast<UINT>(loaded.Indices.size()), static_cast<UINT>(loaded.Positions.size()), report);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Benchmark::Options options;
+    std::string outPath;
+    std::string dataDir = BENCHMARK_DATA_DIR;
+    bool quick = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+        {
+            options.Filter = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc)
+        {
+            options.MinSeconds = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--data") && i + 1 < argc)
+        {
+            dataDir = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--quick"))
+        {
+            quick = true;
+            options.MinSeconds = 0.05;
+            options.MinIterations = 5;
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--out file] [--filter substring] [--min-time seconds] [--data dir] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    WorkerPool pool;
+    Benchmark bench(options);
+
+    std::vector<UINT> waveSizes = { 64, 160, 256, 512, 1024, 2048 };
+    if (quick)
+    {
+        waveSizes = { 64, 160, 512 };
+    }
+
+    std::vector<UINT> compactSizes = { 160, 512, 1024, 2048 };
+    if (quick)
+    {
+        compactSizes = { 160, 512 };
+    }
+
+    RunWaves(bench, waveSizes, pool);
+    RunFixedWaves<64>(bench, pool);
+    RunFixedWaves<160>(bench, pool);
+    RunFixedWaves<512>(bench, pool);
+
+    Context compactErrorReport;
+    RunCompactWaves(bench, compactSizes, quick, pool, compactErrorReport);
+
+    RunClipmap(bench, quick);
+    RunBuoyancy(bench, pool);
+    RunOcean(bench, quick, pool);
+    RunGeometry(bench, quick);
+    RunHillTerrain(bench, quick, pool);
+    RunLoaders(bench, dataDir);
+
+    Context vertexCacheReport;
+    RunMeshOptimizer(bench, quick, dataDir, vertexCacheReport);
+
+    Context context;
+    context.push_back(std::make_pair("benchmark", "WavesBenchmark"));
+    context.push_back(std::make_pair("isa", WavesKernels::IsaName(WavesKernels::DetectIsa())));
+    context.push_back(std::make_pair("pool_threads", std::to_string(pool.ThreadCount())));
+    context.push_back(std::make_pair("hardware_threads", std::to_string(std::thread::hardware_concurrency())));
+    context.push_back(std::make_pair("allocations", "operator new only; Waves planes come from aligned malloc and are not counted"));
+#if defined(__clang__)
+    context.push_back(std::make_pair("compiler", std::string("clang ") + __clang_version__));
+#elif defined(__GNUC__)
+    context.push_back(std::make_pair("compiler", std::string("gcc ") + __VERSION__));
+#elif defined(_MSC_VER)
+    context.push_back(std::make_pair("compiler", "msvc " + std::to_string(_MSC_VER)));
+#endif
+    context.insert(context.end(), compactErrorReport.begin(), compactErrorReport.end());
+    context.insert(context.end(), vertexCacheReport.begin(), vertexCacheReport.end());
+
+    if (outPath.empty())
+    {
+        bench.WriteJson(std::cout, context);
+    }
+    else
+    {
+        std::ofstream out(outPath);
+        bench.WriteJson(out, context);
+    }
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+//=======================================================================================
+// WavesTests.cpp
+//
+// Regression checks for the wave solvers, run by ctest.  Each check prints what went
+// wrong and the program exits non-zero if any failed.
+//
+//   WavesTests
+//=======================================================================================
+
+#include "Waves.h"
+#include "FixedWaves.h"
+#include <cstdio>
+
+namespace
+{
+    // Demo wave parameters (WaveModel::InitializeBuffers).
+    const float WaveSpatialStep = 1.0f;
+    const float WaveTimeStep = 0.03f;
+    const float WaveSpeed = 3.25f;
+    const float WaveDamping = 0.4f;
+
+    int g_FailureCount = 0;
+
+    void Check(bool condition, const char* test, const char* what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED %s: %s\n", test, what);
+            ++g_FailureCount;
+        }
+    }
+
+    bool IsFlat(const Waves& waves)
+    {
+        for (UINT i = 0; i < waves.RowCount(); ++i)
+        {
+            for (UINT j = 0; j < waves.ColumnCount(); ++j)
+            {
+                if (waves.Height(i, j) != 0.0f)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // A disturbance queued before a re-Init must not land on the new grid, which
+    // may be smaller than the tile it was queued for.
+    void TestInitDropsQueuedDisturbances()
+    {
+        const char* test = "InitDropsQueuedDisturbances";
+
+        Waves waves;
+        waves.Init(96, 96, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+
+        Waves::Disturbance event = { 80, 80, 1.0f };
+        waves.QueueDisturbances(&event, 1, Waves::DisturbanceKernel(3, Waves::DisturbanceKernel::Falloff::Gaussian));
+        Check(waves.QueuedDisturbanceCount() == 1, test, "the disturbance was not queued");
+
+        waves.Init(32, 32, WaveSpatialStep, WaveTimeStep, WaveSpeed, WaveDamping);
+        Check(waves.QueuedDisturbanceCount() == 0, test, "Init kept the queued disturbance");
+
+        waves.Step(10);
+        Check(IsFlat(waves), test, "the grid is not flat after stepping");
+
+        // The stencil list starts over too; queueing after the re-Init still works.
+        event.Row = 16;
+        event.Col = 16;
+        waves.QueueDisturbances(&event, 1);
+        waves.Step(1);
+        Check(!IsFlat(waves), test, "a disturbance queued after Init had no effect");
+    }
+
+    // Before Init the time step is 0: no steps are owed and the blend factor is 0,
+    // not 0/0.
+    void TestInterpolationAlphaBeforeInit()
+    {
+        const char* test = "InterpolationAlphaBeforeInit";
+
+        Waves waves;
+        Check(waves.InterpolationAlpha() == 0.0f, test, "Waves::InterpolationAlpha is not 0");
+        Check(waves.StepsDue(1.0f) == 0, test, "Waves owes steps");
+
+        FixedWaves<16, 16> fixedWaves;
+        Check(fixedWaves.InterpolationAlpha() == 0.0f, test, "FixedWaves::InterpolationAlpha is not 0");
+
+        fixedWaves.Update(1.0f);
+        Check(fixedWaves.LastStepCount() == 0, test, "FixedWaves stepped");
+        Check(fixedWaves.InterpolationAlpha() == 0.0f, test, "FixedWaves::InterpolationAlpha is not 0 after Update");
+    }
+}
+
+int main()
+{
+    TestInitDropsQueuedDisturbances();
+    TestInterpolationAlphaBeforeInit();
+
+    if (g_FailureCount > 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", g_FailureCount);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
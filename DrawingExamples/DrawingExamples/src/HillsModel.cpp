@@ -1,5 +1,6 @@
 #include "HillsModel.h"
 #include "GeometryGenerator.h"
+#include "MeshOptimizer.h"
 
 
 HillsModel::HillsModel()
@@ -16,55 +17,59 @@ HillsModel::~HillsModel()
 
 bool HillsModel::InitializeBuffers(ID3D11Device* device)
 {
-    GeometryGenerator::MeshData grid;
-    GeometryGenerator geoGen;
+    const UINT m = 50;
+    const UINT n = 50;
+    const float width = 160.0f;
+    const float depth = 160.0f;
 
-    geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+    GeometryGenerator::MeshSize grid = GeometryGenerator::GridSize(m, n);
 
-    m_IndexCount = static_cast<int>(grid.Indices.size());
+    m_IndexCount = static_cast<int>(grid.IndexCount);
+    m_VertexCount = static_cast<int>(grid.VertexCount);
 
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
+    // Lay the vertices out as CreateGrid does, raised onto the hills and colored
+    // by height so we have sandy looking beaches, grassy low hills, and snow
+    // mountain peaks.
+    //
+    // The height function is separable and every row shares the same columns, so
+    // sin(0.1x) is taken once per column and cos(0.1z) once per row instead of
+    // both for every vertex.  Heights are bit-for-bit those of GetHeight().
 
-    std::vector<VertexType> vertices(grid.Vertices.size());
-    for (size_t i = 0; i < grid.Vertices.size(); ++i)
-    {
-        XMFLOAT3 p = grid.Vertices[i].Position;
+    std::vector<VertexType> vertices(grid.VertexCount);
+    std::vector<UINT> indices(grid.IndexCount);
 
-        p.y = GetHeight(p.x, p.z);
+    float halfWidth = 0.5f*width;
+    float halfDepth = 0.5f*depth;
 
-        vertices[i].Position = p;
+    float dx = width / (n - 1);
+    float dz = depth / (m - 1);
 
-        // Color the vertex based on its height.
-        if (p.y < -10.0f)
-        {
-            // Sandy beach color.
-            vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-        }
-        else if (p.y < 5.0f)
-        {
-            // Light yellow-green.
-            vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-        }
-        else if (p.y < 12.0f)
-        {
-            // Dark yellow-green.
-            vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-        }
-        else if (p.y < 20.0f)
-        {
-            // Dark brown.
-            vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-        }
-        else
+    std::vector<float> x(n);
+    std::vector<float> sinX(n);
+    for (UINT j = 0; j < n; ++j)
+    {
+        x[j] = -halfWidth + j * dx;
+        sinX[j] = sinf(0.1f * x[j]);
+    }
+
+    for (UINT i = 0; i < m; ++i)
+    {
+        float z = halfDepth - i * dz;
+        float cosZ = cosf(0.1f * z);
+
+        VertexType* row = &vertices[i * n];
+        for (UINT j = 0; j < n; ++j)
         {
-            // White snow.
-            vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+            float y = 0.3f*(z*sinX[j] + x[j] * cosZ);
+
+            row[j].Position = XMFLOAT3(x[j], y, z);
+            row[j].Color = GetColor(y);
         }
     }
 
-    m_VertexCount = static_cast<int>(grid.Vertices.size());
+    GeometryGenerator::CreateGridIndices(n, 0, m - 1, &indices[0]);
+
+    MeshOptimizer::Optimize(&vertices[0], grid.VertexCount, &indices[0], grid.IndexCount);
 
     // Set up the description of the static vertex buffer.
     D3D11_BUFFER_DESC vertexBufferDesc;
@@ -95,7 +100,7 @@ bool HillsModel::InitializeBuffers(ID3D11Device* device)
 
     // Give the subresource structure a pointer to the index data.
     D3D11_SUBRESOURCE_DATA indexData;
-    indexData.pSysMem = &grid.Indices[0];
+    indexData.pSysMem = &indices[0];
     indexData.SysMemPitch = 0;
     indexData.SysMemSlicePitch = 0;
 
@@ -124,4 +129,32 @@ void HillsModel::RenderBuffers(ID3D11DeviceContext* deviceContext)
 float HillsModel::GetHeight(float x, float z) const
 {
     return 0.3f*(z*sinf(0.1f*x) + x * cosf(0.1f*z));
+}
+
+XMFLOAT4 HillsModel::GetColor(float y)
+{
+    // Color the vertex based on its height.
+    if (y < -10.0f)
+    {
+        // Sandy beach color.
+        return XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+    }
+    else if (y < 5.0f)
+    {
+        // Light yellow-green.
+        return XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+    }
+    else if (y < 12.0f)
+    {
+        // Dark yellow-green.
+        return XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+    }
+    else if (y < 20.0f)
+    {
+        // Dark brown.
+        return XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+    }
+
+    // White snow.
+    return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 }
\ No newline at end of file
@@ -25,6 +25,8 @@ private:
     ID3D11Buffer* m_IndexBuffer;
     int m_VertexCount, m_IndexCount;
 
+    // The per-point height function, which InitializeBuffers evaluates a row at a time.
     float GetHeight(float x, float z) const;
+    static XMFLOAT4 GetColor(float y);
 };
 
@@ -0,0 +1,47 @@
+#include "MeshLoader.h"
+#include <fstream>
+#include <string>
+
+
+bool MeshLoader::LoadTextMesh(const char* fileName, MeshData& meshData)
+{
+    std::ifstream fin(fileName);
+
+    if (!fin.is_open())
+    {
+        return false;
+    }
+
+    return LoadTextMesh(fin, meshData);
+}
+
+bool MeshLoader::LoadTextMesh(std::istream& in, MeshData& meshData)
+{
+    UINT vcount = 0;
+    UINT tcount = 0;
+    std::string ignore;
+
+    in >> ignore >> vcount;
+    in >> ignore >> tcount;
+    in >> ignore >> ignore >> ignore >> ignore;
+
+    meshData.Positions.resize(vcount);
+    meshData.Normals.resize(vcount);
+    for (UINT i = 0; i < vcount; ++i)
+    {
+        in >> meshData.Positions[i].x >> meshData.Positions[i].y >> meshData.Positions[i].z;
+        in >> meshData.Normals[i].x >> meshData.Normals[i].y >> meshData.Normals[i].z;
+    }
+
+    in >> ignore;
+    in >> ignore;
+    in >> ignore;
+
+    meshData.Indices.resize(3 * tcount);
+    for (UINT i = 0; i < tcount; ++i)
+    {
+        in >> meshData.Indices[i * 3 + 0] >> meshData.Indices[i * 3 + 1] >> meshData.Indices[i * 3 + 2];
+    }
+
+    return !in.fail();
+}
@@ -0,0 +1,42 @@
+//***************************************************************************************
+// MeshLoader.h
+//
+// Reads the text mesh files that ship with the demos (skull.txt, car.txt):
+//
+//   VertexCount: N
+//   TriangleCount: M
+//   VertexList (pos, normal)
+//   {
+//       px py pz nx ny nz      (N lines)
+//   }
+//   TriangleList
+//   {
+//       i0 i1 i2               (M lines)
+//   }
+//
+// Kept free of Direct3D so it can be used by tools as well as the models.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <istream>
+#include <vector>
+using namespace DirectX;
+
+
+class MeshLoader
+{
+public:
+    struct MeshData
+    {
+        std::vector<XMFLOAT3> Positions;
+        std::vector<XMFLOAT3> Normals;
+        std::vector<UINT> Indices;
+    };
+
+    // Returns false if the file cannot be opened or is truncated.
+    static bool LoadTextMesh(const char* fileName, MeshData& meshData);
+    static bool LoadTextMesh(std::istream& in, MeshData& meshData);
+};
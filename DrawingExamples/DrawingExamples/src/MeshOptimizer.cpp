@@ -0,0 +1,281 @@
+//=======================================================================================
+// MeshOptimizer.cpp
+//=======================================================================================
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Forsyth's constants.  The LRU cache the scores assume is larger than the FIFO
+    // it is measured on, so the order also holds up on larger caches.
+    const UINT ScoreCacheSize = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    // Valences below this are scored from a table.
+    const UINT ValenceTableSize = 64;
+
+    const UINT NoTriangle = ~0u;
+
+    class VertexScorer
+    {
+    public:
+        VertexScorer()
+        {
+            for (UINT i = 0; i < ScoreCacheSize; ++i)
+            {
+                // The three vertices of the triangle just emitted score the same, so
+                // the next one is not chosen for reusing one particular edge.
+                m_CacheScore[i] = i < 3 ? LastTriangleScore
+                    : powf(1.0f - (i - 3) / static_cast<float>(ScoreCacheSize - 3), CacheDecayPower);
+            }
+
+            m_ValenceScore[0] = 0.0f;
+            for (UINT i = 1; i < ValenceTableSize; ++i)
+            {
+                m_ValenceScore[i] = ValenceBoost(i);
+            }
+        }
+
+        float Score(int cachePosition, UINT trianglesLeft) const
+        {
+            if (trianglesLeft == 0)
+            {
+                return -1.0f;
+            }
+
+            float score = cachePosition < 0 ? 0.0f : m_CacheScore[cachePosition];
+            score += trianglesLeft < ValenceTableSize ? m_ValenceScore[trianglesLeft] : ValenceBoost(trianglesLeft);
+
+            return score;
+        }
+
+    private:
+        static float ValenceBoost(UINT trianglesLeft)
+        {
+            return ValenceBoostScale * powf(static_cast<float>(trianglesLeft), -ValenceBoostPower);
+        }
+
+        float m_CacheScore[ScoreCacheSize];
+        float m_ValenceScore[ValenceTableSize];
+    };
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const UINT* indices, UINT indexCount,
+    UINT vertexCount, UINT cacheSize)
+{
+    // A vertex is in the cache if fewer than cacheSize vertices were transformed
+    // after it was; zero means never transformed.
+    std::vector<UINT> transformedAt(vertexCount, 0);
+    UINT time = cacheSize + 1;
+
+    VertexCacheStats stats = { 0, 0.0f, 0.0f };
+    UINT verticesUsed = 0;
+
+    for (UINT i = 0; i < indexCount; ++i)
+    {
+        UINT v = indices[i];
+        if (time - transformedAt[v] > cacheSize)
+        {
+            if (transformedAt[v] == 0)
+            {
+                ++verticesUsed;
+            }
+
+            transformedAt[v] = time++;
+            ++stats.VerticesTransformed;
+        }
+    }
+
+    if (indexCount >= 3)
+    {
+        stats.Acmr = stats.VerticesTransformed / static_cast<float>(indexCount / 3);
+        stats.Atvr = stats.VerticesTransformed / static_cast<float>(verticesUsed);
+    }
+
+    return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(UINT* indices, UINT indexCount, UINT vertexCount)
+{
+    UINT triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    VertexScorer scorer;
+
+    // Each vertex's triangles not yet emitted, packed per vertex: vertex v's are
+    // triangles[firstTriangle[v] .. firstTriangle[v] + trianglesLeft[v]).
+    std::vector<UINT> trianglesLeft(vertexCount, 0);
+    for (UINT i = 0; i < 3 * triangleCount; ++i)
+    {
+        ++trianglesLeft[indices[i]];
+    }
+
+    std::vector<UINT> firstTriangle(vertexCount);
+    UINT offset = 0;
+    for (UINT v = 0; v < vertexCount; ++v)
+    {
+        firstTriangle[v] = offset;
+        offset += trianglesLeft[v];
+    }
+
+    std::vector<UINT> triangles(offset);
+    std::vector<UINT> filled(vertexCount, 0);
+    for (UINT i = 0; i < 3 * triangleCount; ++i)
+    {
+        UINT v = indices[i];
+        triangles[firstTriangle[v] + filled[v]++] = i / 3;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (UINT v = 0; v < vertexCount; ++v)
+    {
+        vertexScore[v] = scorer.Score(-1, trianglesLeft[v]);
+    }
+
+    // Nothing is cached yet, so start from the triangle with the fewest neighbours.
+    UINT best = 0;
+    float bestScore = -1.0f;
+    for (UINT t = 0; t < triangleCount; ++t)
+    {
+        const UINT* tri = indices + 3 * t;
+        float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if (score > bestScore)
+        {
+            best = t;
+            bestScore = score;
+        }
+    }
+
+    std::vector<BYTE> emitted(triangleCount, 0);
+    std::vector<UINT> output(3 * triangleCount);
+
+    UINT cache[ScoreCacheSize + 3];
+    UINT newCache[ScoreCacheSize + 3];
+    UINT cacheCount = 0;
+
+    UINT nextUnemitted = 0;
+
+    for (UINT k = 0; k < triangleCount; ++k)
+    {
+        if (best == NoTriangle)
+        {
+            // No cached vertex has a triangle left.  Carry on in the original order,
+            // which keeps the search linear where Forsyth rescans every triangle.
+            while (emitted[nextUnemitted])
+            {
+                ++nextUnemitted;
+            }
+
+            best = nextUnemitted;
+        }
+
+        const UINT* tri = indices + 3 * best;
+        output[3 * k] = tri[0];
+        output[3 * k + 1] = tri[1];
+        output[3 * k + 2] = tri[2];
+        emitted[best] = 1;
+
+        // The triangle's vertices go to the front of the cache, the rest move down.
+        UINT newCount = 0;
+        for (UINT c = 0; c < 3; ++c)
+        {
+            UINT v = tri[c];
+
+            UINT* first = triangles.data() + firstTriangle[v];
+            UINT* last = first + trianglesLeft[v];
+            *std::find(first, last, best) = *(last - 1);
+            --trianglesLeft[v];
+
+            if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+            {
+                newCache[newCount++] = v;
+            }
+        }
+
+        for (UINT c = 0; c < cacheCount; ++c)
+        {
+            UINT v = cache[c];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // Rescore what is still cached and what just fell out.
+        cacheCount = std::min(newCount, ScoreCacheSize);
+        for (UINT c = 0; c < newCount; ++c)
+        {
+            UINT v = newCache[c];
+            cachePosition[v] = c < cacheCount ? static_cast<int>(c) : -1;
+            vertexScore[v] = scorer.Score(cachePosition[v], trianglesLeft[v]);
+            cache[c] = v;
+        }
+
+        // Only triangles of cached vertices can gain from the cache.
+        best = NoTriangle;
+        bestScore = -1.0f;
+        for (UINT c = 0; c < cacheCount; ++c)
+        {
+            UINT v = cache[c];
+            const UINT* first = triangles.data() + firstTriangle[v];
+            for (UINT i = 0; i < trianglesLeft[v]; ++i)
+            {
+                const UINT* candidate = indices + 3 * first[i];
+                float score = vertexScore[candidate[0]] + vertexScore[candidate[1]] + vertexScore[candidate[2]];
+                if (score > bestScore)
+                {
+                    best = first[i];
+                    bestScore = score;
+                }
+            }
+        }
+    }
+
+    // Meshes exported already ordered for a FIFO cache can come out worse.
+    UINT transformedBefore = AnalyzeVertexCache(indices, 3 * triangleCount, vertexCount).VerticesTransformed;
+    UINT transformedAfter = AnalyzeVertexCache(output.data(), 3 * triangleCount, vertexCount).VerticesTransformed;
+    if (transformedAfter < transformedBefore)
+    {
+        std::copy(output.begin(), output.end(), indices);
+    }
+}
+
+void MeshOptimizer::BuildFetchRemap(const UINT* indices, UINT indexCount, UINT vertexCount, UINT* remap)
+{
+    const UINT Unused = ~0u;
+    std::fill(remap, remap + vertexCount, Unused);
+
+    UINT next = 0;
+    for (UINT i = 0; i < indexCount; ++i)
+    {
+        if (remap[indices[i]] == Unused)
+        {
+            remap[indices[i]] = next++;
+        }
+    }
+
+    for (UINT v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] == Unused)
+        {
+            remap[v] = next++;
+        }
+    }
+}
+
+void MeshOptimizer::RemapIndices(UINT* indices, UINT indexCount, const UINT* remap)
+{
+    for (UINT i = 0; i < indexCount; ++i)
+    {
+        indices[i] = remap[indices[i]];
+    }
+}
@@ -1,4 +1,5 @@
 #include "ShapesModel.h"
+#include "MeshOptimizer.h"
 
 
 ShapesModel::ShapesModel()
@@ -32,29 +33,23 @@ ShapesModel::~ShapesModel()
 
 bool ShapesModel::InitializeBuffers(ID3D11Device* device)
 {
-    GeometryGenerator::MeshData box;
-    GeometryGenerator::MeshData grid;
-    GeometryGenerator::MeshData sphere;
-    GeometryGenerator::MeshData cylinder;
-
-    GeometryGenerator geoGen;
-    geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
-    geoGen.CreateGrid(20.0f, 30.0f, 60, 40, grid);
-    //geoGen.CreateSphere(0.5f, 20, 20, sphere);
-    geoGen.CreateGeosphere(0.5f, 3, sphere);
-    geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
+    GeometryGenerator::MeshSize box = GeometryGenerator::BoxSize();
+    GeometryGenerator::MeshSize grid = GeometryGenerator::GridSize(60, 40);
+    //GeometryGenerator::MeshSize sphere = GeometryGenerator::SphereSize(20, 20);
+    GeometryGenerator::MeshSize sphere = GeometryGenerator::GeosphereSize(3);
+    GeometryGenerator::MeshSize cylinder = GeometryGenerator::CylinderSize(20, 20);
 
     // Cache the vertex offsets to each object in the concatenated vertex buffer.
     m_BoxVertexOffset = 0;
-    m_GridVertexOffset = static_cast<int>(box.Vertices.size());
-    m_SphereVertexOffset = static_cast<int>(m_GridVertexOffset + grid.Vertices.size());
-    m_CylinderVertexOffset = static_cast<int>(m_SphereVertexOffset + sphere.Vertices.size());
+    m_GridVertexOffset = static_cast<int>(box.VertexCount);
+    m_SphereVertexOffset = static_cast<int>(m_GridVertexOffset + grid.VertexCount);
+    m_CylinderVertexOffset = static_cast<int>(m_SphereVertexOffset + sphere.VertexCount);
 
     // Cache the index count of each object.
-    m_BoxIndexCount = static_cast<int>(box.Indices.size());
-    m_GridIndexCount = static_cast<int>(grid.Indices.size());
-    m_SphereIndexCount = static_cast<int>(sphere.Indices.size());
-    m_CylinderIndexCount = static_cast<int>(cylinder.Indices.size());
+    m_BoxIndexCount = box.IndexCount;
+    m_GridIndexCount = grid.IndexCount;
+    m_SphereIndexCount = sphere.IndexCount;
+    m_CylinderIndexCount = cylinder.IndexCount;
 
     // Cache the starting index for each object in the concatenated index buffer.
     m_BoxIndexOffset = 0;
@@ -62,43 +57,43 @@ bool ShapesModel::InitializeBuffers(ID3D11Device* device)
     m_SphereIndexOffset = m_GridIndexOffset + m_GridIndexCount;
     m_CylinderIndexOffset = m_SphereIndexOffset + m_SphereIndexCount;
 
-    m_VertexCount = static_cast<int>(box.Vertices.size() + grid.Vertices.size()
-                  + sphere.Vertices.size() + cylinder.Vertices.size());
+    m_VertexCount = static_cast<int>(box.VertexCount + grid.VertexCount
+                  + sphere.VertexCount + cylinder.VertexCount);
 
     m_IndexCount = m_BoxIndexCount + m_GridIndexCount 
                  + m_SphereIndexCount + m_CylinderIndexCount;
 
-    // Extract the vertex elements we are interested in and pack the
-    // vertices of all the meshes into one vertex buffer.
+    // Generate the meshes straight into one vertex buffer and one index buffer,
+    // keeping only the positions.
 
     std::vector<VertexType> vertices(m_VertexCount);
+    std::vector<UINT> indices(m_IndexCount);
 
     XMFLOAT4 black(0.0f, 0.0f, 0.0f, 1.0f);
 
-    UINT k = 0;
-    for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+    auto write = [&black](VertexType& out, const GeometryGenerator::Vertex& v)
     {
-        vertices[k].Position = box.Vertices[i].Position;
-        vertices[k].Color = black;
-    }
+        out.Position = v.Position;
+        out.Color = black;
+    };
 
-    for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Position = grid.Vertices[i].Position;
-        vertices[k].Color = black;
-    }
-
-    for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Position = sphere.Vertices[i].Position;
-        vertices[k].Color = black;
-    }
-
-    for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Position = cylinder.Vertices[i].Position;
-        vertices[k].Color = black;
-    }
+    GeometryGenerator geoGen;
+    geoGen.CreateBox<GeometryGenerator::PositionOnly>(1.0f, 1.0f, 1.0f,
+        &vertices[m_BoxVertexOffset], &indices[m_BoxIndexOffset], write);
+    geoGen.CreateGrid<GeometryGenerator::PositionOnly>(20.0f, 30.0f, 60, 40,
+        &vertices[m_GridVertexOffset], &indices[m_GridIndexOffset], write);
+    //geoGen.CreateSphere<GeometryGenerator::PositionOnly>(0.5f, 20, 20,
+    //    &vertices[m_SphereVertexOffset], &indices[m_SphereIndexOffset], write);
+    geoGen.CreateGeosphere<GeometryGenerator::PositionOnly>(0.5f, 3,
+        &vertices[m_SphereVertexOffset], &indices[m_SphereIndexOffset], write);
+    geoGen.CreateCylinder<GeometryGenerator::PositionOnly>(0.5f, 0.3f, 3.0f, 20, 20,
+        &vertices[m_CylinderVertexOffset], &indices[m_CylinderIndexOffset], write);
+
+    // Each mesh's indices are relative to its own vertices, so each is reordered alone.
+    MeshOptimizer::Optimize(&vertices[m_BoxVertexOffset], box.VertexCount, &indices[m_BoxIndexOffset], box.IndexCount);
+    MeshOptimizer::Optimize(&vertices[m_GridVertexOffset], grid.VertexCount, &indices[m_GridIndexOffset], grid.IndexCount);
+    MeshOptimizer::Optimize(&vertices[m_SphereVertexOffset], sphere.VertexCount, &indices[m_SphereIndexOffset], sphere.IndexCount);
+    MeshOptimizer::Optimize(&vertices[m_CylinderVertexOffset], cylinder.VertexCount, &indices[m_CylinderIndexOffset], cylinder.IndexCount);
 
     // Set up the description of the static vertex buffer.
     D3D11_BUFFER_DESC vertexBufferDesc;
@@ -117,13 +112,6 @@ bool ShapesModel::InitializeBuffers(ID3D11Device* device)
 
     HR(device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_VertexBuffer));
 
-    // Pack the indices of all the meshes into one index buffer.
-    std::vector<UINT> indices;
-    indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
-    indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
-    indices.insert(indices.end(), sphere.Indices.begin(), sphere.Indices.end());
-    indices.insert(indices.end(), cylinder.Indices.begin(), cylinder.Indices.end());
-
     // Set up the description of the static index buffer.
     D3D11_BUFFER_DESC indexBufferDesc;
     indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -1,5 +1,6 @@
 #include "SkullModel.h"
-#include <fstream>
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
 
 
 SkullModel::SkullModel()
@@ -16,48 +17,35 @@ SkullModel::~SkullModel()
 
 bool SkullModel::InitializeBuffers(ID3D11Device* device)
 {
-    std::ifstream fin("src/skull.txt");
-
-    if (!fin.is_open())
+    MeshLoader::MeshData mesh;
+    if (!MeshLoader::LoadTextMesh("src/skull.txt", mesh))
     {
         MessageBox(0, L"src/skull.txt not found.", 0, 0);
         return false;
     }
 
-    UINT tcount = 0;
-    std::string ignore;
+    m_VertexCount = static_cast<int>(mesh.Positions.size());
+    m_IndexCount = static_cast<int>(mesh.Indices.size());
+    std::vector<UINT>& indices = mesh.Indices;
+
+    // Reorder for the post-transform cache, then lay the vertices out in the order
+    // the triangles first use them.
+    MeshOptimizer::OptimizeVertexCache(&indices[0], m_IndexCount, m_VertexCount);
 
-    fin >> ignore >> m_VertexCount;
-    fin >> ignore >> tcount;
-    fin >> ignore >> ignore >> ignore >> ignore;
+    std::vector<UINT> remap(m_VertexCount);
+    MeshOptimizer::BuildFetchRemap(&indices[0], m_IndexCount, m_VertexCount, &remap[0]);
+    MeshOptimizer::RemapIndices(&indices[0], m_IndexCount, &remap[0]);
 
-    float nx, ny, nz;
     XMFLOAT4 black(0.0f, 0.0f, 0.0f, 1.0f);
 
+    // Normal not used in this demo.
     std::vector<VertexType> vertices(m_VertexCount);
     for (int i = 0; i < m_VertexCount; ++i)
     {
-        fin >> vertices[i].Position.x >> vertices[i].Position.y >> vertices[i].Position.z;
-
-        vertices[i].Color = black;
-
-        // Normal not used in this demo.
-        fin >> nx >> ny >> nz;
+        vertices[remap[i]].Position = mesh.Positions[i];
+        vertices[remap[i]].Color = black;
     }
 
-    fin >> ignore;
-    fin >> ignore;
-    fin >> ignore;
-
-    m_IndexCount = static_cast<int>(3 * tcount);
-    std::vector<UINT> indices(m_IndexCount);
-    for (UINT i = 0; i < tcount; ++i)
-    {
-        fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-    }
-
-    fin.close();
-
     // Set up the description of the static vertex buffer.
     D3D11_BUFFER_DESC vertexBufferDesc;
     vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -1,4 +1,5 @@
 #include "WaveModel.h"
+#include "MeshOptimizer.h"
 
 WaveModel::WaveModel()
     : m_GridVertexBuffer(nullptr), m_GridIndexBuffer(nullptr)
@@ -56,54 +57,57 @@ void WaveModel::RenderWavesBuffers(ID3D11DeviceContext* deviceContext)
 
 void WaveModel::BuildLandGeometryBuffers(ID3D11Device* device)
 {
-    GeometryGenerator::MeshData grid;
+    GeometryGenerator::MeshSize grid = GeometryGenerator::GridSize(50, 50);
 
-    GeometryGenerator geoGen;
-    geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+    m_GridVertexCount = static_cast<int>(grid.VertexCount);
+    m_GridIndexCount = static_cast<int>(grid.IndexCount);
 
-    m_GridVertexCount = static_cast<int>(grid.Vertices.size());
-    m_GridIndexCount = static_cast<int>(grid.Indices.size());
+    // Keep only the position of each grid vertex and apply the height function to it.
+    // In addition, color the vertices based on their height so we have sandy looking
+    // beaches, grassy low hills, and snow mountain peaks.
 
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
+    std::vector<VertexType> vertices(grid.VertexCount);
+    std::vector<UINT> indices(grid.IndexCount);
 
-    std::vector<VertexType> vertices(grid.Vertices.size());
-    for (size_t i = 0; i < grid.Vertices.size(); ++i)
+    GeometryGenerator geoGen;
+    geoGen.CreateGrid<GeometryGenerator::PositionOnly>(160.0f, 160.0f, 50, 50, &vertices[0], &indices[0],
+        [this](VertexType& out, const GeometryGenerator::Vertex& v)
     {
-        XMFLOAT3 p = grid.Vertices[i].Position;
+        XMFLOAT3 p = v.Position;
 
         p.y = GetHeight(p.x, p.z);
 
-        vertices[i].Position = p;
+        out.Position = p;
 
         // Color the vertex based on its height.
         if (p.y < -10.0f)
         {
             // Sandy beach color.
-            vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+            out.Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
         }
         else if (p.y < 5.0f)
         {
             // Light yellow-green.
-            vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+            out.Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
         }
         else if (p.y < 12.0f)
         {
             // Dark yellow-green.
-            vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+            out.Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
         }
         else if (p.y < 20.0f)
         {
             // Dark brown.
-            vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+            out.Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
         }
         else
         {
             // White snow.
-            vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+            out.Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
         }
-    }
+    });
+
+    MeshOptimizer::Optimize(&vertices[0], grid.VertexCount, &indices[0], grid.IndexCount);
 
     // Set up the description of the static vertex buffer.
     D3D11_BUFFER_DESC vertexBufferDesc;
@@ -133,7 +137,7 @@ void WaveModel::BuildLandGeometryBuffers(ID3D11Device* device)
 
     // Give the subresource structure a pointer to the index data.
     D3D11_SUBRESOURCE_DATA indexData;
-    indexData.pSysMem = &grid.Indices[0];
+    indexData.pSysMem = &indices[0];
     indexData.SysMemPitch = 0;
     indexData.SysMemSlicePitch = 0;
 
@@ -187,6 +191,9 @@ void WaveModel::BuildWavesGeometryBuffers(ID3D11Device* device)
         }
     }
 
+    // The simulation writes the vertices in grid order, so only the triangles move.
+    MeshOptimizer::OptimizeVertexCache(&indices[0], static_cast<UINT>(indices.size()), m_Waves.VertexCount());
+
     // Set up the description of the static index buffer.
     D3D11_BUFFER_DESC indexBufferDesc;
     indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -0,0 +1,56 @@
+//***************************************************************************************
+// AlignedPlanes.h
+//
+// Storage for the solvers' structure-of-arrays planes.  Blocks start on a cache
+// line, and the solvers round each plane row up to whole lines, so rows can be
+// streamed and split between cores without sharing lines.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+
+class AlignedPlanes
+{
+public:
+    static const UINT Alignment = 64;
+
+    // Returns byteCount bytes aligned to Alignment, and throws std::bad_alloc if they
+    // cannot be had, as operator new does.  Release with Free().
+    static void* Alloc(size_t byteCount);
+    static void Free(void* p);
+};
+
+
+inline void* AlignedPlanes::Alloc(size_t byteCount)
+{
+#if defined(_MSC_VER)
+    void* p = _aligned_malloc(byteCount, Alignment);
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, Alignment, byteCount) != 0)
+    {
+        p = nullptr;
+    }
+#endif
+
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+inline void AlignedPlanes::Free(void* p)
+{
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
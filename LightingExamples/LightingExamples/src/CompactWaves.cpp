@@ -0,0 +1,414 @@
+//=======================================================================================
+// CompactWaves.cpp
+//=======================================================================================
+
+#include "CompactWaves.h"
+#include "WorkerPool.h"
+#include "AlignedPlanes.h"
+#include "MathHelper.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX::PackedVector;
+
+namespace
+{
+    // Row pitch is a whole number of lines for both 16-bit and 32-bit planes.
+    const UINT CellsPerLine = AlignedPlanes::Alignment / sizeof(USHORT);
+
+    // up, mid, down and the stepped row, then nx, ny, nz, tx, ty.
+    const UINT ScratchRows = 9;
+
+    const float Fixed16Max = 32767.0f;
+
+    float SignNotZero(float x)
+    {
+        return x >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    UINT PackSNorm16(float x)
+    {
+        x = MathHelper::Clamp(x, -1.0f, 1.0f) * Fixed16Max;
+        return static_cast<UINT>(static_cast<int>(x + (x >= 0.0f ? 0.5f : -0.5f))) & 0xffff;
+    }
+
+    float UnpackSNorm16(UINT x)
+    {
+        return static_cast<short>(x & 0xffff) / Fixed16Max;
+    }
+
+    UINT PackUNorm10(float x)
+    {
+        return static_cast<UINT>(MathHelper::Clamp(x * 0.5f + 0.5f, 0.0f, 1.0f) * 1023.0f + 0.5f);
+    }
+
+    float UnpackUNorm10(UINT x)
+    {
+        return (x & 0x3ff) * (2.0f / 1023.0f) - 1.0f;
+    }
+
+    XMFLOAT3 Normalize(float x, float y, float z)
+    {
+        float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+        return XMFLOAT3(x * invLength, y * invLength, z * invLength);
+    }
+}
+
+CompactWaves::CompactWaves()
+    : m_NumRows(0), m_NumCols(0)
+    , m_K1(0.0f), m_K2(0.0f), m_K3(0.0f), m_TimeStep(0.0f), m_SpatialStep(0.0f)
+    , m_HalfWidth(0.0f), m_HalfDepth(0.0f)
+    , m_HeightFormat(HeightFormat::Fixed16), m_NormalFormat(NormalFormat::Octahedral16)
+    , m_HeightScale(0.0f), m_InvHeightScale(0.0f), m_RowPitch(0), m_StateBytes(0), m_Storage(0)
+    , m_PrevHeights(0), m_CurrHeights(0), m_PackedNormals(0), m_NormalX(0), m_NormalY(0), m_NormalZ(0)
+    , m_Kernels(WavesKernels::Select(WavesKernels::Isa::AVX512)), m_WorkerPool(nullptr)
+    , m_Revision(0)
+{
+}
+
+CompactWaves::~CompactWaves()
+{
+    AlignedPlanes::Free(m_Storage);
+}
+
+XMFLOAT3 CompactWaves::operator[](int i) const
+{
+    UINT row = i / m_NumCols;
+    UINT col = i % m_NumCols;
+
+    return XMFLOAT3(-m_HalfWidth + col * m_SpatialStep, Height(row, col), m_HalfDepth - row * m_SpatialStep);
+}
+
+float CompactWaves::Height(UINT i, UINT j) const
+{
+    return DecodeHeight(m_CurrHeights[i * m_RowPitch + j]);
+}
+
+XMFLOAT3 CompactWaves::Normal(int i) const
+{
+    UINT k = (i / m_NumCols) * m_RowPitch + i % m_NumCols;
+
+    switch (m_NormalFormat)
+    {
+    case NormalFormat::Octahedral16:
+        return UnpackOctahedral(m_PackedNormals[k]);
+    case NormalFormat::UNorm1010102:
+        return UnpackUNorm1010102(m_PackedNormals[k]);
+    default:
+        return XMFLOAT3(m_NormalX[k], m_NormalY[k], m_NormalZ[k]);
+    }
+}
+
+XMFLOAT3 CompactWaves::TangentX(int i) const
+{
+    XMFLOAT3 n = Normal(i);
+
+    return Normalize(n.y, -n.x, 0.0f);
+}
+
+void CompactWaves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping,
+    HeightFormat heightFormat, NormalFormat normalFormat, float heightRange)
+{
+    m_NumRows = m;
+    m_NumCols = n;
+
+    m_TimeStep = dt;
+    m_SpatialStep = dx;
+
+    m_Clock.Reset();
+
+    float d = damping * dt + 2.0f;
+    float e = (speed * speed) * (dt * dt) / (dx * dx);
+    m_K1 = (damping * dt - 2.0f) / d;
+    m_K2 = (4.0f - 8.0f * e) / d;
+    m_K3 = (2.0f * e) / d;
+
+    m_HalfWidth = (n - 1) * dx * 0.5f;
+    m_HalfDepth = (m - 1) * dx * 0.5f;
+
+    m_HeightFormat = heightFormat;
+    m_NormalFormat = normalFormat;
+    m_HeightScale = heightRange / Fixed16Max;
+    m_InvHeightScale = Fixed16Max / heightRange;
+
+    // In case Init() called again.
+    AlignedPlanes::Free(m_Storage);
+    m_Storage = nullptr;
+
+    m_RowPitch = (n + CellsPerLine - 1) / CellsPerLine * CellsPerLine;
+    size_t cellCount = static_cast<size_t>(m_RowPitch) * m;
+    size_t heightBytes = cellCount * sizeof(USHORT);
+    size_t normalBytes = cellCount * (normalFormat == NormalFormat::Float32 ? 3 * sizeof(float) : sizeof(UINT));
+
+    m_StateBytes = 2 * heightBytes + normalBytes;
+    m_Storage = AlignedPlanes::Alloc(m_StateBytes);
+
+    char* p = static_cast<char*>(m_Storage);
+    m_PrevHeights = reinterpret_cast<USHORT*>(p);
+    m_CurrHeights = reinterpret_cast<USHORT*>(p + heightBytes);
+
+    // Zero encodes 0.0 in both height formats.
+    std::fill(m_PrevHeights, m_PrevHeights + 2 * cellCount, static_cast<USHORT>(0));
+
+    p += 2 * heightBytes;
+    if (normalFormat == NormalFormat::Float32)
+    {
+        m_PackedNormals = 0;
+        m_NormalX = reinterpret_cast<float*>(p);
+        m_NormalY = m_NormalX + cellCount;
+        m_NormalZ = m_NormalY + cellCount;
+        std::fill(m_NormalX, m_NormalX + cellCount, 0.0f);
+        std::fill(m_NormalY, m_NormalY + cellCount, 1.0f);
+        std::fill(m_NormalZ, m_NormalZ + cellCount, 0.0f);
+    }
+    else
+    {
+        m_PackedNormals = reinterpret_cast<UINT*>(p);
+        m_NormalX = m_NormalY = m_NormalZ = 0;
+
+        UINT up = normalFormat == NormalFormat::Octahedral16 ?
+            PackOctahedral(0.0f, 1.0f, 0.0f) : PackUNorm1010102(0.0f, 1.0f, 0.0f);
+        std::fill(m_PackedNormals, m_PackedNormals + cellCount, up);
+    }
+
+    ++m_Revision;
+}
+
+void CompactWaves::Update(float dt)
+{
+    Step(m_Clock.Advance(dt, m_TimeStep));
+}
+
+void CompactWaves::Step(UINT stepCount)
+{
+    if (stepCount == 0)
+    {
+        return;
+    }
+
+    for (UINT s = 0; s < stepCount; ++s)
+    {
+        ForEachRowBand([this](UINT rowBegin, UINT rowEnd, float* scratch) { StepRows(rowBegin, rowEnd, scratch); });
+        std::swap(m_PrevHeights, m_CurrHeights);
+    }
+
+    ForEachRowBand([this](UINT rowBegin, UINT rowEnd, float* scratch) { ComputeNormals(rowBegin, rowEnd, scratch); });
+
+    ++m_Revision;
+}
+
+void CompactWaves::StepRows(UINT rowBegin, UINT rowEnd, float* scratch)
+{
+    float* up = scratch;
+    float* mid = scratch + m_RowPitch;
+    float* down = scratch + 2 * m_RowPitch;
+    float* next = scratch + 3 * m_RowPitch;
+
+    // Walk down the band widening each current row once; the new row is widened
+    // from the previous buffer, stepped in fp32 and narrowed back in place.
+    DecodeRow(m_CurrHeights + (rowBegin - 1) * m_RowPitch, up, m_NumCols);
+    DecodeRow(m_CurrHeights + rowBegin * m_RowPitch, mid, m_NumCols);
+
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        USHORT* prev = m_PrevHeights + i * m_RowPitch;
+
+        DecodeRow(m_CurrHeights + (i + 1) * m_RowPitch, down, m_NumCols);
+        DecodeRow(prev, next, m_NumCols);
+
+        m_Kernels.StepRow(next + 1, mid + 1, up + 1, down + 1, m_NumCols - 2, m_K1, m_K2, m_K3);
+
+        EncodeRow(next, prev, m_NumCols);
+
+        float* oldUp = up;
+        up = mid;
+        mid = down;
+        down = oldUp;
+    }
+}
+
+void CompactWaves::ComputeNormals(UINT rowBegin, UINT rowEnd, float* scratch)
+{
+    float* up = scratch;
+    float* mid = scratch + m_RowPitch;
+    float* down = scratch + 2 * m_RowPitch;
+    float* nx = scratch + 4 * m_RowPitch;
+    float* ny = scratch + 5 * m_RowPitch;
+    float* nz = scratch + 6 * m_RowPitch;
+    float* tx = scratch + 7 * m_RowPitch;
+    float* ty = scratch + 8 * m_RowPitch;
+
+    DecodeRow(m_CurrHeights + (rowBegin - 1) * m_RowPitch, up, m_NumCols);
+    DecodeRow(m_CurrHeights + rowBegin * m_RowPitch, mid, m_NumCols);
+
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        DecodeRow(m_CurrHeights + (i + 1) * m_RowPitch, down, m_NumCols);
+
+        UINT k = i * m_RowPitch;
+        UINT count = m_NumCols - 2;
+
+        if (m_NormalFormat == NormalFormat::Float32)
+        {
+            m_Kernels.NormalRow(mid + 1, up + 1, down + 1, count, 2.0f * m_SpatialStep,
+                m_NormalX + k + 1, m_NormalY + k + 1, m_NormalZ + k + 1, tx, ty);
+        }
+        else
+        {
+            m_Kernels.NormalRow(mid + 1, up + 1, down + 1, count, 2.0f * m_SpatialStep, nx, ny, nz, tx, ty);
+
+            UINT* packed = m_PackedNormals + k + 1;
+            if (m_NormalFormat == NormalFormat::Octahedral16)
+            {
+                for (UINT j = 0; j < count; ++j)
+                {
+                    packed[j] = PackOctahedral(nx[j], ny[j], nz[j]);
+                }
+            }
+            else
+            {
+                for (UINT j = 0; j < count; ++j)
+                {
+                    packed[j] = PackUNorm1010102(nx[j], ny[j], nz[j]);
+                }
+            }
+        }
+
+        float* oldUp = up;
+        up = mid;
+        mid = down;
+        down = oldUp;
+    }
+}
+
+void CompactWaves::DecodeRow(const USHORT* src, float* dst, UINT count) const
+{
+    if (m_HeightFormat == HeightFormat::Half)
+    {
+        XMConvertHalfToFloatStream(dst, sizeof(float), src, sizeof(HALF), count);
+        return;
+    }
+
+    const short* q = reinterpret_cast<const short*>(src);
+    for (UINT j = 0; j < count; ++j)
+    {
+        dst[j] = q[j] * m_HeightScale;
+    }
+}
+
+void CompactWaves::EncodeRow(const float* src, USHORT* dst, UINT count) const
+{
+    if (m_HeightFormat == HeightFormat::Half)
+    {
+        XMConvertFloatToHalfStream(dst, sizeof(HALF), src, sizeof(float), count);
+        return;
+    }
+
+    short* q = reinterpret_cast<short*>(dst);
+    for (UINT j = 0; j < count; ++j)
+    {
+        float x = MathHelper::Clamp(src[j] * m_InvHeightScale, -Fixed16Max, Fixed16Max);
+        q[j] = static_cast<short>(x + (x >= 0.0f ? 0.5f : -0.5f));
+    }
+}
+
+float CompactWaves::DecodeHeight(USHORT h) const
+{
+    if (m_HeightFormat == HeightFormat::Half)
+    {
+        return XMConvertHalfToFloat(h);
+    }
+
+    return static_cast<short>(h) * m_HeightScale;
+}
+
+USHORT CompactWaves::EncodeHeight(float h) const
+{
+    USHORT q;
+    EncodeRow(&h, &q, 1);
+    return q;
+}
+
+template<typename Body>
+void CompactWaves::ForEachRowBand(const Body& body)
+{
+    UINT bandCount = WorkerPool::BandCount(m_WorkerPool, m_NumRows - 2, WorkerPool::MinBandRows);
+
+    size_t scratchFloats = static_cast<size_t>(bandCount) * ScratchRows * m_RowPitch;
+    if (m_Scratch.size() < scratchFloats)
+    {
+        m_Scratch.resize(scratchFloats);
+    }
+
+    WorkerPool::ForEachBand(m_WorkerPool, 1, m_NumRows - 1, WorkerPool::MinBandRows,
+        [&](UINT rowBegin, UINT rowEnd, UINT band)
+    {
+        body(rowBegin, rowEnd, m_Scratch.data() + static_cast<size_t>(band) * ScratchRows * m_RowPitch);
+    });
+}
+
+void CompactWaves::Disturb(UINT i, UINT j, float magnitude)
+{
+    // Don't disturb boundaries.
+    assert(i > 1 && i < m_NumRows-2);
+    assert(j > 1 && j < m_NumCols-2);
+
+    float halfMag = 0.5f * magnitude;
+
+    USHORT* h = m_CurrHeights + i * m_RowPitch + j;
+    h[0] = EncodeHeight(DecodeHeight(h[0]) + magnitude);
+    h[1] = EncodeHeight(DecodeHeight(h[1]) + halfMag);
+    h[-1] = EncodeHeight(DecodeHeight(h[-1]) + halfMag);
+    h[m_RowPitch] = EncodeHeight(DecodeHeight(h[m_RowPitch]) + halfMag);
+    h[-static_cast<int>(m_RowPitch)] = EncodeHeight(DecodeHeight(h[-static_cast<int>(m_RowPitch)]) + halfMag);
+
+    ++m_Revision;
+}
+
+UINT CompactWaves::PackOctahedral(float x, float y, float z)
+{
+    // Project onto the octahedron |x|+|y|+|z| = 1 and fold the lower half (y < 0)
+    // over the upper one, leaving the xz-plane coordinates in [-1, 1].
+    float invL1 = 1.0f / (fabsf(x) + fabsf(y) + fabsf(z));
+    float u = x * invL1;
+    float v = z * invL1;
+
+    if (y < 0.0f)
+    {
+        float foldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+        float foldedV = (1.0f - fabsf(u)) * SignNotZero(v);
+        u = foldedU;
+        v = foldedV;
+    }
+
+    return PackSNorm16(u) | (PackSNorm16(v) << 16);
+}
+
+XMFLOAT3 CompactWaves::UnpackOctahedral(UINT packed)
+{
+    float u = UnpackSNorm16(packed);
+    float v = UnpackSNorm16(packed >> 16);
+    float y = 1.0f - fabsf(u) - fabsf(v);
+
+    if (y < 0.0f)
+    {
+        float unfoldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+        float unfoldedV = (1.0f - fabsf(u)) * SignNotZero(v);
+        u = unfoldedU;
+        v = unfoldedV;
+    }
+
+    return Normalize(u, y, v);
+}
+
+UINT CompactWaves::PackUNorm1010102(float x, float y, float z)
+{
+    return PackUNorm10(x) | (PackUNorm10(y) << 10) | (PackUNorm10(z) << 20);
+}
+
+XMFLOAT3 CompactWaves::UnpackUNorm1010102(UINT packed)
+{
+    return Normalize(UnpackUNorm10(packed), UnpackUNorm10(packed >> 10), UnpackUNorm10(packed >> 20));
+}
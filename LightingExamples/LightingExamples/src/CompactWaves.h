@@ -0,0 +1,166 @@
+//***************************************************************************************
+// CompactWaves.h
+//
+// The Waves solver with 16-bit state for very large grids.  Heights are stored as
+// half floats or as int16 fixed point over [-HeightRange, HeightRange], and normals
+// optionally as one packed 32-bit word, so a cell costs 8 bytes instead of the
+// 28 bytes Waves keeps.  Each row is widened to fp32, stepped with the same
+// WavesKernels row kernels as Waves, and narrowed again, so only the stored state
+// loses precision.
+//
+// Waves' temporal blocking, active tiles, fused sweep and disturbance queue are not
+// available here; the grids this is meant for are stepped in parallel bands.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "WavesKernels.h"
+#include "FixedStepClock.h"
+using namespace DirectX;
+
+class WorkerPool;
+
+
+class CompactWaves
+{
+public:
+    enum class HeightFormat
+    {
+        Half,       // IEEE fp16: ~3 significant digits at any amplitude.
+        Fixed16     // int16 * HeightRange/32767: uniform steps, clamps beyond the range.
+    };
+
+    enum class NormalFormat
+    {
+        Float32,        // Three float planes, as in Waves.
+        Octahedral16,   // Octahedral map, x and z as snorm16 in one UINT.
+        UNorm1010102    // n*0.5+0.5 as DXGI_FORMAT_R10G10B10A2_UNORM, w = 0.
+    };
+
+public:
+    CompactWaves();
+    ~CompactWaves();
+
+    CompactWaves(const CompactWaves&) = delete;
+    CompactWaves& operator=(const CompactWaves&) = delete;
+
+    UINT RowCount() const { return m_NumRows; }
+    UINT ColumnCount() const { return m_NumCols; }
+    UINT VertexCount() const { return m_NumRows * m_NumCols; }
+    UINT TriangleCount() const { return (m_NumRows - 1) * (m_NumCols - 1) * 2; }
+
+    HeightFormat GetHeightFormat() const { return m_HeightFormat; }
+    NormalFormat GetNormalFormat() const { return m_NormalFormat; }
+
+    // Bytes of simulation state held, excluding the per-band scratch rows.
+    size_t StateBytes() const { return m_StateBytes; }
+
+    // Returns the solution at the ith grid point, widened to fp32.
+    XMFLOAT3 operator[](int i) const;
+    float Height(UINT i, UINT j) const;
+
+    // Returns the unit normal at the ith grid point, unpacked if necessary.
+    XMFLOAT3 Normal(int i) const;
+
+    // Returns the unit tangent in the local x-axis direction.  It is not stored:
+    // TangentX is (2dx, r-l, 0) and the normal (l-r, 2dx, b-t), so it is (ny, -nx, 0)
+    // renormalized.
+    XMFLOAT3 TangentX(int i) const;
+
+    // Packed normals, one UINT per cell in rows of RowPitch() cells, for uploading
+    // as-is.  Null when the normal format is Float32.
+    const UINT* PackedNormals() const { return m_PackedNormals; }
+    UINT RowPitch() const { return m_RowPitch; }
+
+    // heightRange only applies to Fixed16 and should cover the tallest crest the
+    // disturbances build up: the demo's reach about 15, so the default leaves twice
+    // that, in steps of 0.001.
+    void Init(UINT m, UINT n, float dx, float dt, float speed, float damping,
+        HeightFormat heightFormat = HeightFormat::Fixed16,
+        NormalFormat normalFormat = NormalFormat::Octahedral16,
+        float heightRange = 32.0f);
+
+    void SetKernelIsa(WavesKernels::Isa isa) { m_Kernels = WavesKernels::Select(isa); }
+    WavesKernels::Isa KernelIsa() const { return m_Kernels.Level; }
+
+    // Splits each pass into bands of whole rows run on the given pool, which is not
+    // owned.  nullptr (the default) runs serially.
+    void SetWorkerPool(WorkerPool* pool) { m_WorkerPool = pool; }
+
+    void SetMaxSubsteps(UINT maxSubsteps) { m_Clock.SetMaxSubsteps(maxSubsteps); }
+    UINT LastStepCount() const { return m_Clock.LastStepCount(); }
+
+    UINT Revision() const { return m_Revision; }
+
+    // Same fixed-timestep semantics as Waves::Update.
+    void Update(float dt);
+    void Step(UINT stepCount);
+    void Disturb(UINT i, UINT j, float magnitude);
+
+    static UINT PackOctahedral(float x, float y, float z);
+    static XMFLOAT3 UnpackOctahedral(UINT packed);
+    static UINT PackUNorm1010102(float x, float y, float z);
+    static XMFLOAT3 UnpackUNorm1010102(UINT packed);
+
+private:
+    void DecodeRow(const USHORT* src, float* dst, UINT count) const;
+    void EncodeRow(const float* src, USHORT* dst, UINT count) const;
+    float DecodeHeight(USHORT h) const;
+    USHORT EncodeHeight(float h) const;
+
+    void StepRows(UINT rowBegin, UINT rowEnd, float* scratch);
+    void ComputeNormals(UINT rowBegin, UINT rowEnd, float* scratch);
+
+    // Calls body(rowBegin, rowEnd, scratch) over the interior rows, one band per
+    // task, each with its own ScratchRows rows of scratch.
+    template<typename Body>
+    void ForEachRowBand(const Body& body);
+
+private:
+    UINT m_NumRows;
+    UINT m_NumCols;
+
+    float m_K1;
+    float m_K2;
+    float m_K3;
+
+    float m_TimeStep;
+    float m_SpatialStep;
+
+    float m_HalfWidth;
+    float m_HalfDepth;
+
+    HeightFormat m_HeightFormat;
+    NormalFormat m_NormalFormat;
+
+    // Fixed16 scale from stored integer to height, and its inverse.
+    float m_HeightScale;
+    float m_InvHeightScale;
+
+    // Cells per row in every plane (m_NumCols rounded up to a 64-byte line).
+    UINT m_RowPitch;
+    size_t m_StateBytes;
+
+    // One aligned block holding every plane below; unused planes are null.
+    void* m_Storage;
+
+    USHORT* m_PrevHeights;
+    USHORT* m_CurrHeights;
+    UINT* m_PackedNormals;
+    float* m_NormalX;
+    float* m_NormalY;
+    float* m_NormalZ;
+
+    // fp32 rows the row kernels run on, ScratchRows per band.
+    std::vector<float> m_Scratch;
+
+    WavesKernels m_Kernels;
+    WorkerPool* m_WorkerPool;
+
+    FixedStepClock m_Clock;
+
+    UINT m_Revision;
+};
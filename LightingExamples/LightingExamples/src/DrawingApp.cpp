@@ -53,6 +53,7 @@ bool DrawingApp::Initialize()
     }
     
     m_Model->InitializeBuffers(m_D3DDevice);
+    m_Model->StartSimulationThread();
     m_Shader->InitializeShaders(m_D3DDevice, m_hMainWnd, L"src/LightVertexShader.vs", L"src/LightPixelShader.ps");
 
     return true;
@@ -97,9 +98,14 @@ void DrawingApp::UpdateScene(float dt)
         m_Model->WaveDisturb(i, j, r);
     }
 
-    m_Model->WaveUpdate(dt);
+    // Keeps the clipmap levels, if any, centred under the eye.
+    m_Model->SetWavesCenter(m_EyePosition.x, m_EyePosition.z);
 
-    // Update the wave vertex buffer with the new solution.
+    // Steps the waves, writing the new solution straight into the vertex buffer.
+    m_Model->WaveUpdate(dt, m_D3DDeviceContext);
+
+    // Upload anything the step did not: a frame from the simulation thread, or a
+    // direct Disturb.
     m_Model->WaveVertexBufferUpdate(m_D3DDeviceContext);
 
     // End Wave Update
@@ -135,11 +141,15 @@ void DrawingApp::DrawScene()
         , m_DirLight, m_PointLight, m_SpotLight, m_EyePosition, m_Model->GetGridMaterial());
     m_Shader->RenderShader(m_D3DDeviceContext, m_Model->GetGridIndexCount());
 
-    // Draw the waves
+    // Draw the waves, one part per clipmap level.
     m_Model->RenderWavesBuffers(m_D3DDeviceContext);
-    m_Shader->SetShaderParameters(m_D3DDeviceContext, m_Model->GetWavesWorld(), m_View, m_Projection
-        , m_DirLight, m_PointLight, m_SpotLight, m_EyePosition, m_Model->GetWavesMaterial());
-    m_Shader->RenderShader(m_D3DDeviceContext, m_Model->GetWavesIndexCount());
+    for (UINT level = 0; level < m_Model->GetWavesLevelCount(); ++level)
+    {
+        m_Shader->SetShaderParameters(m_D3DDeviceContext, m_Model->GetWavesLevelWorld(level), m_View, m_Projection
+            , m_DirLight, m_PointLight, m_SpotLight, m_EyePosition, m_Model->GetWavesMaterial());
+        m_Shader->RenderShader(m_D3DDeviceContext, m_Model->GetWavesLevelIndexCount(level)
+            , m_Model->GetWavesLevelIndexOffset(level), m_Model->GetWavesLevelVertexOffset(level));
+    }
     
     // End Scene
     if (m_VSyncEnabled)
@@ -0,0 +1,218 @@
+//=======================================================================================
+// FFT.cpp
+//=======================================================================================
+
+#include "FFT.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+namespace
+{
+    inline FFT::Complex Add(FFT::Complex a, FFT::Complex b)
+    {
+        FFT::Complex c = { a.Re + b.Re, a.Im + b.Im };
+        return c;
+    }
+
+    inline FFT::Complex Sub(FFT::Complex a, FFT::Complex b)
+    {
+        FFT::Complex c = { a.Re - b.Re, a.Im - b.Im };
+        return c;
+    }
+
+    // Written out rather than std::complex, whose operator* guards against
+    // infinities and NaNs with a library call.
+    inline FFT::Complex Mul(FFT::Complex a, FFT::Complex b)
+    {
+        FFT::Complex c = { a.Re * b.Re - a.Im * b.Im, a.Re * b.Im + a.Im * b.Re };
+        return c;
+    }
+
+    inline FFT::Complex Conj(FFT::Complex a)
+    {
+        FFT::Complex c = { a.Re, -a.Im };
+        return c;
+    }
+
+    // Multiplies by i, or by -i if conjugate is set.
+    inline FFT::Complex MulI(FFT::Complex a, bool conjugate)
+    {
+        FFT::Complex c = conjugate ? FFT::Complex{ a.Im, -a.Re } : FFT::Complex{ -a.Im, a.Re };
+        return c;
+    }
+}
+
+FFT::FFT()
+    : m_Size(0)
+{
+}
+
+void FFT::Init(UINT n)
+{
+    assert(n > 0 && (n & (n - 1)) == 0);
+
+    m_Size = n;
+    m_Twiddles.resize(n);
+
+    // Computed in double so the table is accurate for large n.
+    const double step = 2.0 * 3.14159265358979323846 / n;
+    for (UINT t = 0; t < n; ++t)
+    {
+        m_Twiddles[t].Re = static_cast<float>(std::cos(step * t));
+        m_Twiddles[t].Im = static_cast<float>(std::sin(step * t));
+    }
+}
+
+void FFT::Forward(Complex* data, Complex* scratch) const
+{
+    Transform(data, scratch, false);
+}
+
+void FFT::Inverse(Complex* data, Complex* scratch) const
+{
+    Transform(data, scratch, true);
+}
+
+void FFT::Forward2D(Complex* data, WorkerPool* pool)
+{
+    Transform2D(data, pool, false);
+}
+
+void FFT::Inverse2D(Complex* data, WorkerPool* pool)
+{
+    Transform2D(data, pool, true);
+}
+
+void FFT::Transform(Complex* data, Complex* scratch, bool inverse) const
+{
+    Complex* x = data;
+    Complex* y = scratch;
+
+    // Pass with sub-transform length len over stride s: x holds s interleaved
+    // sequences of length len, y receives them split into four of length len/4.
+    UINT len = m_Size;
+    UINT s = 1;
+    while (len >= 4)
+    {
+        UINT quarter = len / 4;
+        UINT twiddleStep = m_Size / len;
+
+        for (UINT p = 0; p < quarter; ++p)
+        {
+            Complex w1 = m_Twiddles[p * twiddleStep];
+            Complex w2 = m_Twiddles[2 * p * twiddleStep];
+            Complex w3 = m_Twiddles[3 * p * twiddleStep];
+            if (!inverse)
+            {
+                w1 = Conj(w1);
+                w2 = Conj(w2);
+                w3 = Conj(w3);
+            }
+
+            const Complex* a = x + s * p;
+            const Complex* b = x + s * (p + quarter);
+            const Complex* c = x + s * (p + 2 * quarter);
+            const Complex* d = x + s * (p + 3 * quarter);
+            Complex* out = y + s * 4 * p;
+
+            for (UINT q = 0; q < s; ++q)
+            {
+                Complex apc = Add(a[q], c[q]);
+                Complex amc = Sub(a[q], c[q]);
+                Complex bpd = Add(b[q], d[q]);
+                Complex jbmd = MulI(Sub(b[q], d[q]), inverse);
+
+                out[q] = Add(apc, bpd);
+                out[q + s] = Mul(w1, Sub(amc, jbmd));
+                out[q + 2 * s] = Mul(w2, Sub(apc, bpd));
+                out[q + 3 * s] = Mul(w3, Add(amc, jbmd));
+            }
+        }
+
+        std::swap(x, y);
+        len = quarter;
+        s *= 4;
+    }
+
+    if (len == 2)
+    {
+        for (UINT q = 0; q < s; ++q)
+        {
+            Complex a = x[q];
+            Complex b = x[q + s];
+            y[q] = Add(a, b);
+            y[q + s] = Sub(a, b);
+        }
+
+        std::swap(x, y);
+    }
+
+    if (x != data)
+    {
+        std::copy(x, x + m_Size, data);
+    }
+}
+
+void FFT::Transform2D(Complex* data, WorkerPool* pool, bool inverse)
+{
+    const UINT n = m_Size;
+
+    ForEachBand(n, pool, [&](UINT rowBegin, UINT rowEnd, Complex* scratch)
+    {
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            Transform(data + static_cast<size_t>(i) * n, scratch, inverse);
+        }
+    });
+
+    // Columns are strided by a whole row, so gather ColumnBlock of them into
+    // contiguous rows: each source row contributes one full cache line.
+    UINT blockWidth = std::min(ColumnBlock, n);
+    UINT blockCount = n / blockWidth;
+    ForEachBand(blockCount, pool, [&](UINT blockBegin, UINT blockEnd, Complex* scratch)
+    {
+        Complex* columns = scratch + n;
+        for (UINT block = blockBegin; block < blockEnd; ++block)
+        {
+            Complex* src = data + block * blockWidth;
+            for (UINT i = 0; i < n; ++i)
+            {
+                for (UINT c = 0; c < blockWidth; ++c)
+                {
+                    columns[c * n + i] = src[static_cast<size_t>(i) * n + c];
+                }
+            }
+
+            for (UINT c = 0; c < blockWidth; ++c)
+            {
+                Transform(columns + c * n, scratch, inverse);
+            }
+
+            for (UINT i = 0; i < n; ++i)
+            {
+                for (UINT c = 0; c < blockWidth; ++c)
+                {
+                    src[static_cast<size_t>(i) * n + c] = columns[c * n + i];
+                }
+            }
+        }
+    });
+}
+
+template<typename Body>
+void FFT::ForEachBand(UINT count, WorkerPool* pool, const Body& body)
+{
+    size_t scratchSize = WorkerPool::BandCount(pool, count, MinBandItems) * ScratchPerBand();
+    if (m_Scratch.size() < scratchSize)
+    {
+        m_Scratch.resize(scratchSize);
+    }
+
+    WorkerPool::ForEachBand(pool, 0, count, MinBandItems, [&](UINT begin, UINT end, UINT band)
+    {
+        body(begin, end, m_Scratch.data() + band * ScratchPerBand());
+    });
+}
@@ -0,0 +1,72 @@
+//***************************************************************************************
+// FFT.h
+//
+// Complex fast Fourier transforms of power-of-two length, for the spectral ocean.
+// Each 1D transform is a Stockham autosort FFT: radix-4 passes plus one radix-2
+// pass when log2(n) is odd, ping-ponging between the data and a scratch row, so
+// there is no bit-reversal permutation and every pass streams through memory in
+// order.  The 2D transform runs rows, then columns in blocks of ColumnBlock that
+// are gathered into contiguous rows first, split into bands on a WorkerPool.
+//
+// Transforms are unnormalised: Inverse(Forward(x)) is n*x per dimension.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+
+class WorkerPool;
+
+
+class FFT
+{
+public:
+    struct Complex
+    {
+        float Re;
+        float Im;
+    };
+
+    FFT();
+
+    // n must be a power of two.
+    void Init(UINT n);
+    UINT Size() const { return m_Size; }
+
+    // Transforms n values in place; scratch must hold n values.
+    //   Forward: X[k] = sum x[j] e^(-2 pi i jk/n)
+    //   Inverse: x[j] = sum X[k] e^(+2 pi i jk/n)
+    void Forward(Complex* data, Complex* scratch) const;
+    void Inverse(Complex* data, Complex* scratch) const;
+
+    // Transforms an n x n row-major grid in place.  The pool is not owned; nullptr
+    // runs serially.
+    void Forward2D(Complex* data, WorkerPool* pool);
+    void Inverse2D(Complex* data, WorkerPool* pool);
+
+private:
+    // Columns gathered per block: 8 complex values fill one 64-byte cache line.
+    static const UINT ColumnBlock = 8;
+
+    // Fewest rows (or column blocks) worth handing to another thread.
+    static const UINT MinBandItems = 4;
+
+    void Transform(Complex* data, Complex* scratch, bool inverse) const;
+    void Transform2D(Complex* data, WorkerPool* pool, bool inverse);
+
+    // Calls body(begin, end, scratch) over [0, count), one band per task, each band
+    // with its own ScratchPerBand() values of scratch.
+    template<typename Body>
+    void ForEachBand(UINT count, WorkerPool* pool, const Body& body);
+
+    size_t ScratchPerBand() const { return static_cast<size_t>(ColumnBlock + 1) * m_Size; }
+
+private:
+    UINT m_Size;
+
+    // e^(+2 pi i t/n) for t in [0, n); the forward transform uses the conjugates.
+    std::vector<Complex> m_Twiddles;
+
+    std::vector<Complex> m_Scratch;
+};
@@ -0,0 +1,99 @@
+//***************************************************************************************
+// FixedStepClock.h
+//
+// The fixed-timestep clock the wave solvers share.  Advance(dt) adds dt and returns
+// how many whole time steps are now owed, up to a substep budget.  Time beyond the
+// budget is dropped rather than carried, so a long stall cannot cause an
+// ever-growing catch-up.
+//
+// The time step is passed in rather than kept, so each solver's own copy stays the
+// only one.  Before the solver's Init sets it, it is 0, and then no steps are owed
+// and Alpha() is 0.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <algorithm>
+#include <cmath>
+#include "MathHelper.h"
+
+
+class FixedStepClock
+{
+public:
+    // At the demo's 0.03s step this covers frames of up to ~0.25s.
+    static const UINT DefaultMaxSubsteps = 8;
+
+    FixedStepClock() : m_Accumulator(0.0f), m_MaxSubsteps(DefaultMaxSubsteps), m_LastStepCount(0) {}
+
+    // Starts over with carried seconds of unsimulated time, e.g. from a checkpoint.
+    void Reset(float carried = 0.0f)
+    {
+        m_Accumulator = carried;
+        m_LastStepCount = 0;
+    }
+
+    // Adds dt and returns the number of steps to take now.
+    UINT Advance(float dt, float timeStep);
+
+    // Number of steps Advance(dt, timeStep) would return now.
+    UINT StepsDue(float dt, float timeStep) const
+    {
+        if (timeStep <= 0.0f)
+        {
+            return 0;
+        }
+
+        return std::min(static_cast<UINT>((m_Accumulator + dt) / timeStep), m_MaxSubsteps);
+    }
+
+    // Fraction of a step carried after the last Advance, in [0, 1).
+    float Alpha(float timeStep) const { return timeStep > 0.0f ? m_Accumulator / timeStep : 0.0f; }
+
+    // Unsimulated time carried, in seconds; always under one time step.
+    float Accumulator() const { return m_Accumulator; }
+
+    // Most steps a single Advance may return.
+    void SetMaxSubsteps(UINT maxSubsteps) { m_MaxSubsteps = maxSubsteps; }
+
+    // Steps the last Advance returned.
+    UINT LastStepCount() const { return m_LastStepCount; }
+
+private:
+    float m_Accumulator;
+    UINT m_MaxSubsteps;
+    UINT m_LastStepCount;
+};
+
+
+inline UINT FixedStepClock::Advance(float dt, float timeStep)
+{
+    if (timeStep <= 0.0f)
+    {
+        m_LastStepCount = 0;
+        return 0;
+    }
+
+    // Accumulate time.
+    m_Accumulator += dt;
+
+    // Take as many steps as the accumulated time pays for.
+    UINT stepCount = static_cast<UINT>(m_Accumulator / timeStep);
+    if (stepCount > m_MaxSubsteps)
+    {
+        // Over budget: drop the time we cannot afford to simulate.
+        stepCount = m_MaxSubsteps;
+        m_Accumulator = 0.0f;
+    }
+    else
+    {
+        // Rounding can leave a whole step; keep the remainder under one so that
+        // Alpha() stays below 1.
+        m_Accumulator = MathHelper::Clamp(m_Accumulator - stepCount * timeStep, 0.0f,
+            std::nextafter(timeStep, 0.0f));
+    }
+
+    m_LastStepCount = stepCount;
+    return stepCount;
+}
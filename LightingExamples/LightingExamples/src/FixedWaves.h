@@ -0,0 +1,427 @@
+//***************************************************************************************
+// FixedWaves.h
+//
+// The Waves solver for a grid whose size is fixed at build time, e.g. the demo's
+// FixedWaves<160, 160>.  With Rows and Cols template arguments the row pitch, plane
+// size and row trip counts are constants, and each pass runs a FixedWavesKernels
+// band kernel instead of one WavesKernels call per row.  The interface follows
+// Waves, and heights and normals are bit-identical to Waves at the same Isa.
+//
+// WaveConstants computes the simulation constants from known parameters at compile
+// time and checks the scheme's stability condition, so a bad time step fails the
+// build instead of blowing up at runtime.
+//
+// Like CompactWaves, temporal blocking, active tiles, the fused sweep and the
+// disturbance queue are left to Waves.
+//***************************************************************************************
+
+#pragma once
+
+#include "Waves.h"
+#include "FixedWavesKernels.h"
+#include "WaveSnapshot.h"
+#include "WorkerPool.h"
+#include "AlignedPlanes.h"
+#include "FixedStepClock.h"
+#include "MathHelper.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+// The constants of the damped wave equation scheme for spacing dx, time step dt,
+// wave speed and damping; the same values Waves::Init computes.
+struct WaveConstants
+{
+    constexpr WaveConstants()
+        : SpatialStep(0.0f), TimeStep(0.0f), K1(0.0f), K2(0.0f), K3(0.0f), StabilityRatio(0.0f) {}
+
+    constexpr WaveConstants(float dx, float dt, float speed, float damping)
+        : SpatialStep(dx), TimeStep(dt)
+        , K1((damping * dt - 2.0f) / (damping * dt + 2.0f))
+        , K2((4.0f - 8.0f * ((speed * speed) * (dt * dt) / (dx * dx))) / (damping * dt + 2.0f))
+        , K3((2.0f * ((speed * speed) * (dt * dt) / (dx * dx))) / (damping * dt + 2.0f))
+        , StabilityRatio(4.0f * ((speed * speed) * (dt * dt) / (dx * dx)) / (damping * dt + 2.0f)) {}
+
+    // The scheme is stable for 0 < dt < dx/(2c) * sqrt(damping*dt + 2), i.e. while
+    // 4c^2 dt^2 / dx^2 < damping*dt + 2.
+    constexpr bool IsStable() const { return TimeStep > 0.0f && SpatialStep > 0.0f && StabilityRatio < 1.0f; }
+
+    float SpatialStep;
+    float TimeStep;
+
+    float K1;
+    float K2;
+    float K3;
+
+    // 4c^2 dt^2 / (dx^2 (damping*dt + 2)), below 1 when stable.
+    float StabilityRatio;
+};
+
+
+template<UINT Rows, UINT Cols>
+class FixedWaves
+{
+    static_assert(Rows >= 3 && Cols >= 3, "FixedWaves needs at least one interior point.");
+
+public:
+    // Floats per plane row: Cols rounded up to a 64-byte line, as in Waves.
+    static const UINT Pitch = (Cols + 15) / 16 * 16;
+    static const UINT PlaneSize = Rows * Pitch;
+
+    typedef FixedWavesKernels<Cols - 2, Pitch> Kernels;
+
+public:
+    FixedWaves();
+    ~FixedWaves();
+
+    FixedWaves(const FixedWaves&) = delete;
+    FixedWaves& operator=(const FixedWaves&) = delete;
+
+    static UINT RowCount() { return Rows; }
+    static UINT ColumnCount() { return Cols; }
+    static UINT VertexCount() { return Rows * Cols; }
+    static UINT TriangleCount() { return (Rows - 1) * (Cols - 1) * 2; }
+
+    // Returns the solution at the ith grid point.
+    XMFLOAT3 operator[](int i) const
+    {
+        UINT row = i / Cols;
+        UINT col = i % Cols;
+
+        return XMFLOAT3(GridX(col), m_CurrHeights[row * Pitch + col], GridZ(row));
+    }
+
+    XMFLOAT3 Normal(int i) const
+    {
+        UINT k = (i / Cols) * Pitch + i % Cols;
+
+        return XMFLOAT3(m_NormalX[k], m_NormalY[k], m_NormalZ[k]);
+    }
+
+    XMFLOAT3 TangentX(int i) const
+    {
+        UINT k = (i / Cols) * Pitch + i % Cols;
+
+        return XMFLOAT3(m_TangentXX[k], m_TangentXY[k], 0.0f);
+    }
+
+    static UINT RowPitch() { return Pitch; }
+    const float* Heights() const { return m_CurrHeights; }
+    float Height(UINT i, UINT j) const { return m_CurrHeights[i * Pitch + j]; }
+    float PreviousHeight(UINT i, UINT j) const { return m_PrevHeights[i * Pitch + j]; }
+
+    // As Waves::SetHeight.
+    void SetHeight(UINT i, UINT j, float height, float previousHeight)
+    {
+        m_CurrHeights[i * Pitch + j] = height;
+        m_PrevHeights[i * Pitch + j] = previousHeight;
+    }
+
+    void RecomputeNormals();
+
+    float GridX(UINT j) const { return -m_HalfWidth + j * m_Constants.SpatialStep; }
+    float GridZ(UINT i) const { return m_HalfDepth - i * m_Constants.SpatialStep; }
+
+    float TimeStep() const { return m_Constants.TimeStep; }
+    float SpatialStep() const { return m_Constants.SpatialStep; }
+
+    void WriteVertices(const Waves::VertexStream& stream) const { WriteVertices(stream, 0, Rows); }
+    void WriteVertices(const Waves::VertexStream& stream, UINT rowBegin, UINT rowEnd) const;
+
+    void SampleSurface(const Waves::SurfaceQuery& query) const;
+    void CaptureSnapshot(WaveSnapshot& snapshot,
+        Waves::SnapshotFormat format = Waves::SnapshotFormat::HeightsAndNormals) const;
+
+    // Resets to flat water with the given constants, e.g. a constexpr WaveConstants
+    // checked with static_assert(constants.IsStable()).
+    void Init(const WaveConstants& constants);
+
+    // Waves::Init's signature; m and n must be Rows and Cols.
+    void Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
+    {
+        assert(m == Rows && n == Cols);
+        Init(WaveConstants(dx, dt, speed, damping));
+    }
+
+    void SetKernelIsa(WavesKernels::Isa isa)
+    {
+        m_Kernels = Kernels::Select(isa);
+        m_Sample = WavesKernels::Select(isa).Sample;
+    }
+
+    WavesKernels::Isa KernelIsa() const { return m_Kernels.Level; }
+
+    void SetWorkerPool(WorkerPool* pool) { m_WorkerPool = pool; }
+
+    void SetMaxSubsteps(UINT maxSubsteps) { m_Clock.SetMaxSubsteps(maxSubsteps); }
+    UINT LastStepCount() const { return m_Clock.LastStepCount(); }
+    float InterpolationAlpha() const { return m_Clock.Alpha(m_Constants.TimeStep); }
+    double SimulatedTime() const { return m_TotalStepCount * static_cast<double>(m_Constants.TimeStep); }
+
+    UINT Revision() const { return m_Revision; }
+
+    // Same fixed-timestep semantics as Waves::Update.
+    void Update(float dt, const Waves::VertexStream* stream = nullptr);
+    UINT StepsDue(float dt) const;
+    void Step(UINT stepCount, const Waves::VertexStream* stream = nullptr);
+    void Disturb(UINT i, UINT j, float magnitude);
+
+private:
+    void ComputeNormals(UINT rowBegin, UINT rowEnd, const Waves::VertexStream* stream);
+    void WriteVertexRow(const Waves::VertexStream& stream, UINT i) const;
+
+    // Calls body(rowBegin, rowEnd) over the interior rows, one band per task.
+    template<typename Body>
+    void ForEachRowBand(const Body& body);
+
+private:
+    WaveConstants m_Constants;
+
+    float m_HalfWidth;
+    float m_HalfDepth;
+
+    // One aligned block holding all planes below.
+    float* m_Storage;
+
+    float* m_PrevHeights;
+    float* m_CurrHeights;
+    float* m_NormalX;
+    float* m_NormalY;
+    float* m_NormalZ;
+    float* m_TangentXX;
+    float* m_TangentXY;
+
+    Kernels m_Kernels;
+    WavesKernels::SampleFn m_Sample;
+    WorkerPool* m_WorkerPool;
+
+    FixedStepClock m_Clock;
+    UINT m_TotalStepCount;
+
+    UINT m_Revision;
+};
+
+template<UINT Rows, UINT Cols>
+FixedWaves<Rows, Cols>::FixedWaves()
+    : m_HalfWidth(0.0f), m_HalfDepth(0.0f)
+    , m_Storage(static_cast<float*>(AlignedPlanes::Alloc(7 * static_cast<size_t>(PlaneSize) * sizeof(float))))
+    , m_Kernels(Kernels::Select(WavesKernels::Isa::AVX512))
+    , m_Sample(WavesKernels::Select(WavesKernels::Isa::AVX512).Sample), m_WorkerPool(nullptr)
+    , m_TotalStepCount(0)
+    , m_Revision(0)
+{
+    m_PrevHeights = m_Storage;
+    m_CurrHeights = m_Storage + PlaneSize;
+    m_NormalX = m_Storage + 2 * PlaneSize;
+    m_NormalY = m_Storage + 3 * PlaneSize;
+    m_NormalZ = m_Storage + 4 * PlaneSize;
+    m_TangentXX = m_Storage + 5 * PlaneSize;
+    m_TangentXY = m_Storage + 6 * PlaneSize;
+
+    Init(WaveConstants());
+}
+
+template<UINT Rows, UINT Cols>
+FixedWaves<Rows, Cols>::~FixedWaves()
+{
+    AlignedPlanes::Free(m_Storage);
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::Init(const WaveConstants& constants)
+{
+    m_Constants = constants;
+
+    m_HalfWidth = (Cols - 1) * constants.SpatialStep * 0.5f;
+    m_HalfDepth = (Rows - 1) * constants.SpatialStep * 0.5f;
+
+    m_Clock.Reset();
+    m_TotalStepCount = 0;
+
+    // Flat water, padding included.
+    std::fill(m_PrevHeights, m_PrevHeights + PlaneSize, 0.0f);
+    std::fill(m_CurrHeights, m_CurrHeights + PlaneSize, 0.0f);
+    std::fill(m_NormalX, m_NormalX + PlaneSize, 0.0f);
+    std::fill(m_NormalY, m_NormalY + PlaneSize, 1.0f);
+    std::fill(m_NormalZ, m_NormalZ + PlaneSize, 0.0f);
+    std::fill(m_TangentXX, m_TangentXX + PlaneSize, 1.0f);
+    std::fill(m_TangentXY, m_TangentXY + PlaneSize, 0.0f);
+
+    ++m_Revision;
+}
+
+template<UINT Rows, UINT Cols>
+UINT FixedWaves<Rows, Cols>::StepsDue(float dt) const
+{
+    return m_Clock.StepsDue(dt, m_Constants.TimeStep);
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::Update(float dt, const Waves::VertexStream* stream)
+{
+    Step(m_Clock.Advance(dt, m_Constants.TimeStep), stream);
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::Step(UINT stepCount, const Waves::VertexStream* stream)
+{
+    if (stepCount == 0)
+    {
+        return;
+    }
+
+    m_TotalStepCount += stepCount;
+
+    for (UINT s = 0; s < stepCount; ++s)
+    {
+        // Only interior points are stepped; the boundary stays at zero.
+        ForEachRowBand([this](UINT rowBegin, UINT rowEnd)
+        {
+            m_Kernels.StepRows(m_PrevHeights, m_CurrHeights, rowBegin, rowEnd,
+                m_Constants.K1, m_Constants.K2, m_Constants.K3);
+        });
+
+        std::swap(m_PrevHeights, m_CurrHeights);
+    }
+
+    ForEachRowBand([this, stream](UINT rowBegin, UINT rowEnd) { ComputeNormals(rowBegin, rowEnd, stream); });
+
+    if (stream)
+    {
+        WriteVertexRow(*stream, 0);
+        WriteVertexRow(*stream, Rows - 1);
+    }
+
+    ++m_Revision;
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::ComputeNormals(UINT rowBegin, UINT rowEnd, const Waves::VertexStream* stream)
+{
+    m_Kernels.NormalRows(m_CurrHeights, rowBegin, rowEnd, 2.0f * m_Constants.SpatialStep,
+        m_NormalX, m_NormalY, m_NormalZ, m_TangentXX, m_TangentXY);
+
+    // Written while the band is still in cache.
+    if (stream)
+    {
+        WriteVertices(*stream, rowBegin, rowEnd);
+    }
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::RecomputeNormals()
+{
+    ForEachRowBand([this](UINT rowBegin, UINT rowEnd) { ComputeNormals(rowBegin, rowEnd, nullptr); });
+    ++m_Revision;
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::Disturb(UINT i, UINT j, float magnitude)
+{
+    // Don't disturb boundaries.
+    assert(i > 1 && i < Rows - 2);
+    assert(j > 1 && j < Cols - 2);
+
+    float halfMag = 0.5f * magnitude;
+
+    float* h = m_CurrHeights + i * Pitch + j;
+    h[0] += magnitude;
+    h[1] += halfMag;
+    h[-1] += halfMag;
+    h[Pitch] += halfMag;
+    h[-static_cast<int>(Pitch)] += halfMag;
+
+    ++m_Revision;
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::WriteVertexRow(const Waves::VertexStream& stream, UINT i) const
+{
+    const float* h = m_CurrHeights + i * Pitch;
+    const float* nx = m_NormalX + i * Pitch;
+    const float* ny = m_NormalY + i * Pitch;
+    const float* nz = m_NormalZ + i * Pitch;
+    float z = GridZ(i);
+
+    BYTE* v = static_cast<BYTE*>(stream.Data) + static_cast<size_t>(i) * Cols * stream.Stride;
+    for (UINT j = 0; j < Cols; ++j, v += stream.Stride)
+    {
+        float* position = reinterpret_cast<float*>(v + stream.PositionOffset);
+        position[0] = GridX(j);
+        position[1] = h[j];
+        position[2] = z;
+
+        float* normal = reinterpret_cast<float*>(v + stream.NormalOffset);
+        normal[0] = nx[j];
+        normal[1] = ny[j];
+        normal[2] = nz[j];
+    }
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::WriteVertices(const Waves::VertexStream& stream, UINT rowBegin, UINT rowEnd) const
+{
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        WriteVertexRow(stream, i);
+    }
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::SampleSurface(const Waves::SurfaceQuery& query) const
+{
+    WavesKernels::HeightField field;
+    field.Heights = m_CurrHeights;
+    field.RowCount = Rows;
+    field.ColumnCount = Cols;
+    field.Pitch = Pitch;
+    field.X0 = query.Origin.x - m_HalfWidth;
+    field.Z0 = query.Origin.z + m_HalfDepth;
+    field.Y0 = query.Origin.y;
+    field.InvDx = 1.0f / m_Constants.SpatialStep;
+    field.TwoDx = 2.0f * m_Constants.SpatialStep;
+
+    m_Sample(field, query.X, query.Z, query.Count,
+        query.Heights, query.NormalX, query.NormalY, query.NormalZ);
+}
+
+template<UINT Rows, UINT Cols>
+void FixedWaves<Rows, Cols>::CaptureSnapshot(WaveSnapshot& snapshot, Waves::SnapshotFormat format) const
+{
+    snapshot.RowCount = Rows;
+    snapshot.ColumnCount = Cols;
+    snapshot.SpatialStep = m_Constants.SpatialStep;
+    snapshot.Revision = m_Revision;
+    snapshot.SimulatedTime = SimulatedTime();
+
+    bool withNormals = format == Waves::SnapshotFormat::HeightsAndNormals;
+    snapshot.Heights.resize(Rows * Cols);
+    snapshot.Normals.resize(withNormals ? Rows * Cols : 0);
+
+    for (UINT i = 0; i < Rows; ++i)
+    {
+        const float* h = m_CurrHeights + i * Pitch;
+        std::copy(h, h + Cols, snapshot.Heights.begin() + i * Cols);
+
+        if (!withNormals)
+        {
+            continue;
+        }
+
+        XMFLOAT3* n = &snapshot.Normals[i * Cols];
+        for (UINT j = 0; j < Cols; ++j)
+        {
+            UINT k = i * Pitch + j;
+            n[j] = XMFLOAT3(m_NormalX[k], m_NormalY[k], m_NormalZ[k]);
+        }
+    }
+}
+
+template<UINT Rows, UINT Cols>
+template<typename Body>
+void FixedWaves<Rows, Cols>::ForEachRowBand(const Body& body)
+{
+    WorkerPool::ForEachBand(m_WorkerPool, 1, Rows - 1, WorkerPool::MinBandRows,
+        [&](UINT rowBegin, UINT rowEnd, UINT) { body(rowBegin, rowEnd); });
+}
@@ -0,0 +1,363 @@
+//***************************************************************************************
+// FixedWavesKernels.h
+//
+// The WavesKernels step and normal kernels for a grid whose width is known at
+// compile time.  Count is the number of interior columns and Pitch the floats per
+// plane row, so a kernel call covers a band of whole rows: neighbouring rows are
+// immediate offsets and every row splits into a fixed number of full vectors and a
+// fixed tail, with no per-row dispatch or trip count checks.
+//
+// Each kernel performs the same operations in the same order as its WavesKernels
+// counterpart, so results are bit-for-bit identical to Waves at the same Isa.
+//***************************************************************************************
+
+#pragma once
+
+#include "WavesKernels.h"
+#include "SimdTarget.h"
+#include <cmath>
+
+
+// As in WavesKernels.cpp: no FMA contraction, so rounding matches the scalar path.
+SIMD_FP_CONTRACT_OFF_BEGIN
+
+template<UINT Count, UINT Pitch>
+class FixedWavesKernels
+{
+public:
+    // Steps rows [rowBegin, rowEnd) in place, as WavesKernels::StepRowFn does for one
+    // row.  prev and curr address column 0 of row 0 of their planes.
+    typedef void (*StepRowsFn)(float* prev, const float* curr, UINT rowBegin, UINT rowEnd,
+        float k1, float k2, float k3);
+
+    // Computes the normals and x-tangents of rows [rowBegin, rowEnd), as
+    // WavesKernels::NormalRowFn does for one row.  Every pointer addresses column 0
+    // of row 0 of its plane.
+    typedef void (*NormalRowsFn)(const float* heights, UINT rowBegin, UINT rowEnd, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty);
+
+    FixedWavesKernels() : Level(WavesKernels::Isa::Scalar), StepRows(StepRowsScalar), NormalRows(NormalRowsScalar) {}
+
+    // Returns the kernels for the given instruction set, or for the widest one the
+    // CPU and OS support if that is lower.
+    static FixedWavesKernels Select(WavesKernels::Isa isa)
+    {
+        FixedWavesKernels kernels;
+        kernels.Level = WavesKernels::Select(isa).Level;
+
+        switch (kernels.Level)
+        {
+        case WavesKernels::Isa::SSE2:
+            kernels.StepRows = StepRowsSSE2;
+            kernels.NormalRows = NormalRowsSSE2;
+            break;
+        case WavesKernels::Isa::AVX2:
+            kernels.StepRows = StepRowsAVX2;
+            kernels.NormalRows = NormalRowsAVX2;
+            break;
+        case WavesKernels::Isa::AVX512:
+            kernels.StepRows = StepRowsAVX512;
+            kernels.NormalRows = NormalRowsAVX512;
+            break;
+        default:
+            break;
+        }
+
+        return kernels;
+    }
+
+    WavesKernels::Isa Level;
+    StepRowsFn StepRows;
+    NormalRowsFn NormalRows;
+
+private:
+    // Cells of a row covered by whole vectors, and the AVX-512 tail's lanes.
+    static const UINT Avx2Cells = Count / 8 * 8;
+    static const UINT Avx512Cells = Count / 16 * 16;
+    static const __mmask16 TailMask = static_cast<__mmask16>((1u << (Count - Avx512Cells)) - 1);
+
+    //
+    // Scalar reference kernels.
+    //
+
+    static void StepCell(float* prev, const float* curr, float k1, float k2, float k3)
+    {
+        *prev = k1 * *prev + k2 * *curr + k3 * (curr[Pitch] + curr[-static_cast<int>(Pitch)] + curr[1] + curr[-1]);
+    }
+
+    static void NormalCell(const float* h, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        float l = h[-1];
+        float r = h[1];
+        float x = l - r;
+        float z = h[Pitch] - h[-static_cast<int>(Pitch)];
+        float len = sqrtf((x * x + twoDx * twoDx) + z * z);
+        *nx = x / len;
+        *ny = twoDx / len;
+        *nz = z / len;
+
+        float y = r - l;
+        float tlen = sqrtf((twoDx * twoDx + y * y) + 0.0f);
+        *tx = twoDx / tlen;
+        *ty = y / tlen;
+    }
+
+    static void StepRowsScalar(float* prev, const float* curr, UINT rowBegin, UINT rowEnd,
+        float k1, float k2, float k3)
+    {
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            UINT k = i * Pitch + 1;
+            for (UINT j = 0; j < Count; ++j)
+            {
+                StepCell(prev + k + j, curr + k + j, k1, k2, k3);
+            }
+        }
+    }
+
+    static void NormalRowsScalar(const float* heights, UINT rowBegin, UINT rowEnd, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            UINT k = i * Pitch + 1;
+            for (UINT j = k; j < k + Count; ++j)
+            {
+                NormalCell(heights + j, twoDx, nx + j, ny + j, nz + j, tx + j, ty + j);
+            }
+        }
+    }
+
+    //
+    // SSE2 kernels, 4 cells per instruction.  The Sse2* helpers handle the cells
+    // [begin, Count) of one row, so the wider kernels can finish rows with them.
+    //
+
+    static void Sse2StepTail(float* prev, const float* curr, UINT begin, __m128 vk1, __m128 vk2, __m128 vk3,
+        float k1, float k2, float k3)
+    {
+        UINT j = begin;
+        for (; j + 4 <= Count; j += 4)
+        {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(curr + j + Pitch), _mm_loadu_ps(curr + j - Pitch));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+            __m128 h = _mm_mul_ps(vk1, _mm_loadu_ps(prev + j));
+            h = _mm_add_ps(h, _mm_mul_ps(vk2, _mm_loadu_ps(curr + j)));
+            h = _mm_add_ps(h, _mm_mul_ps(vk3, sum));
+            _mm_storeu_ps(prev + j, h);
+        }
+
+        for (; j < Count; ++j)
+        {
+            StepCell(prev + j, curr + j, k1, k2, k3);
+        }
+    }
+
+    static void Sse2NormalTail(const float* h, UINT begin, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m128 vTwoDx = _mm_set1_ps(twoDx);
+        __m128 vTwoDxSq = _mm_mul_ps(vTwoDx, vTwoDx);
+        __m128 zero = _mm_setzero_ps();
+
+        UINT j = begin;
+        for (; j + 4 <= Count; j += 4)
+        {
+            __m128 l = _mm_loadu_ps(h + j - 1);
+            __m128 r = _mm_loadu_ps(h + j + 1);
+            __m128 x = _mm_sub_ps(l, r);
+            __m128 z = _mm_sub_ps(_mm_loadu_ps(h + j + Pitch), _mm_loadu_ps(h + j - Pitch));
+
+            __m128 lenSq = _mm_add_ps(_mm_mul_ps(x, x), vTwoDxSq);
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(lenSq, _mm_mul_ps(z, z)));
+            _mm_storeu_ps(nx + j, _mm_div_ps(x, len));
+            _mm_storeu_ps(ny + j, _mm_div_ps(vTwoDx, len));
+            _mm_storeu_ps(nz + j, _mm_div_ps(z, len));
+
+            __m128 y = _mm_sub_ps(r, l);
+            __m128 tlen = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(vTwoDxSq, _mm_mul_ps(y, y)), zero));
+            _mm_storeu_ps(tx + j, _mm_div_ps(vTwoDx, tlen));
+            _mm_storeu_ps(ty + j, _mm_div_ps(y, tlen));
+        }
+
+        for (; j < Count; ++j)
+        {
+            NormalCell(h + j, twoDx, nx + j, ny + j, nz + j, tx + j, ty + j);
+        }
+    }
+
+    static void StepRowsSSE2(float* prev, const float* curr, UINT rowBegin, UINT rowEnd,
+        float k1, float k2, float k3)
+    {
+        __m128 vk1 = _mm_set1_ps(k1);
+        __m128 vk2 = _mm_set1_ps(k2);
+        __m128 vk3 = _mm_set1_ps(k3);
+
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            UINT k = i * Pitch + 1;
+            Sse2StepTail(prev + k, curr + k, 0, vk1, vk2, vk3, k1, k2, k3);
+        }
+    }
+
+    static void NormalRowsSSE2(const float* heights, UINT rowBegin, UINT rowEnd, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            UINT k = i * Pitch + 1;
+            Sse2NormalTail(heights + k, 0, twoDx, nx + k, ny + k, nz + k, tx + k, ty + k);
+        }
+    }
+
+    //
+    // AVX2 kernels, 8 cells per instruction, finishing each row with SSE2.
+    //
+
+    SIMD_TARGET_AVX2 static void StepRowsAVX2(float* prev, const float* curr, UINT rowBegin, UINT rowEnd,
+        float k1, float k2, float k3)
+    {
+        __m256 vk1 = _mm256_set1_ps(k1);
+        __m256 vk2 = _mm256_set1_ps(k2);
+        __m256 vk3 = _mm256_set1_ps(k3);
+
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            float* p = prev + i * Pitch + 1;
+            const float* c = curr + i * Pitch + 1;
+
+            for (UINT j = 0; j < Avx2Cells; j += 8)
+            {
+                __m256 sum = _mm256_add_ps(_mm256_loadu_ps(c + j + Pitch), _mm256_loadu_ps(c + j - Pitch));
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(c + j + 1));
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(c + j - 1));
+
+                __m256 h = _mm256_mul_ps(vk1, _mm256_loadu_ps(p + j));
+                h = _mm256_add_ps(h, _mm256_mul_ps(vk2, _mm256_loadu_ps(c + j)));
+                h = _mm256_add_ps(h, _mm256_mul_ps(vk3, sum));
+                _mm256_storeu_ps(p + j, h);
+            }
+
+            if (Avx2Cells < Count)
+            {
+                Sse2StepTail(p, c, Avx2Cells, _mm_set1_ps(k1), _mm_set1_ps(k2), _mm_set1_ps(k3), k1, k2, k3);
+            }
+        }
+    }
+
+    SIMD_TARGET_AVX2 static void NormalRowsAVX2(const float* heights, UINT rowBegin, UINT rowEnd, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m256 vTwoDx = _mm256_set1_ps(twoDx);
+        __m256 vTwoDxSq = _mm256_mul_ps(vTwoDx, vTwoDx);
+        __m256 zero = _mm256_setzero_ps();
+
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            UINT k = i * Pitch + 1;
+            const float* h = heights + k;
+
+            for (UINT j = 0; j < Avx2Cells; j += 8)
+            {
+                __m256 l = _mm256_loadu_ps(h + j - 1);
+                __m256 r = _mm256_loadu_ps(h + j + 1);
+                __m256 x = _mm256_sub_ps(l, r);
+                __m256 z = _mm256_sub_ps(_mm256_loadu_ps(h + j + Pitch), _mm256_loadu_ps(h + j - Pitch));
+
+                __m256 lenSq = _mm256_add_ps(_mm256_mul_ps(x, x), vTwoDxSq);
+                __m256 len = _mm256_sqrt_ps(_mm256_add_ps(lenSq, _mm256_mul_ps(z, z)));
+                _mm256_storeu_ps(nx + k + j, _mm256_div_ps(x, len));
+                _mm256_storeu_ps(ny + k + j, _mm256_div_ps(vTwoDx, len));
+                _mm256_storeu_ps(nz + k + j, _mm256_div_ps(z, len));
+
+                __m256 y = _mm256_sub_ps(r, l);
+                __m256 tlen = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(vTwoDxSq, _mm256_mul_ps(y, y)), zero));
+                _mm256_storeu_ps(tx + k + j, _mm256_div_ps(vTwoDx, tlen));
+                _mm256_storeu_ps(ty + k + j, _mm256_div_ps(y, tlen));
+            }
+
+            if (Avx2Cells < Count)
+            {
+                Sse2NormalTail(h, Avx2Cells, twoDx, nx + k, ny + k, nz + k, tx + k, ty + k);
+            }
+        }
+    }
+
+    //
+    // AVX-512 kernels, 16 cells per instruction.  The row tail is one masked
+    // vector whose mask is a constant.
+    //
+
+    SIMD_TARGET_AVX512 static void StepRowsAVX512(float* prev, const float* curr, UINT rowBegin, UINT rowEnd,
+        float k1, float k2, float k3)
+    {
+        __m512 vk1 = _mm512_set1_ps(k1);
+        __m512 vk2 = _mm512_set1_ps(k2);
+        __m512 vk3 = _mm512_set1_ps(k3);
+
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            float* p = prev + i * Pitch + 1;
+            const float* c = curr + i * Pitch + 1;
+
+            // The last pass is the masked tail, if any.
+            for (UINT j = 0; j < Count; j += 16)
+            {
+                __mmask16 mask = j < Avx512Cells ? static_cast<__mmask16>(0xFFFF) : TailMask;
+
+                __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, c + j + Pitch), _mm512_maskz_loadu_ps(mask, c + j - Pitch));
+                sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(mask, c + j + 1));
+                sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(mask, c + j - 1));
+
+                __m512 h = _mm512_mul_ps(vk1, _mm512_maskz_loadu_ps(mask, p + j));
+                h = _mm512_add_ps(h, _mm512_mul_ps(vk2, _mm512_maskz_loadu_ps(mask, c + j)));
+                h = _mm512_add_ps(h, _mm512_mul_ps(vk3, sum));
+                _mm512_mask_storeu_ps(p + j, mask, h);
+            }
+        }
+    }
+
+    SIMD_TARGET_AVX512 static void NormalRowsAVX512(const float* heights, UINT rowBegin, UINT rowEnd, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m512 vTwoDx = _mm512_set1_ps(twoDx);
+        __m512 vTwoDxSq = _mm512_mul_ps(vTwoDx, vTwoDx);
+        __m512 zero = _mm512_setzero_ps();
+
+        // The same as _mm512_sqrt_ps; GCC 12 warns about that one's undefined
+        // pass-through operand once it is inlined into this loop.
+        const __mmask16 AllLanes = 0xFFFF;
+
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            UINT k = i * Pitch + 1;
+            const float* h = heights + k;
+
+            // The last pass is the masked tail, if any.
+            for (UINT j = 0; j < Count; j += 16)
+            {
+                __mmask16 mask = j < Avx512Cells ? AllLanes : TailMask;
+
+                __m512 l = _mm512_maskz_loadu_ps(mask, h + j - 1);
+                __m512 r = _mm512_maskz_loadu_ps(mask, h + j + 1);
+                __m512 x = _mm512_sub_ps(l, r);
+                __m512 z = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, h + j + Pitch), _mm512_maskz_loadu_ps(mask, h + j - Pitch));
+
+                __m512 lenSq = _mm512_add_ps(_mm512_mul_ps(x, x), vTwoDxSq);
+                __m512 len = _mm512_maskz_sqrt_ps(AllLanes, _mm512_add_ps(lenSq, _mm512_mul_ps(z, z)));
+                _mm512_mask_storeu_ps(nx + k + j, mask, _mm512_div_ps(x, len));
+                _mm512_mask_storeu_ps(ny + k + j, mask, _mm512_div_ps(vTwoDx, len));
+                _mm512_mask_storeu_ps(nz + k + j, mask, _mm512_div_ps(z, len));
+
+                __m512 y = _mm512_sub_ps(r, l);
+                __m512 tlen = _mm512_maskz_sqrt_ps(AllLanes, _mm512_add_ps(_mm512_add_ps(vTwoDxSq, _mm512_mul_ps(y, y)), zero));
+                _mm512_mask_storeu_ps(tx + k + j, mask, _mm512_div_ps(vTwoDx, tlen));
+                _mm512_mask_storeu_ps(ty + k + j, mask, _mm512_div_ps(y, tlen));
+            }
+        }
+    }
+};
+
+SIMD_FP_CONTRACT_OFF_END
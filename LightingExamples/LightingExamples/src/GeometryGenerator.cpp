@@ -4,266 +4,269 @@
 
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include <algorithm>
 
-
-void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
+namespace
 {
-    // Create the vertices.
-    Vertex v[24];
-
-    float w2 = 0.5f*width;
-    float h2 = 0.5f*height;
-    float d2 = 0.5f*depth;
-
-    // Fill in the front face vertex data.
-    v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-    v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    v[2] = Vertex(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-    v[3] = Vertex(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-    // Fill in the back face vertex data.
-    v[4] = Vertex(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-    v[5] = Vertex(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-    v[6] = Vertex(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    v[7] = Vertex(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-    // Fill in the top face vertex data.
-    v[8] = Vertex(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-    v[9] = Vertex(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    v[10] = Vertex(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-    v[11] = Vertex(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-    // Fill in the bottom face vertex data.
-    v[12] = Vertex(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-    v[13] = Vertex(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-    v[14] = Vertex(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    v[15] = Vertex(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-    // Fill in the left face vertex data.
-    v[16] = Vertex(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
-    v[17] = Vertex(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
-    v[18] = Vertex(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
-    v[19] = Vertex(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
-
-    // Fill in the right face vertex data.
-    v[20] = Vertex(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
-    v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-    v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
-    v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
-
-    meshData.Vertices.assign(&v[0], &v[24]);
-
-    // Create the indices.
-    UINT i[36];
-
-    // Fill in the front face index data
-    i[0] = 0; i[1] = 1; i[2] = 2;
-    i[3] = 0; i[4] = 2; i[5] = 3;
-
-    // Fill in the back face index data
-    i[6] = 4; i[7] = 5; i[8] = 6;
-    i[9] = 4; i[10] = 6; i[11] = 7;
-
-    // Fill in the top face index data
-    i[12] = 8; i[13] = 9; i[14] = 10;
-    i[15] = 8; i[16] = 10; i[17] = 11;
-
-    // Fill in the bottom face index data
-    i[18] = 12; i[19] = 13; i[20] = 14;
-    i[21] = 12; i[22] = 14; i[23] = 15;
-
-    // Fill in the left face index data
-    i[24] = 16; i[25] = 17; i[26] = 18;
-    i[27] = 16; i[28] = 18; i[29] = 19;
-
-    // Fill in the right face index data
-    i[30] = 20; i[31] = 21; i[32] = 22;
-    i[33] = 20; i[34] = 22; i[35] = 23;
-
-    meshData.Indices.assign(&i[0], &i[36]);
-}
+    // 20 * 4^13 faces still have a UINT index count; 14 levels would not.
+    const UINT MaxGeosphereSubdivisions = 13;
 
-void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
-{
-    meshData.Vertices.clear();
-    meshData.Indices.clear();
+    // The write step of the MeshData overloads, which keep every attribute.
+    struct CopyVertex
+    {
+        void operator()(GeometryGenerator::Vertex& out, const GeometryGenerator::Vertex& v) const
+        {
+            out = v;
+        }
+    };
 
-    // Compute the vertices stating at the top pole and moving down the stacks.
+    // Marks an unused slot in EdgeMidpointCache; no edge joins a vertex to itself.
+    const UINT64 EmptyEdge = ~0ull;
 
-    // Poles: note that there will be texture coordinate distortion as there is
-    // not a unique point on the texture map to assign to the pole when mapping
-    // a rectangular texture onto a sphere.
-    Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    // Maps an undirected edge to the vertex at its midpoint, adding the vertex the
+    // first time the edge is seen.  Open addressing with linear probing over a table
+    // kept at most 3/4 full.  The table is allocated once, for the most edges any
+    // level will look up, and each level uses as much of it as it needs.
+    class EdgeMidpointCache
+    {
+    public:
+        EdgeMidpointCache(size_t maxEdgeCount, MeshArena* arena) :
+            m_Keys(MeshAllocator<UINT64>(arena)),
+            m_Indices(MeshAllocator<UINT>(arena)),
+            m_Mask(0)
+        {
+            if (maxEdgeCount > 0)
+            {
+                size_t capacity = Capacity(maxEdgeCount);
+                m_Keys.resize(capacity);
+                m_Indices.resize(capacity);
+            }
+        }
 
-    meshData.Vertices.push_back(topVertex);
+        // Empties the table, sized for up to edgeCount edges.
+        void Reset(size_t edgeCount)
+        {
+            size_t capacity = Capacity(edgeCount);
+            std::fill(m_Keys.begin(), m_Keys.begin() + capacity, EmptyEdge);
+            m_Mask = capacity - 1;
+        }
 
-    float phiStep = XM_PI / stackCount;
-    float thetaStep = 2.0f*XM_PI / sliceCount;
+        // Slots in a table for maxEdgeCount edges: a power of two at least 4/3 as many.
+        static size_t Capacity(size_t maxEdgeCount)
+        {
+            size_t capacity = 16;
+            while (3 * capacity < 4 * maxEdgeCount)
+            {
+                capacity *= 2;
+            }
 
-    // Compute vertices for each stack ring (do not count the poles as rings).
-    for (UINT i = 1; i <= stackCount - 1; ++i)
-    {
-        float phi = i * phiStep;
+            return capacity;
+        }
 
-        // Vertices of ring.
-        for (UINT j = 0; j <= sliceCount; ++j)
+        // positions holds vertexCount positions stride bytes apart, with room for one
+        // more; a new midpoint goes there and bumps vertexCount.
+        UINT Get(BYTE* positions, UINT stride, UINT& vertexCount, UINT a, UINT b)
         {
-            float theta = j * thetaStep;
+            UINT64 key = a < b ? (static_cast<UINT64>(a) << 32) | b : (static_cast<UINT64>(b) << 32) | a;
+
+            size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & m_Mask;
+            while (m_Keys[slot] != key)
+            {
+                if (m_Keys[slot] == EmptyEdge)
+                {
+                    const XMFLOAT3& p = Position(positions, stride, a);
+                    const XMFLOAT3& q = Position(positions, stride, b);
+
+                    m_Keys[slot] = key;
+                    m_Indices[slot] = vertexCount;
+                    Position(positions, stride, vertexCount++) =
+                        XMFLOAT3(0.5f*(p.x + q.x), 0.5f*(p.y + q.y), 0.5f*(p.z + q.z));
+                    break;
+                }
+
+                slot = (slot + 1) & m_Mask;
+            }
+
+            return m_Indices[slot];
+        }
 
-            Vertex v;
+        static XMFLOAT3& Position(BYTE* positions, UINT stride, UINT i)
+        {
+            return *reinterpret_cast<XMFLOAT3*>(positions + static_cast<size_t>(i) * stride);
+        }
 
-            // spherical to cartesian
-            v.Position.x = radius * sinf(phi)*cosf(theta);
-            v.Position.y = radius * cosf(phi);
-            v.Position.z = radius * sinf(phi)*sinf(theta);
+    private:
+        std::vector<UINT64, MeshAllocator<UINT64>> m_Keys;
+        std::vector<UINT, MeshAllocator<UINT>> m_Indices;
+        size_t m_Mask;
+    };
 
-            // Partial derivative of P with respect to theta
-            v.TangentU.x = -radius * sinf(phi)*sinf(theta);
-            v.TangentU.y = 0.0f;
-            v.TangentU.z = +radius * sinf(phi)*cosf(theta);
+    // Edges the last level of a geosphere's subdivision looks up: three per triangle
+    // of the level before, shared edges counted twice.
+    size_t GeosphereEdgeCount(UINT numSubdivisions)
+    {
+        return numSubdivisions == 0 ? 0 : 60 * (static_cast<size_t>(1) << 2 * (numSubdivisions - 1));
+    }
 
-            XMVECTOR T = XMLoadFloat3(&v.TangentU);
-            XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+    //       v1
+    //       *
+    //      / \
+	//     /   \
+	//  m0*-----*m1
+    //   / \   / \
+	//  /   \ /   \
+	// *-----*-----*
+    // v0    m2     v2
+    //
+    // Splits each of the indexCount / 3 triangles in four, adding a position per edge.
+    void Subdivide(EdgeMidpointCache& midpoints, BYTE* positions, UINT stride, UINT& vertexCount,
+        UINT* indices, UINT& indexCount)
+    {
+        UINT numTris = indexCount / 3;
 
-            XMVECTOR p = XMLoadFloat3(&v.Position);
-            XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+        // Triangles sharing an edge share its midpoint, so a closed mesh gains one
+        // vertex per edge: 3/2 per triangle.
+        midpoints.Reset(3 * static_cast<size_t>(numTris));
 
-            v.TexC.x = theta / XM_2PI;
-            v.TexC.y = phi / XM_PI;
+        // Each triangle becomes four in place.  Triangle i's children go to 4i..4i+3,
+        // so walking backwards never overwrites a triangle that has yet to be read.
+        indexCount = 12 * numTris;
 
-            meshData.Vertices.push_back(v);
-        }
-    }
+        for (UINT i = numTris; i-- > 0; )
+        {
+            UINT v0 = indices[i * 3 + 0];
+            UINT v1 = indices[i * 3 + 1];
+            UINT v2 = indices[i * 3 + 2];
 
-    meshData.Vertices.push_back(bottomVertex);
+            // For subdivision, we just care about the position component.  We derive the other
+            // vertex components in CreateGeosphere.
+            UINT m0 = midpoints.Get(positions, stride, vertexCount, v0, v1);
+            UINT m1 = midpoints.Get(positions, stride, vertexCount, v1, v2);
+            UINT m2 = midpoints.Get(positions, stride, vertexCount, v0, v2);
 
-    // Compute indices for top stack.  The top stack was written first to the vertex buffer
-    // and connects the top pole to the first ring.
+            UINT* k = &indices[i * 12];
 
-    for (UINT i = 1; i <= sliceCount; ++i)
-    {
-        meshData.Indices.push_back(0);
-        meshData.Indices.push_back(i + 1);
-        meshData.Indices.push_back(i);
-    }
+            k[0] = v0;
+            k[1] = m0;
+            k[2] = m2;
 
-    // Compute indices for inner stacks (not connected to poles).
+            k[3] = m0;
+            k[4] = m1;
+            k[5] = m2;
 
-    // Offset the indices to the index of the first vertex in the first ring.
-    // This is just skipping the top pole vertex.
-    
-    UINT baseIndex = 1;
-    UINT ringVertexCount = sliceCount + 1;
-    for (UINT i = 0; i < stackCount - 2; ++i)
-    {
-        for (UINT j = 0; j < sliceCount; ++j)
-        {
-            meshData.Indices.push_back(baseIndex + i * ringVertexCount + j);
-            meshData.Indices.push_back(baseIndex + i * ringVertexCount + j + 1);
-            meshData.Indices.push_back(baseIndex + (i + 1)*ringVertexCount + j);
+            k[6] = m2;
+            k[7] = m1;
+            k[8] = v2;
 
-            meshData.Indices.push_back(baseIndex + (i + 1)*ringVertexCount + j);
-            meshData.Indices.push_back(baseIndex + i * ringVertexCount + j + 1);
-            meshData.Indices.push_back(baseIndex + (i + 1)*ringVertexCount + j + 1);
+            k[9] = m0;
+            k[10] = v1;
+            k[11] = m1;
         }
     }
+}
 
-    // Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-    // and connects the bottom pole to the bottom ring.
-
-    // South pole vertex was added last.
-    UINT southPoleIndex = (UINT)meshData.Vertices.size() - 1;
 
-    // Offset the indices to the index of the first vertex in the last ring.
-    baseIndex = southPoleIndex - ringVertexCount;
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize()
+{
+    MeshSize size = { 24, 36 };
+    return size;
+}
 
-    for (UINT i = 0; i < sliceCount; ++i)
-    {
-        meshData.Indices.push_back(southPoleIndex);
-        meshData.Indices.push_back(baseIndex + i);
-        meshData.Indices.push_back(baseIndex + i + 1);
-    }
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(UINT sliceCount, UINT stackCount)
+{
+    // Two poles and stackCount - 1 rings; a fan at each pole and quads in between.
+    MeshSize size = { 2 + (stackCount - 1)*(sliceCount + 1), 6 * sliceCount*(stackCount - 1) };
+    return size;
 }
 
-void GeometryGenerator::Subdivide(MeshData& meshData)
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(UINT numSubdivisions)
 {
-    // Save a copy of the input geometry.
-    MeshData inputCopy = meshData;
+    // Each subdivision quadruples the 20 faces of the icosahedron; the closed
+    // surface keeps V - E + F = 2, so with E = 3F/2 there are F/2 + 2 vertices.
+    numSubdivisions = MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
 
-    meshData.Vertices.resize(0);
-    meshData.Indices.resize(0);
+    UINT faceCount = 20;
+    for (UINT i = 0; i < numSubdivisions; ++i)
+        faceCount *= 4;
 
-    //       v1
-    //       *
-    //      / \
-	//     /   \
-	//  m0*-----*m1
-    //   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-    // v0    m2     v2
-    
-    UINT numTris = static_cast<UINT>(inputCopy.Indices.size() / 3);
-    for (UINT i = 0; i < numTris; ++i)
-    {
-        Vertex v0 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 0]];
-        Vertex v1 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 1]];
-        Vertex v2 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 2]];
+    MeshSize size = { faceCount / 2 + 2, 3 * faceCount };
+    return size;
+}
 
-        // Generate the midpoints.
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(UINT sliceCount, UINT stackCount)
+{
+    // stackCount + 1 rings, plus a ring and a center vertex for each cap.
+    MeshSize size = { (stackCount + 1)*(sliceCount + 1) + 2 * (sliceCount + 2), 6 * sliceCount*(stackCount + 1) };
+    return size;
+}
 
-        Vertex m0, m1, m2;
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(UINT m, UINT n)
+{
+    MeshSize size = { m * n, 6 * (m - 1)*(n - 1) };
+    return size;
+}
 
-        // For subdivision, we just care about the position component.  We derive the other
-        // vertex components in CreateGeosphere.
+void GeometryGenerator::CreateGridIndices(UINT n, UINT rowBegin, UINT rowEnd, UINT* indices)
+{
+    // Iterate over each quad and compute indices.
+    UINT k = 6 * (n - 1)*rowBegin;
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        for (UINT j = 0; j < n - 1; ++j)
+        {
+            indices[k] = i * n + j;
+            indices[k + 1] = i * n + j + 1;
+            indices[k + 2] = (i + 1)*n + j;
 
-        m0.Position = XMFLOAT3(
-            0.5f*(v0.Position.x + v1.Position.x),
-            0.5f*(v0.Position.y + v1.Position.y),
-            0.5f*(v0.Position.z + v1.Position.z));
+            indices[k + 3] = (i + 1)*n + j;
+            indices[k + 4] = i * n + j + 1;
+            indices[k + 5] = (i + 1)*n + j + 1;
 
-        m1.Position = XMFLOAT3(
-            0.5f*(v1.Position.x + v2.Position.x),
-            0.5f*(v1.Position.y + v2.Position.y),
-            0.5f*(v1.Position.z + v2.Position.z));
+            k += 6; // next quad
+        }
+    }
+}
 
-        m2.Position = XMFLOAT3(
-            0.5f*(v0.Position.x + v2.Position.x),
-            0.5f*(v0.Position.y + v2.Position.y),
-            0.5f*(v0.Position.z + v2.Position.z));
+GeometryGenerator::MeshSize GeometryGenerator::FullscreenQuadSize()
+{
+    MeshSize size = { 4, 6 };
+    return size;
+}
 
-        // Add new geometry.
+size_t GeometryGenerator::ArenaBytes(const MeshSize& size)
+{
+    return size.VertexCount * sizeof(Vertex) + alignof(Vertex) - 1 +
+        size.IndexCount * sizeof(UINT) + alignof(UINT) - 1;
+}
 
-        meshData.Vertices.push_back(v0); // 0
-        meshData.Vertices.push_back(v1); // 1
-        meshData.Vertices.push_back(v2); // 2
-        meshData.Vertices.push_back(m0); // 3
-        meshData.Vertices.push_back(m1); // 4
-        meshData.Vertices.push_back(m2); // 5
+size_t GeometryGenerator::GeosphereScratchBytes(UINT numSubdivisions)
+{
+    numSubdivisions = MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
 
-        meshData.Indices.push_back(i * 6 + 0);
-        meshData.Indices.push_back(i * 6 + 3);
-        meshData.Indices.push_back(i * 6 + 5);
+    size_t edgeSlots = numSubdivisions == 0 ? 0 : EdgeMidpointCache::Capacity(GeosphereEdgeCount(numSubdivisions));
 
-        meshData.Indices.push_back(i * 6 + 3);
-        meshData.Indices.push_back(i * 6 + 4);
-        meshData.Indices.push_back(i * 6 + 5);
+    return edgeSlots * sizeof(UINT64) + alignof(UINT64) - 1 +
+        edgeSlots * sizeof(UINT) + alignof(UINT) - 1 +
+        GeosphereSize(numSubdivisions).VertexCount * sizeof(XMFLOAT3) + alignof(XMFLOAT3) - 1;
+}
 
-        meshData.Indices.push_back(i * 6 + 5);
-        meshData.Indices.push_back(i * 6 + 4);
-        meshData.Indices.push_back(i * 6 + 2);
+void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
+{
+    meshData.Resize(BoxSize());
+    CreateBox<AllAttributes>(width, height, depth, meshData.Vertices.data(), meshData.Indices.data(), CopyVertex());
+}
 
-        meshData.Indices.push_back(i * 6 + 3);
-        meshData.Indices.push_back(i * 6 + 1);
-        meshData.Indices.push_back(i * 6 + 4);
-    }
+void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
+{
+    meshData.Resize(SphereSize(sliceCount, stackCount));
+    CreateSphere<AllAttributes>(radius, sliceCount, stackCount, meshData.Vertices.data(), meshData.Indices.data(), CopyVertex());
 }
 
-void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
+void GeometryGenerator::BuildGeosphere(UINT numSubdivisions, XMFLOAT3* positions, UINT stride, UINT* indices,
+    MeshArena* arena)
 {
     // Put a cap on the number of subdivisions.
-    numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+    numSubdivisions = MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
 
     // Approximate a sphere by tessellating an icosahedron.
     const float X = 0.525731f;
@@ -287,305 +290,49 @@ void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Mesh
         10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
     };
 
-    meshData.Vertices.resize(12);
-    meshData.Indices.resize(60);
+    // The arrays are sized for the final level, so every level subdivides in place.
+    BYTE* positionBytes = reinterpret_cast<BYTE*>(positions);
 
     for (UINT i = 0; i < 12; ++i)
-        meshData.Vertices[i].Position = pos[i];
+        *reinterpret_cast<XMFLOAT3*>(positionBytes + i * stride) = pos[i];
 
     for (UINT i = 0; i < 60; ++i)
-        meshData.Indices[i] = k[i];
-
-    for (UINT i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
-
-    // Project vertices onto sphere and scale.
-    for (UINT i = 0; i < meshData.Vertices.size(); ++i)
-    {
-        // Project onto unit sphere.
-        XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
-
-        // Project onto sphere.
-        XMVECTOR p = radius * n;
-
-        XMStoreFloat3(&meshData.Vertices[i].Position, p);
-        XMStoreFloat3(&meshData.Vertices[i].Normal, n);
-
-        // Derive texture coordinates from spherical coordinates.
-        float theta = MathHelper::AngleFromXY(
-            meshData.Vertices[i].Position.x,
-            meshData.Vertices[i].Position.z);
-
-        float phi = acosf(meshData.Vertices[i].Position.y / radius);
-
-        meshData.Vertices[i].TexC.x = theta / XM_2PI;
-        meshData.Vertices[i].TexC.y = phi / XM_PI;
-
-        // Partial derivative of P with respect to theta
-        meshData.Vertices[i].TangentU.x = -radius * sinf(phi)*sinf(theta);
-        meshData.Vertices[i].TangentU.y = 0.0f;
-        meshData.Vertices[i].TangentU.z = +radius * sinf(phi)*cosf(theta);
-
-        XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-        XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-    }
-}
-
-void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
-{
-    meshData.Vertices.clear();
-    meshData.Indices.clear();
-
-    // Build Stacks.
-    float stackHeight = height / stackCount;
-
-    // Amount to increment radius as we move up each stack level from bottom to top.
-    float radiusStep = (topRadius - bottomRadius) / stackCount;
+        indices[i] = k[i];
 
-    UINT ringCount = stackCount + 1;
+    EdgeMidpointCache midpoints(GeosphereEdgeCount(numSubdivisions), arena);
 
-    // Compute vertices for each stack ring starting at the bottom and moving up.
-    for (UINT i = 0; i < ringCount; ++i)
-    {
-        float y = -0.5f*height + i * stackHeight;
-        float r = bottomRadius + i * radiusStep;
-
-        // vertices of ring
-        float dTheta = 2.0f*XM_PI / sliceCount;
-        for (UINT j = 0; j <= sliceCount; ++j)
-        {
-            Vertex vertex;
-
-            float c = cosf(j*dTheta);
-            float s = sinf(j*dTheta);
-
-            vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-            vertex.TexC.x = (float)j / sliceCount;
-            vertex.TexC.y = 1.0f - (float)i / stackCount;
-
-            // Cylinder can be parameterized as follows, where we introduce v
-            // parameter that goes in the same direction as the v tex-coord
-            // so that the bitangent goes in the same direction as the v tex-coord.
-            //   Let r0 be the bottom radius and let r1 be the top radius.
-            //   y(v) = h - hv for v in [0,1].
-            //   r(v) = r1 + (r0-r1)v
-            //
-            //   x(t, v) = r(v)*cos(t)
-            //   y(t, v) = h - hv
-            //   z(t, v) = r(v)*sin(t)
-            // 
-            //  dx/dt = -r(v)*sin(t)
-            //  dy/dt = 0
-            //  dz/dt = +r(v)*cos(t)
-            //
-            //  dx/dv = (r0-r1)*cos(t)
-            //  dy/dv = -h
-            //  dz/dv = (r0-r1)*sin(t)
-
-            // This is unit length.
-            vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-            float dr = bottomRadius - topRadius;
-            XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-            XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-            XMVECTOR B = XMLoadFloat3(&bitangent);
-            XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-            XMStoreFloat3(&vertex.Normal, N);
-
-            meshData.Vertices.push_back(vertex);
-        }
-    }
-
-    // Add one because we duplicate the first and last vertex per ring
-    // since the texture coordinates are different.
-    UINT ringVertexCount = sliceCount + 1;
-
-    // Compute indices for each stack.
-    for (UINT i = 0; i < stackCount; ++i)
-    {
-        for (UINT j = 0; j < sliceCount; ++j)
-        {
-            meshData.Indices.push_back(i*ringVertexCount + j);
-            meshData.Indices.push_back((i + 1)*ringVertexCount + j);
-            meshData.Indices.push_back((i + 1)*ringVertexCount + j + 1);
-
-            meshData.Indices.push_back(i*ringVertexCount + j);
-            meshData.Indices.push_back((i + 1)*ringVertexCount + j + 1);
-            meshData.Indices.push_back(i*ringVertexCount + j + 1);
-        }
-    }
-
-    BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-    BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+    UINT vertexCount = 12;
+    UINT indexCount = 60;
+    for (UINT i = 0; i < numSubdivisions; ++i)
+        Subdivide(midpoints, positionBytes, stride, vertexCount, indices, indexCount);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-    UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
 {
-    UINT baseIndex = (UINT)meshData.Vertices.size();
-
-    float y = 0.5f*height;
-    float dTheta = 2.0f*XM_PI / sliceCount;
-
-    // Duplicate cap ring vertices because the texture coordinates and normals differ.
-    for (UINT i = 0; i <= sliceCount; ++i)
-    {
-        float x = topRadius * cosf(i*dTheta);
-        float z = topRadius * sinf(i*dTheta);
-
-        // Scale down by the height to try and make top cap texture coord area
-        // proportional to base.
-        float u = x / height + 0.5f;
-        float v = z / height + 0.5f;
-
-        meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
-    }
-
-    // Cap center vertex.
-    meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
-
-    // Index of center vertex.
-    UINT centerIndex = (UINT)meshData.Vertices.size() - 1;
+    // Subdivide in place, then project in place.
+    meshData.Resize(GeosphereSize(numSubdivisions));
+    BuildGeosphere(numSubdivisions, &meshData.Vertices[0].Position, sizeof(Vertex), meshData.Indices.data(),
+        meshData.Vertices.get_allocator().GetArena());
 
-    for (UINT i = 0; i < sliceCount; ++i)
-    {
-        meshData.Indices.push_back(centerIndex);
-        meshData.Indices.push_back(baseIndex + i + 1);
-        meshData.Indices.push_back(baseIndex + i);
-    }
+    for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+        ProjectGeosphereVertex<AllAttributes>(radius, meshData.Vertices[i]);
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-    UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-    // Build bottom cap.
-
-    UINT baseIndex = (UINT)meshData.Vertices.size();
-    float y = -0.5f*height;
-
-    // vertices of ring
-    float dTheta = 2.0f*XM_PI / sliceCount;
-    for (UINT i = 0; i <= sliceCount; ++i)
-    {
-        float x = bottomRadius * cosf(i*dTheta);
-        float z = bottomRadius * sinf(i*dTheta);
-
-        // Scale down by the height to try and make top cap texture coord area
-        // proportional to base.
-        float u = x / height + 0.5f;
-        float v = z / height + 0.5f;
-
-        meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
-    }
-
-    // Cap center vertex.
-    meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
-
-    // Cache the index of center vertex.
-    UINT centerIndex = (UINT)meshData.Vertices.size() - 1;
-
-    for (UINT i = 0; i < sliceCount; ++i)
-    {
-        meshData.Indices.push_back(centerIndex);
-        meshData.Indices.push_back(baseIndex + i);
-        meshData.Indices.push_back(baseIndex + i + 1);
-    }
+    meshData.Resize(CylinderSize(sliceCount, stackCount));
+    CreateCylinder<AllAttributes>(bottomRadius, topRadius, height, sliceCount, stackCount,
+        meshData.Vertices.data(), meshData.Indices.data(), CopyVertex());
 }
 
 void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData)
 {
-    UINT vertexCount = m * n;
-    UINT faceCount = (m - 1)*(n - 1) * 2;
-
-    // Create the vertices.
-
-    float halfWidth = 0.5f*width;
-    float halfDepth = 0.5f*depth;
-
-    float dx = width / (n - 1);
-    float dz = depth / (m - 1);
-
-    float du = 1.0f / (n - 1);
-    float dv = 1.0f / (m - 1);
-
-    meshData.Vertices.resize(vertexCount);
-    for (UINT i = 0; i < m; ++i)
-    {
-        float z = halfDepth - i * dz;
-        for (UINT j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j * dx;
-
-            meshData.Vertices[i*n + j].Position = XMFLOAT3(x, 0.0f, z);
-            meshData.Vertices[i*n + j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            meshData.Vertices[i*n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-            // Stretch texture over grid.
-            meshData.Vertices[i*n + j].TexC.x = j * du;
-            meshData.Vertices[i*n + j].TexC.y = i * dv;
-        }
-    }
-
-    // Create the indices.
-
-    meshData.Indices.resize(faceCount * 3); // 3 indices per face
-
-    // Iterate over each quad and compute indices.
-    UINT k = 0;
-    for (UINT i = 0; i < m - 1; ++i)
-    {
-        for (UINT j = 0; j < n - 1; ++j)
-        {
-            meshData.Indices[k] = i * n + j;
-            meshData.Indices[k + 1] = i * n + j + 1;
-            meshData.Indices[k + 2] = (i + 1)*n + j;
-
-            meshData.Indices[k + 3] = (i + 1)*n + j;
-            meshData.Indices[k + 4] = i * n + j + 1;
-            meshData.Indices[k + 5] = (i + 1)*n + j + 1;
-
-            k += 6; // next quad
-        }
-    }
+    meshData.Resize(GridSize(m, n));
+    CreateGrid<AllAttributes>(width, depth, m, n, meshData.Vertices.data(), meshData.Indices.data(), CopyVertex());
 }
 
 void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
 {
-    meshData.Vertices.resize(4);
-    meshData.Indices.resize(6);
-
-    // Position coordinates specified in NDC space.
-    meshData.Vertices[0] = Vertex(
-        -1.0f, -1.0f, 0.0f,
-        0.0f, 0.0f, -1.0f,
-        1.0f, 0.0f, 0.0f,
-        0.0f, 1.0f);
-
-    meshData.Vertices[1] = Vertex(
-        -1.0f, +1.0f, 0.0f,
-        0.0f, 0.0f, -1.0f,
-        1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f);
-
-    meshData.Vertices[2] = Vertex(
-        +1.0f, +1.0f, 0.0f,
-        0.0f, 0.0f, -1.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f);
-
-    meshData.Vertices[3] = Vertex(
-        +1.0f, -1.0f, 0.0f,
-        0.0f, 0.0f, -1.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f);
-
-    meshData.Indices[0] = 0;
-    meshData.Indices[1] = 1;
-    meshData.Indices[2] = 2;
-
-    meshData.Indices[3] = 0;
-    meshData.Indices[4] = 2;
-    meshData.Indices[5] = 3;
-}
\ No newline at end of file
+    meshData.Resize(FullscreenQuadSize());
+    CreateFullscreenQuad<AllAttributes>(meshData.Vertices.data(), meshData.Indices.data(), CopyVertex());
+}
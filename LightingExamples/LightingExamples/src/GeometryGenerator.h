@@ -4,7 +4,12 @@
 
 #pragma once
 
-#include "D3DUtil.h"
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "MeshArena.h"
+#include "MathHelper.h"
+using namespace DirectX;
 
 
 class GeometryGenerator
@@ -31,12 +36,75 @@ public:
         XMFLOAT2 TexC;
     };
 
+    struct MeshSize
+    {
+        UINT VertexCount;
+        UINT IndexCount;
+    };
+
     struct MeshData
     {
-        std::vector<Vertex> Vertices;
-        std::vector<UINT> Indices;
+        MeshData() {}
+
+        // Vertices and indices are allocated from arena, which must outlive the mesh.
+        explicit MeshData(MeshArena& arena)
+            : Vertices(MeshAllocator<Vertex>(&arena)), Indices(MeshAllocator<UINT>(&arena))
+        {
+        }
+
+        void Reserve(const MeshSize& size)
+        {
+            Vertices.reserve(size.VertexCount);
+            Indices.reserve(size.IndexCount);
+        }
+
+        void Resize(const MeshSize& size)
+        {
+            Vertices.resize(size.VertexCount);
+            Indices.resize(size.IndexCount);
+        }
+
+        std::vector<Vertex, MeshAllocator<Vertex>> Vertices;
+        std::vector<UINT, MeshAllocator<UINT>> Indices;
     };
 
+    // Attributes the templated Create* overloads compute besides Position.
+    static const UINT PositionOnly = 0;
+    static const UINT NormalAttribute = 0x1;
+    static const UINT TangentUAttribute = 0x2;
+    static const UINT TexCAttribute = 0x4;
+    static const UINT AllAttributes = NormalAttribute | TangentUAttribute | TexCAttribute;
+
+    ///<summary>
+    /// Exact vertex and index counts of the mesh the matching Create* call builds.
+    /// Each Create* sizes its arrays to these up front, so it allocates each once.
+    ///</summary>
+    static MeshSize BoxSize();
+    static MeshSize SphereSize(UINT sliceCount, UINT stackCount);
+    static MeshSize GeosphereSize(UINT numSubdivisions);
+    static MeshSize CylinderSize(UINT sliceCount, UINT stackCount);
+    static MeshSize GridSize(UINT m, UINT n);
+    static MeshSize FullscreenQuadSize();
+
+    ///<summary>
+    /// Bytes a mesh of the given size takes in a MeshArena, alignment included.  Summing
+    /// these sizes a buffer that holds a whole batch of meshes without touching the heap.
+    ///</summary>
+    static size_t ArenaBytes(const MeshSize& size);
+
+    ///<summary>
+    /// Bytes a geosphere build takes from a MeshArena besides the mesh itself: the edge
+    /// table subdivision uses, and the positions the direct-write CreateGeosphere builds.
+    ///</summary>
+    static size_t GeosphereScratchBytes(UINT numSubdivisions);
+
+    ///<summary>
+    /// Writes CreateGrid's indices for the quads between vertex rows rowBegin and
+    /// rowEnd (at most m - 1) of a grid n columns wide, at the place they take in the
+    /// whole index buffer.  Disjoint row ranges can be written concurrently.
+    ///</summary>
+    static void CreateGridIndices(UINT n, UINT rowBegin, UINT rowEnd, UINT* indices);
+
     ///<summary>
     /// Creates a box centered at the origin with the given dimensions.
     ///</summary>
@@ -50,7 +118,7 @@ public:
 
     ///<summary>
     /// Creates a geosphere centered at the origin with the given radius.  The
-    /// depth controls the level of tessellation.
+    /// depth controls the level of tessellation, and is capped at 13.
     ///</summary>
     void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
 
@@ -73,9 +141,573 @@ public:
     ///</summary>
     void CreateFullscreenQuad(MeshData& meshData);
 
+    ///<summary>
+    /// The same meshes written straight into the caller's vertex layout.  vertices and
+    /// indices must have room for the counts the matching *Size() returns.  Each vertex
+    /// is generated into a Vertex holding Position and the Attributes asked for, then
+    /// handed to write(OutVertex& out, const Vertex& v) to keep what it needs.
+    /// Attributes not asked for are not computed, and are left unset in v.
+    ///</summary>
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateBox(float width, float height, float depth, OutVertex* vertices, UINT* indices, const Write& write);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateSphere(float radius, UINT sliceCount, UINT stackCount, OutVertex* vertices, UINT* indices, const Write& write);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateGeosphere(float radius, UINT numSubdivisions, OutVertex* vertices, UINT* indices, const Write& write);
+
+    // Takes the scratch memory the geosphere needs from scratch rather than the heap.
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateGeosphere(float radius, UINT numSubdivisions, OutVertex* vertices, UINT* indices, const Write& write,
+        MeshArena& scratch);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+        OutVertex* vertices, UINT* indices, const Write& write);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateGrid(float width, float depth, UINT m, UINT n, OutVertex* vertices, UINT* indices, const Write& write);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void CreateFullscreenQuad(OutVertex* vertices, UINT* indices, const Write& write);
+
 private:
-    void Subdivide(MeshData& meshData);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+    // Writes the geosphere's positions, on the unit icosahedron subdivided, stride
+    // bytes apart, and its indices.  Both arrays must hold GeosphereSize() entries.
+    // The edge table comes from arena, or the heap if it is null.
+    void BuildGeosphere(UINT numSubdivisions, XMFLOAT3* positions, UINT stride, UINT* indices, MeshArena* arena);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void WriteGeosphere(float radius, UINT numSubdivisions, OutVertex* vertices, UINT* indices, const Write& write,
+        MeshArena* scratch);
+
+    // Projects v.Position onto the sphere and derives the other attributes from it.
+    template<UINT Attributes>
+    static void ProjectGeosphereVertex(float radius, Vertex& v);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+        OutVertex* vertices, UINT* indices, UINT baseIndex, const Write& write);
+
+    template<UINT Attributes, typename OutVertex, typename Write>
+    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+        OutVertex* vertices, UINT* indices, UINT baseIndex, const Write& write);
 };
 
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateBox(float width, float height, float depth, OutVertex* vertices, UINT* indices, const Write& write)
+{
+    // Create the vertices.
+    Vertex v[24];
+
+    float w2 = 0.5f*width;
+    float h2 = 0.5f*height;
+    float d2 = 0.5f*depth;
+
+    // Fill in the front face vertex data.
+    v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    v[2] = Vertex(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    v[3] = Vertex(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Fill in the back face vertex data.
+    v[4] = Vertex(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+    v[5] = Vertex(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    v[6] = Vertex(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    v[7] = Vertex(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+    // Fill in the top face vertex data.
+    v[8] = Vertex(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    v[9] = Vertex(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    v[10] = Vertex(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    v[11] = Vertex(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Fill in the bottom face vertex data.
+    v[12] = Vertex(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+    v[13] = Vertex(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    v[14] = Vertex(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    v[15] = Vertex(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+    // Fill in the left face vertex data.
+    v[16] = Vertex(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
+    v[17] = Vertex(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
+    v[18] = Vertex(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
+    v[19] = Vertex(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
+
+    // Fill in the right face vertex data.
+    v[20] = Vertex(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+    v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+    v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+
+    // The attributes are all constants, so the ones write ignores cost nothing.
+    for (UINT i = 0; i < 24; ++i)
+        write(vertices[i], v[i]);
+
+    // Create the indices.
+    UINT* i = indices;
+
+    // Fill in the front face index data
+    i[0] = 0; i[1] = 1; i[2] = 2;
+    i[3] = 0; i[4] = 2; i[5] = 3;
+
+    // Fill in the back face index data
+    i[6] = 4; i[7] = 5; i[8] = 6;
+    i[9] = 4; i[10] = 6; i[11] = 7;
+
+    // Fill in the top face index data
+    i[12] = 8; i[13] = 9; i[14] = 10;
+    i[15] = 8; i[16] = 10; i[17] = 11;
+
+    // Fill in the bottom face index data
+    i[18] = 12; i[19] = 13; i[20] = 14;
+    i[21] = 12; i[22] = 14; i[23] = 15;
+
+    // Fill in the left face index data
+    i[24] = 16; i[25] = 17; i[26] = 18;
+    i[27] = 16; i[28] = 18; i[29] = 19;
+
+    // Fill in the right face index data
+    i[30] = 20; i[31] = 21; i[32] = 22;
+    i[33] = 20; i[34] = 22; i[35] = 23;
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, OutVertex* vertices, UINT* indices, const Write& write)
+{
+    // Compute the vertices stating at the top pole and moving down the stacks.
+
+    // Poles: note that there will be texture coordinate distortion as there is
+    // not a unique point on the texture map to assign to the pole when mapping
+    // a rectangular texture onto a sphere.
+    Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    UINT vertexCount = 0;
+    write(vertices[vertexCount++], topVertex);
+
+    float phiStep = XM_PI / stackCount;
+    float thetaStep = 2.0f*XM_PI / sliceCount;
+
+    // Compute vertices for each stack ring (do not count the poles as rings).
+    for (UINT i = 1; i <= stackCount - 1; ++i)
+    {
+        float phi = i * phiStep;
+
+        // Vertices of ring.
+        for (UINT j = 0; j <= sliceCount; ++j)
+        {
+            float theta = j * thetaStep;
+
+            Vertex v;
+
+            // spherical to cartesian
+            v.Position.x = radius * sinf(phi)*cosf(theta);
+            v.Position.y = radius * cosf(phi);
+            v.Position.z = radius * sinf(phi)*sinf(theta);
+
+            if (Attributes & TangentUAttribute)
+            {
+                // Partial derivative of P with respect to theta
+                v.TangentU.x = -radius * sinf(phi)*sinf(theta);
+                v.TangentU.y = 0.0f;
+                v.TangentU.z = +radius * sinf(phi)*cosf(theta);
+
+                XMVECTOR T = XMLoadFloat3(&v.TangentU);
+                XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+            }
+
+            if (Attributes & NormalAttribute)
+            {
+                XMVECTOR p = XMLoadFloat3(&v.Position);
+                XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+            }
+
+            if (Attributes & TexCAttribute)
+            {
+                v.TexC.x = theta / XM_2PI;
+                v.TexC.y = phi / XM_PI;
+            }
+
+            write(vertices[vertexCount++], v);
+        }
+    }
+
+    write(vertices[vertexCount++], bottomVertex);
+
+    // Compute indices for top stack.  The top stack was written first to the vertex buffer
+    // and connects the top pole to the first ring.
+
+    UINT* k = indices;
+    for (UINT i = 1; i <= sliceCount; ++i)
+    {
+        *k++ = 0;
+        *k++ = i + 1;
+        *k++ = i;
+    }
+
+    // Compute indices for inner stacks (not connected to poles).
+
+    // Offset the indices to the index of the first vertex in the first ring.
+    // This is just skipping the top pole vertex.
+
+    UINT baseIndex = 1;
+    UINT ringVertexCount = sliceCount + 1;
+    for (UINT i = 0; i < stackCount - 2; ++i)
+    {
+        for (UINT j = 0; j < sliceCount; ++j)
+        {
+            *k++ = baseIndex + i * ringVertexCount + j;
+            *k++ = baseIndex + i * ringVertexCount + j + 1;
+            *k++ = baseIndex + (i + 1)*ringVertexCount + j;
+
+            *k++ = baseIndex + (i + 1)*ringVertexCount + j;
+            *k++ = baseIndex + i * ringVertexCount + j + 1;
+            *k++ = baseIndex + (i + 1)*ringVertexCount + j + 1;
+        }
+    }
+
+    // Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+    // and connects the bottom pole to the bottom ring.
+
+    // South pole vertex was added last.
+    UINT southPoleIndex = vertexCount - 1;
+
+    // Offset the indices to the index of the first vertex in the last ring.
+    baseIndex = southPoleIndex - ringVertexCount;
+
+    for (UINT i = 0; i < sliceCount; ++i)
+    {
+        *k++ = southPoleIndex;
+        *k++ = baseIndex + i;
+        *k++ = baseIndex + i + 1;
+    }
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, OutVertex* vertices, UINT* indices, const Write& write)
+{
+    WriteGeosphere<Attributes>(radius, numSubdivisions, vertices, indices, write, nullptr);
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, OutVertex* vertices, UINT* indices, const Write& write,
+    MeshArena& scratch)
+{
+    WriteGeosphere<Attributes>(radius, numSubdivisions, vertices, indices, write, &scratch);
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::WriteGeosphere(float radius, UINT numSubdivisions, OutVertex* vertices, UINT* indices, const Write& write,
+    MeshArena* scratch)
+{
+    // Subdivision reads the positions of the level before, which OutVertex need not
+    // hold, so they are built in a scratch array; the indices go straight to indices.
+    MeshSize size = GeosphereSize(numSubdivisions);
+    std::vector<XMFLOAT3, MeshAllocator<XMFLOAT3>> positions(size.VertexCount, XMFLOAT3(), MeshAllocator<XMFLOAT3>(scratch));
+    BuildGeosphere(numSubdivisions, positions.data(), sizeof(XMFLOAT3), indices, scratch);
+
+    for (UINT i = 0; i < size.VertexCount; ++i)
+    {
+        Vertex v;
+        v.Position = positions[i];
+        ProjectGeosphereVertex<Attributes>(radius, v);
+
+        write(vertices[i], v);
+    }
+}
+
+template<UINT Attributes>
+void GeometryGenerator::ProjectGeosphereVertex(float radius, Vertex& v)
+{
+    // Project onto unit sphere.
+    XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&v.Position));
+
+    // Project onto sphere.
+    XMVECTOR p = radius * n;
+
+    XMStoreFloat3(&v.Position, p);
+
+    if (Attributes & NormalAttribute)
+    {
+        XMStoreFloat3(&v.Normal, n);
+    }
+
+    if (Attributes & (TexCAttribute | TangentUAttribute))
+    {
+        // Derive texture coordinates from spherical coordinates.
+        float theta = MathHelper::AngleFromXY(v.Position.x, v.Position.z);
+
+        float phi = acosf(v.Position.y / radius);
+
+        if (Attributes & TexCAttribute)
+        {
+            v.TexC.x = theta / XM_2PI;
+            v.TexC.y = phi / XM_PI;
+        }
+
+        if (Attributes & TangentUAttribute)
+        {
+            // Partial derivative of P with respect to theta
+            v.TangentU.x = -radius * sinf(phi)*sinf(theta);
+            v.TangentU.y = 0.0f;
+            v.TangentU.z = +radius * sinf(phi)*cosf(theta);
+
+            XMVECTOR T = XMLoadFloat3(&v.TangentU);
+            XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+        }
+    }
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+    OutVertex* vertices, UINT* indices, const Write& write)
+{
+    // Build Stacks.
+    float stackHeight = height / stackCount;
+
+    // Amount to increment radius as we move up each stack level from bottom to top.
+    float radiusStep = (topRadius - bottomRadius) / stackCount;
+
+    UINT ringCount = stackCount + 1;
+
+    // Compute vertices for each stack ring starting at the bottom and moving up.
+    UINT vertexCount = 0;
+    for (UINT i = 0; i < ringCount; ++i)
+    {
+        float y = -0.5f*height + i * stackHeight;
+        float r = bottomRadius + i * radiusStep;
+
+        // vertices of ring
+        float dTheta = 2.0f*XM_PI / sliceCount;
+        for (UINT j = 0; j <= sliceCount; ++j)
+        {
+            Vertex vertex;
+
+            float c = cosf(j*dTheta);
+            float s = sinf(j*dTheta);
+
+            vertex.Position = XMFLOAT3(r*c, y, r*s);
+
+            if (Attributes & TexCAttribute)
+            {
+                vertex.TexC.x = (float)j / sliceCount;
+                vertex.TexC.y = 1.0f - (float)i / stackCount;
+            }
+
+            // Cylinder can be parameterized as follows, where we introduce v
+            // parameter that goes in the same direction as the v tex-coord
+            // so that the bitangent goes in the same direction as the v tex-coord.
+            //   Let r0 be the bottom radius and let r1 be the top radius.
+            //   y(v) = h - hv for v in [0,1].
+            //   r(v) = r1 + (r0-r1)v
+            //
+            //   x(t, v) = r(v)*cos(t)
+            //   y(t, v) = h - hv
+            //   z(t, v) = r(v)*sin(t)
+            // 
+            //  dx/dt = -r(v)*sin(t)
+            //  dy/dt = 0
+            //  dz/dt = +r(v)*cos(t)
+            //
+            //  dx/dv = (r0-r1)*cos(t)
+            //  dy/dv = -h
+            //  dz/dv = (r0-r1)*sin(t)
+
+            // This is unit length.
+            XMFLOAT3 tangentU(-s, 0.0f, c);
+
+            if (Attributes & TangentUAttribute)
+            {
+                vertex.TangentU = tangentU;
+            }
+
+            if (Attributes & NormalAttribute)
+            {
+                float dr = bottomRadius - topRadius;
+                XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+                XMVECTOR T = XMLoadFloat3(&tangentU);
+                XMVECTOR B = XMLoadFloat3(&bitangent);
+                XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+                XMStoreFloat3(&vertex.Normal, N);
+            }
+
+            write(vertices[vertexCount++], vertex);
+        }
+    }
+
+    // Add one because we duplicate the first and last vertex per ring
+    // since the texture coordinates are different.
+    UINT ringVertexCount = sliceCount + 1;
+
+    // Compute indices for each stack.
+    UINT* k = indices;
+    for (UINT i = 0; i < stackCount; ++i)
+    {
+        for (UINT j = 0; j < sliceCount; ++j)
+        {
+            *k++ = i * ringVertexCount + j;
+            *k++ = (i + 1)*ringVertexCount + j;
+            *k++ = (i + 1)*ringVertexCount + j + 1;
+
+            *k++ = i * ringVertexCount + j;
+            *k++ = (i + 1)*ringVertexCount + j + 1;
+            *k++ = i * ringVertexCount + j + 1;
+        }
+    }
+
+    // Each cap adds a ring and a center vertex, and a triangle per slice.
+    UINT capVertexCount = sliceCount + 2;
+    UINT capIndexCount = 3 * sliceCount;
+
+    BuildCylinderTopCap<Attributes>(bottomRadius, topRadius, height, sliceCount, stackCount,
+        vertices + vertexCount, k, vertexCount, write);
+
+    BuildCylinderBottomCap<Attributes>(bottomRadius, topRadius, height, sliceCount, stackCount,
+        vertices + vertexCount + capVertexCount, k + capIndexCount, vertexCount + capVertexCount, write);
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+    OutVertex* vertices, UINT* indices, UINT baseIndex, const Write& write)
+{
+    float y = 0.5f*height;
+    float dTheta = 2.0f*XM_PI / sliceCount;
+
+    // Duplicate cap ring vertices because the texture coordinates and normals differ.
+    for (UINT i = 0; i <= sliceCount; ++i)
+    {
+        float x = topRadius * cosf(i*dTheta);
+        float z = topRadius * sinf(i*dTheta);
+
+        // Scale down by the height to try and make top cap texture coord area
+        // proportional to base.
+        float u = x / height + 0.5f;
+        float v = z / height + 0.5f;
+
+        write(vertices[i], Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+    }
+
+    // Cap center vertex.
+    write(vertices[sliceCount + 1], Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+
+    // Index of center vertex.
+    UINT centerIndex = baseIndex + sliceCount + 1;
+
+    UINT* k = indices;
+    for (UINT i = 0; i < sliceCount; ++i)
+    {
+        *k++ = centerIndex;
+        *k++ = baseIndex + i + 1;
+        *k++ = baseIndex + i;
+    }
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+    OutVertex* vertices, UINT* indices, UINT baseIndex, const Write& write)
+{
+    // Build bottom cap.
+
+    float y = -0.5f*height;
+
+    // vertices of ring
+    float dTheta = 2.0f*XM_PI / sliceCount;
+    for (UINT i = 0; i <= sliceCount; ++i)
+    {
+        float x = bottomRadius * cosf(i*dTheta);
+        float z = bottomRadius * sinf(i*dTheta);
+
+        // Scale down by the height to try and make top cap texture coord area
+        // proportional to base.
+        float u = x / height + 0.5f;
+        float v = z / height + 0.5f;
+
+        write(vertices[i], Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+    }
+
+    // Cap center vertex.
+    write(vertices[sliceCount + 1], Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+
+    // Cache the index of center vertex.
+    UINT centerIndex = baseIndex + sliceCount + 1;
+
+    UINT* k = indices;
+    for (UINT i = 0; i < sliceCount; ++i)
+    {
+        *k++ = centerIndex;
+        *k++ = baseIndex + i;
+        *k++ = baseIndex + i + 1;
+    }
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, OutVertex* vertices, UINT* indices, const Write& write)
+{
+    // Create the vertices.
+
+    float halfWidth = 0.5f*width;
+    float halfDepth = 0.5f*depth;
+
+    float dx = width / (n - 1);
+    float dz = depth / (m - 1);
+
+    float du = 1.0f / (n - 1);
+    float dv = 1.0f / (m - 1);
+
+    for (UINT i = 0; i < m; ++i)
+    {
+        float z = halfDepth - i * dz;
+        for (UINT j = 0; j < n; ++j)
+        {
+            float x = -halfWidth + j * dx;
+
+            // Stretch texture over grid.
+            write(vertices[i*n + j], Vertex(x, 0.0f, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, j * du, i * dv));
+        }
+    }
+
+    // Create the indices.
+
+    CreateGridIndices(n, 0, m - 1, indices);
+}
+
+template<UINT Attributes, typename OutVertex, typename Write>
+void GeometryGenerator::CreateFullscreenQuad(OutVertex* vertices, UINT* indices, const Write& write)
+{
+    // Position coordinates specified in NDC space.
+    write(vertices[0], Vertex(
+        -1.0f, -1.0f, 0.0f,
+        0.0f, 0.0f, -1.0f,
+        1.0f, 0.0f, 0.0f,
+        0.0f, 1.0f));
+
+    write(vertices[1], Vertex(
+        -1.0f, +1.0f, 0.0f,
+        0.0f, 0.0f, -1.0f,
+        1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f));
+
+    write(vertices[2], Vertex(
+        +1.0f, +1.0f, 0.0f,
+        0.0f, 0.0f, -1.0f,
+        1.0f, 0.0f, 0.0f,
+        1.0f, 0.0f));
+
+    write(vertices[3], Vertex(
+        +1.0f, -1.0f, 0.0f,
+        0.0f, 0.0f, -1.0f,
+        1.0f, 0.0f, 0.0f,
+        1.0f, 1.0f));
+
+    indices[0] = 0;
+    indices[1] = 1;
+    indices[2] = 2;
+
+    indices[3] = 0;
+    indices[4] = 2;
+    indices[5] = 3;
+}
+
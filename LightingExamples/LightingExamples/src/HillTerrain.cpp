@@ -0,0 +1,238 @@
+//***************************************************************************************
+// HillTerrain.cpp
+//***************************************************************************************
+
+#include "HillTerrain.h"
+#include "GeometryGenerator.h"
+#include "WorkerPool.h"
+#include "SimdTarget.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Keep mul+add separate in the row kernels and in Height() and Normal(), so both
+// round alike.
+SIMD_FP_CONTRACT_OFF_BEGIN
+
+namespace
+{
+    // Bands per pool thread, so a slow thread does not hold up the rest.
+    const UINT BandsPerThread = 4;
+
+    inline void StoreVertex(BYTE* positions, BYTE* normals, UINT stride, UINT j,
+        float x, float h, float z, float nx, float ny, float nz)
+    {
+        *reinterpret_cast<XMFLOAT3*>(positions + static_cast<size_t>(j) * stride) = XMFLOAT3(x, h, z);
+
+        if (normals)
+        {
+            *reinterpret_cast<XMFLOAT3*>(normals + static_cast<size_t>(j) * stride) = XMFLOAT3(nx, ny, nz);
+        }
+    }
+
+    // Height() and Normal() with the trigonometry taken out.  The normal is
+    // normalized as XMVector3Normalize does it: ((x*x + y*y) + z*z), sqrt, divide.
+    void HillRowScalar(const float* x, const float* sinX, const float* cosX, UINT count,
+        float z, float sinZ, float cosZ, BYTE* positions, BYTE* normals, UINT stride)
+    {
+        float a = -0.03f * z;
+        float b = 0.3f * cosZ;
+
+        for (UINT j = 0; j < count; ++j)
+        {
+            float h = 0.3f * (z * sinX[j] + x[j] * cosZ);
+
+            float nx = a * cosX[j] - b;
+            float nz = -0.3f * sinX[j] + 0.03f * x[j] * sinZ;
+            float len = sqrtf((nx * nx + 1.0f) + nz * nz);
+
+            StoreVertex(positions, normals, stride, j, x[j], h, z, nx / len, 1.0f / len, nz / len);
+        }
+    }
+
+    void HillRowSSE2(const float* x, const float* sinX, const float* cosX, UINT count,
+        float z, float sinZ, float cosZ, BYTE* positions, BYTE* normals, UINT stride)
+    {
+        __m128 vz = _mm_set1_ps(z);
+        __m128 vSinZ = _mm_set1_ps(sinZ);
+        __m128 vCosZ = _mm_set1_ps(cosZ);
+        __m128 a = _mm_set1_ps(-0.03f * z);
+        __m128 b = _mm_set1_ps(0.3f * cosZ);
+        __m128 one = _mm_set1_ps(1.0f);
+
+        alignas(16) float h[4];
+        alignas(16) float nx[4];
+        alignas(16) float ny[4];
+        alignas(16) float nz[4];
+
+        UINT j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 vx = _mm_loadu_ps(x + j);
+            __m128 vSinX = _mm_loadu_ps(sinX + j);
+
+            __m128 vh = _mm_add_ps(_mm_mul_ps(vz, vSinX), _mm_mul_ps(vx, vCosZ));
+            _mm_store_ps(h, _mm_mul_ps(_mm_set1_ps(0.3f), vh));
+
+            __m128 vnx = _mm_sub_ps(_mm_mul_ps(a, _mm_loadu_ps(cosX + j)), b);
+            __m128 vnz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.3f), vSinX),
+                _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.03f), vx), vSinZ));
+
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vnx, vnx), one), _mm_mul_ps(vnz, vnz)));
+            _mm_store_ps(nx, _mm_div_ps(vnx, len));
+            _mm_store_ps(ny, _mm_div_ps(one, len));
+            _mm_store_ps(nz, _mm_div_ps(vnz, len));
+
+            for (UINT k = 0; k < 4; ++k)
+            {
+                StoreVertex(positions, normals, stride, j + k, x[j + k], h[k], z, nx[k], ny[k], nz[k]);
+            }
+        }
+
+        HillRowScalar(x + j, sinX + j, cosX + j, count - j, z, sinZ, cosZ,
+            positions + static_cast<size_t>(j) * stride, normals ? normals + static_cast<size_t>(j) * stride : nullptr, stride);
+    }
+
+    SIMD_TARGET_AVX2 void HillRowAVX2(const float* x, const float* sinX, const float* cosX, UINT count,
+        float z, float sinZ, float cosZ, BYTE* positions, BYTE* normals, UINT stride)
+    {
+        __m256 vz = _mm256_set1_ps(z);
+        __m256 vSinZ = _mm256_set1_ps(sinZ);
+        __m256 vCosZ = _mm256_set1_ps(cosZ);
+        __m256 a = _mm256_set1_ps(-0.03f * z);
+        __m256 b = _mm256_set1_ps(0.3f * cosZ);
+        __m256 one = _mm256_set1_ps(1.0f);
+
+        alignas(32) float h[8];
+        alignas(32) float nx[8];
+        alignas(32) float ny[8];
+        alignas(32) float nz[8];
+
+        UINT j = 0;
+        for (; j + 8 <= count; j += 8)
+        {
+            __m256 vx = _mm256_loadu_ps(x + j);
+            __m256 vSinX = _mm256_loadu_ps(sinX + j);
+
+            __m256 vh = _mm256_add_ps(_mm256_mul_ps(vz, vSinX), _mm256_mul_ps(vx, vCosZ));
+            _mm256_store_ps(h, _mm256_mul_ps(_mm256_set1_ps(0.3f), vh));
+
+            __m256 vnx = _mm256_sub_ps(_mm256_mul_ps(a, _mm256_loadu_ps(cosX + j)), b);
+            __m256 vnz = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-0.3f), vSinX),
+                _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.03f), vx), vSinZ));
+
+            __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vnx, vnx), one), _mm256_mul_ps(vnz, vnz)));
+            _mm256_store_ps(nx, _mm256_div_ps(vnx, len));
+            _mm256_store_ps(ny, _mm256_div_ps(one, len));
+            _mm256_store_ps(nz, _mm256_div_ps(vnz, len));
+
+            for (UINT k = 0; k < 8; ++k)
+            {
+                StoreVertex(positions, normals, stride, j + k, x[j + k], h[k], z, nx[k], ny[k], nz[k]);
+            }
+        }
+
+        HillRowSSE2(x + j, sinX + j, cosX + j, count - j, z, sinZ, cosZ,
+            positions + static_cast<size_t>(j) * stride, normals ? normals + static_cast<size_t>(j) * stride : nullptr, stride);
+    }
+}
+
+HillTerrain::HillTerrain()
+    : m_Isa(WavesKernels::Isa::Scalar), m_Row(HillRowScalar), m_WorkerPool(nullptr)
+{
+    SetKernelIsa(WavesKernels::DetectIsa());
+}
+
+float HillTerrain::Height(float x, float z)
+{
+    return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
+}
+
+XMFLOAT3 HillTerrain::Normal(float x, float z)
+{
+    // n = (-df/dx, 1, -df/dz)
+    XMFLOAT3 n(-0.03f * z * cosf(0.1f*x) - 0.3f * cosf(0.1f * z), 1.0f
+        , -0.3f * sinf(0.1f * x) + 0.03f * x * sinf(0.1f * z));
+
+    XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
+    XMStoreFloat3(&n, unitNormal);
+
+    return n;
+}
+
+void HillTerrain::SetKernelIsa(WavesKernels::Isa isa)
+{
+    m_Isa = WavesKernels::Select(isa).Level;
+
+    switch (m_Isa)
+    {
+    case WavesKernels::Isa::SSE2:
+        m_Row = HillRowSSE2;
+        break;
+    case WavesKernels::Isa::AVX2:
+    case WavesKernels::Isa::AVX512:
+        m_Row = HillRowAVX2;
+        break;
+    default:
+        m_Row = HillRowScalar;
+        break;
+    }
+}
+
+void HillTerrain::BuildGrid(float width, float depth, UINT m, UINT n,
+    XMFLOAT3* positions, XMFLOAT3* normals, UINT stride, UINT* indices) const
+{
+    // Placed exactly as CreateGrid places them.
+    float halfWidth = 0.5f*width;
+    float halfDepth = 0.5f*depth;
+
+    float dx = width / (n - 1);
+    float dz = depth / (m - 1);
+
+    std::vector<float> x(n);
+    std::vector<float> sinX(n);
+    std::vector<float> cosX(n);
+    for (UINT j = 0; j < n; ++j)
+    {
+        x[j] = -halfWidth + j * dx;
+        sinX[j] = sinf(0.1f * x[j]);
+        cosX[j] = cosf(0.1f * x[j]);
+    }
+
+    BYTE* positionBytes = reinterpret_cast<BYTE*>(positions);
+    BYTE* normalBytes = reinterpret_cast<BYTE*>(normals);
+    size_t rowBytes = static_cast<size_t>(n) * stride;
+
+    UINT bandCount = m_WorkerPool ? std::min(m, m_WorkerPool->ThreadCount() * BandsPerThread) : 1;
+
+    auto buildBand = [&](UINT band)
+    {
+        UINT rowBegin = static_cast<UINT>(static_cast<UINT64>(m) * band / bandCount);
+        UINT rowEnd = static_cast<UINT>(static_cast<UINT64>(m) * (band + 1) / bandCount);
+
+        for (UINT i = rowBegin; i < rowEnd; ++i)
+        {
+            float z = halfDepth - i * dz;
+
+            m_Row(x.data(), sinX.data(), cosX.data(), n, z, sinf(0.1f * z), cosf(0.1f * z),
+                positionBytes + i * rowBytes, normalBytes ? normalBytes + i * rowBytes : nullptr, stride);
+        }
+
+        // Quads below the last vertex row belong to no band.
+        if (indices)
+        {
+            GeometryGenerator::CreateGridIndices(n, rowBegin, std::min(rowEnd, m - 1), indices);
+        }
+    };
+
+    if (bandCount > 1)
+    {
+        m_WorkerPool->Run(bandCount, buildBand);
+    }
+    else if (bandCount == 1)
+    {
+        buildBand(0);
+    }
+}
+
+SIMD_FP_CONTRACT_OFF_END
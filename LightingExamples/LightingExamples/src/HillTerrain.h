@@ -0,0 +1,59 @@
+//***************************************************************************************
+// HillTerrain.h
+//
+// The demo's land, y = 0.3(z sin(0.1x) + x cos(0.1z)), evaluated over a whole grid at
+// once.  Height() and Normal() are the per-point reference.
+//
+// The function is separable, and every row of a grid shares the same columns x, so
+// BuildGrid() takes sin(0.1x) and cos(0.1x) once per column and sin(0.1z) and
+// cos(0.1z) once per row.  What is left per vertex is a few multiplies and adds, a
+// square root and three divides, done 4 or 8 vertices per instruction (SSE2 or AVX2)
+// over bands of rows spread across a WorkerPool.  Heights are bit-for-bit those of
+// Height(), and normals follow XMVector3Normalize's SSE2 path as WavesKernels does.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include "WavesKernels.h"
+
+using namespace DirectX;
+
+class WorkerPool;
+
+
+class HillTerrain
+{
+public:
+    HillTerrain();
+
+    static float Height(float x, float z);
+    static XMFLOAT3 Normal(float x, float z);
+
+    // The widest instruction set the CPU supports is used by default, and AVX-512
+    // runs the AVX2 kernel; WavesKernels::Isa::Scalar gives the reference path.
+    void SetKernelIsa(WavesKernels::Isa isa);
+    WavesKernels::Isa KernelIsa() const { return m_Isa; }
+
+    // Spreads BuildGrid over the given pool; nullptr (the default) runs serially.
+    void SetWorkerPool(WorkerPool* pool) { m_WorkerPool = pool; }
+
+    // Fills an mxn grid laid out as GeometryGenerator::CreateGrid(width, depth, m, n)
+    // lays it out, raised onto the hills.  Vertex k's position goes to the XMFLOAT3 at
+    // positions + k*stride bytes and its unit normal to normals + k*stride, so both
+    // can point into one interleaved vertex buffer.  normals may be null to skip them,
+    // and indices, if not null, receives CreateGrid's indices.
+    void BuildGrid(float width, float depth, UINT m, UINT n,
+        XMFLOAT3* positions, XMFLOAT3* normals, UINT stride, UINT* indices) const;
+
+private:
+    // Writes one grid row at z.  x, sinX and cosX hold the columns' x, sin(0.1x)
+    // and cos(0.1x).
+    typedef void (*RowFn)(const float* x, const float* sinX, const float* cosX, UINT count,
+        float z, float sinZ, float cosZ, BYTE* positions, BYTE* normals, UINT stride);
+
+    WavesKernels::Isa m_Isa;
+    RowFn m_Row;
+    WorkerPool* m_WorkerPool;
+};
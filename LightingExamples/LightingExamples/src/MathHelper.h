@@ -7,6 +7,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <cfloat>
 #include <DirectXMath.h>
 using namespace DirectX;
 
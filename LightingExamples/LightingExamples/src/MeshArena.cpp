@@ -0,0 +1,77 @@
+//=======================================================================================
+// MeshArena.cpp
+//=======================================================================================
+
+#include "MeshArena.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+    BYTE* AlignUp(BYTE* p, size_t alignment)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(p);
+        return p + ((alignment - address % alignment) % alignment);
+    }
+}
+
+MeshArena::MeshArena(size_t blockBytes)
+    : m_Buffer(nullptr), m_BufferBytes(0), m_BlockBytes(blockBytes),
+      m_Cursor(nullptr), m_End(nullptr), m_Blocks(nullptr),
+      m_AllocationCount(0), m_BlockCount(0), m_BytesAllocated(0)
+{
+}
+
+MeshArena::MeshArena(void* buffer, size_t bufferBytes, size_t blockBytes)
+    : m_Buffer(static_cast<BYTE*>(buffer)), m_BufferBytes(bufferBytes), m_BlockBytes(blockBytes),
+      m_Cursor(m_Buffer), m_End(m_Buffer + bufferBytes), m_Blocks(nullptr),
+      m_AllocationCount(0), m_BlockCount(0), m_BytesAllocated(0)
+{
+}
+
+MeshArena::~MeshArena()
+{
+    Release();
+}
+
+void* MeshArena::Allocate(size_t bytes, size_t alignment)
+{
+    BYTE* p = m_Cursor ? AlignUp(m_Cursor, alignment) : nullptr;
+    if (!p || p > m_End || static_cast<size_t>(m_End - p) < bytes)
+    {
+        // Whatever is left of the current block is abandoned.
+        size_t blockBytes = std::max(m_BlockBytes, sizeof(Block) + alignment - 1 + bytes);
+
+        Block* block = static_cast<Block*>(::operator new(blockBytes));
+        block->Next = m_Blocks;
+        m_Blocks = block;
+        ++m_BlockCount;
+
+        m_Cursor = reinterpret_cast<BYTE*>(block) + sizeof(Block);
+        m_End = reinterpret_cast<BYTE*>(block) + blockBytes;
+        p = AlignUp(m_Cursor, alignment);
+    }
+
+    m_BytesAllocated += (p - m_Cursor) + bytes;
+    m_Cursor = p + bytes;
+    ++m_AllocationCount;
+
+    return p;
+}
+
+void MeshArena::Release()
+{
+    while (m_Blocks)
+    {
+        Block* next = m_Blocks->Next;
+        ::operator delete(m_Blocks);
+        m_Blocks = next;
+    }
+
+    m_Cursor = m_Buffer;
+    m_End = m_Buffer + m_BufferBytes;
+
+    m_AllocationCount = 0;
+    m_BlockCount = 0;
+    m_BytesAllocated = 0;
+}
@@ -0,0 +1,120 @@
+//***************************************************************************************
+// MeshArena.h
+//
+// A monotonic arena for mesh data.  Allocations are carved in order out of a
+// caller-supplied buffer, then out of heap blocks taken as the buffer runs out, and
+// are only given back all at once, by Release() or the destructor.  Building many
+// meshes into one arena, each reserved at its exact size, costs a pointer bump per
+// array rather than a trip through the heap for every growth step.
+//
+// MeshAllocator lets standard containers, GeometryGenerator::MeshData's included,
+// allocate from an arena.  Without one it falls back to operator new.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <cstddef>
+#include <new>
+
+
+class MeshArena
+{
+public:
+    // Smallest heap block taken once the caller's buffer, if any, is full.
+    static const size_t DefaultBlockBytes = 1 << 20;
+
+    explicit MeshArena(size_t blockBytes = DefaultBlockBytes);
+
+    // Serves allocations from buffer until it is full.  The buffer must outlive the
+    // arena and is never freed by it.
+    MeshArena(void* buffer, size_t bufferBytes, size_t blockBytes = DefaultBlockBytes);
+
+    ~MeshArena();
+
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    // Returns bytes aligned to alignment, a power of two.  Never returns null.
+    void* Allocate(size_t bytes, size_t alignment);
+
+    // Frees every heap block and starts over at the beginning of the caller's
+    // buffer, invalidating everything allocated so far.
+    void Release();
+
+    // Allocations served, and heap blocks taken to serve them, since construction or
+    // the last Release().  A build that reserves exactly makes one allocation per array.
+    UINT64 AllocationCount() const { return m_AllocationCount; }
+    UINT64 BlockCount() const { return m_BlockCount; }
+
+    // Bytes handed out, alignment padding included.
+    size_t BytesAllocated() const { return m_BytesAllocated; }
+
+private:
+    struct Block
+    {
+        Block* Next;
+    };
+
+    BYTE* m_Buffer;
+    size_t m_BufferBytes;
+    size_t m_BlockBytes;
+
+    BYTE* m_Cursor;
+    BYTE* m_End;
+    Block* m_Blocks;
+
+    UINT64 m_AllocationCount;
+    UINT64 m_BlockCount;
+    size_t m_BytesAllocated;
+};
+
+
+template<typename T>
+class MeshAllocator
+{
+public:
+    typedef T value_type;
+
+    MeshAllocator() : m_Arena(nullptr) {}
+    explicit MeshAllocator(MeshArena* arena) : m_Arena(arena) {}
+
+    template<typename U>
+    MeshAllocator(const MeshAllocator<U>& other) : m_Arena(other.GetArena()) {}
+
+    T* allocate(size_t count)
+    {
+        if (m_Arena)
+        {
+            return static_cast<T*>(m_Arena->Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        // Arena memory goes back with the arena.
+        if (!m_Arena)
+        {
+            ::operator delete(p);
+        }
+    }
+
+    MeshArena* GetArena() const { return m_Arena; }
+
+private:
+    MeshArena* m_Arena;
+};
+
+template<typename T, typename U>
+bool operator==(const MeshAllocator<T>& a, const MeshAllocator<U>& b)
+{
+    return a.GetArena() == b.GetArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const MeshAllocator<T>& a, const MeshAllocator<U>& b)
+{
+    return a.GetArena() != b.GetArena();
+}
@@ -0,0 +1,82 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders indexed triangle lists so the GPU transforms fewer vertices.
+//
+// OptimizeVertexCache() reorders the triangles with Tom Forsyth's "Linear-Speed
+// Vertex Cache Optimisation": it emits, one at a time, the triangle whose vertices
+// score highest in a simulated LRU cache, favouring vertices with few triangles left
+// so that none are left stranded.  RemapVertices() then lays the vertices out in the
+// order the reordered indices first use them, so the vertex fetches walk the buffer
+// forwards.
+//
+// AnalyzeVertexCache() measures the result on a FIFO cache, as post-transform caches
+// are built: ACMR is vertices transformed per triangle (0.5 at best on a regular
+// grid, 3 at worst), ATVR is vertices transformed per vertex used (1 at best).
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+
+
+class MeshOptimizer
+{
+public:
+    struct VertexCacheStats
+    {
+        UINT VerticesTransformed;
+        float Acmr;
+        float Atvr;
+    };
+
+    // Entries of the FIFO cache AnalyzeVertexCache simulates by default.
+    static const UINT DefaultCacheSize = 16;
+
+    static VertexCacheStats AnalyzeVertexCache(const UINT* indices, UINT indexCount, UINT vertexCount,
+        UINT cacheSize = DefaultCacheSize);
+
+    // Reorders the triangles of indices in place, unless the order they are already in
+    // transforms no more vertices on a DefaultCacheSize FIFO.  Every index must be
+    // below vertexCount.
+    static void OptimizeVertexCache(UINT* indices, UINT indexCount, UINT vertexCount);
+
+    // Fills remap[v] with vertex v's position in the order indices first use the
+    // vertices; vertices no index uses keep their relative order after those.
+    static void BuildFetchRemap(const UINT* indices, UINT indexCount, UINT vertexCount, UINT* remap);
+
+    static void RemapIndices(UINT* indices, UINT indexCount, const UINT* remap);
+
+    // Moves vertices[v] to vertices[remap[v]].  Call once per array of a mesh whose
+    // attributes are kept in separate arrays.
+    template<typename Vertex>
+    static void RemapVertices(Vertex* vertices, UINT vertexCount, const UINT* remap);
+
+    // Both passes, for a mesh whose vertices may be moved.
+    template<typename Vertex>
+    static void Optimize(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount);
+};
+
+
+template<typename Vertex>
+void MeshOptimizer::RemapVertices(Vertex* vertices, UINT vertexCount, const UINT* remap)
+{
+    std::vector<Vertex> original(vertices, vertices + vertexCount);
+
+    for (UINT i = 0; i < vertexCount; ++i)
+    {
+        vertices[remap[i]] = original[i];
+    }
+}
+
+template<typename Vertex>
+void MeshOptimizer::Optimize(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount)
+{
+    OptimizeVertexCache(indices, indexCount, vertexCount);
+
+    std::vector<UINT> remap(vertexCount);
+    BuildFetchRemap(indices, indexCount, vertexCount, remap.data());
+    RemapIndices(indices, indexCount, remap.data());
+    RemapVertices(vertices, vertexCount, remap.data());
+}
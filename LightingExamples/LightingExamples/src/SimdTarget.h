@@ -0,0 +1,43 @@
+//***************************************************************************************
+// SimdTarget.h
+//
+// Attributes for kernels compiled for an ISA above the build's baseline, and a region
+// in which the compiler may not contract a*b+c into an FMA, so that vector kernels
+// round exactly like their scalar references.
+//
+// GCC and Clang contract by default whenever FMA is enabled (AVX-512, or an -march
+// that has it), GCC across statements and Clang within one expression, and a target
+// attribute can enable it for a single function.  GCC turns it off with the
+// fp-contract optimize option, Clang only with its fp contract pragma.  MSVC
+// contracts only under /fp:contract, which these projects do not use.
+//
+// Put SIMD_FP_CONTRACT_OFF_BEGIN before the first function it should cover and
+// SIMD_FP_CONTRACT_OFF_END after the last, both at namespace scope.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#else
+    #include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define SIMD_TARGET_AVX2
+    #define SIMD_TARGET_AVX512
+#else
+    #define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+    #define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#if defined(__clang__)
+    #define SIMD_FP_CONTRACT_OFF_BEGIN _Pragma("float_control(push)") _Pragma("clang fp contract(off)")
+    #define SIMD_FP_CONTRACT_OFF_END _Pragma("float_control(pop)")
+#elif defined(__GNUC__)
+    #define SIMD_FP_CONTRACT_OFF_BEGIN _Pragma("GCC push_options") _Pragma("GCC optimize(\"fp-contract=off\")")
+    #define SIMD_FP_CONTRACT_OFF_END _Pragma("GCC pop_options")
+#else
+    #define SIMD_FP_CONTRACT_OFF_BEGIN
+    #define SIMD_FP_CONTRACT_OFF_END
+#endif
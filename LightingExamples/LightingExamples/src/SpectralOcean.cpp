@@ -0,0 +1,324 @@
+//=======================================================================================
+// SpectralOcean.cpp
+//=======================================================================================
+
+#include "SpectralOcean.h"
+#include "WorkerPool.h"
+#include "MathHelper.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+namespace
+{
+    const float Gravity = 9.81f;
+
+    inline FFT::Complex Scale(FFT::Complex a, float s)
+    {
+        FFT::Complex c = { a.Re * s, a.Im * s };
+        return c;
+    }
+
+    // (a + bi) * h for real a, b.
+    inline FFT::Complex MulComplex(float a, float b, FFT::Complex h)
+    {
+        FFT::Complex c = { a * h.Re - b * h.Im, a * h.Im + b * h.Re };
+        return c;
+    }
+}
+
+SpectralOcean::Parameters::Parameters()
+    : Shape(Spectrum::Phillips), WindSpeed(10.0f), WindDirection(1.0f, 0.0f)
+    , Amplitude(0.0081f), Fetch(100000.0f), PeakEnhancement(3.3f)
+    , SmallWaveCutoff(0.0f), Choppiness(1.0f), Seed(1)
+{
+}
+
+SpectralOcean::SpectralOcean()
+    : m_Size(0), m_PatchSize(0.0f), m_SpatialStep(0.0f), m_HalfSize(0.0f)
+    , m_Time(0.0), m_Revision(0), m_WorkerPool(nullptr)
+{
+}
+
+XMFLOAT3 SpectralOcean::operator[](int i) const
+{
+    UINT row = i / m_Size;
+    UINT col = i % m_Size;
+
+    return XMFLOAT3(-m_HalfSize + col * m_SpatialStep + m_DisplacementX[i], m_Heights[i],
+        m_HalfSize - row * m_SpatialStep + m_DisplacementZ[i]);
+}
+
+XMFLOAT3 SpectralOcean::Normal(int i) const
+{
+    return XMFLOAT3(m_NormalX[i], m_NormalY[i], m_NormalZ[i]);
+}
+
+XMFLOAT3 SpectralOcean::TangentX(int i) const
+{
+    return XMFLOAT3(m_TangentXX[i], m_TangentXY[i], 0.0f);
+}
+
+float SpectralOcean::Wavenumber(UINT t) const
+{
+    int signedIndex = t < m_Size / 2 ? static_cast<int>(t) : static_cast<int>(t) - static_cast<int>(m_Size);
+    return 2.0f * MathHelper::Pi * signedIndex / m_PatchSize;
+}
+
+void SpectralOcean::Init(UINT n, float patchSize, const Parameters& params)
+{
+    assert(n >= 2 && (n & (n - 1)) == 0);
+
+    m_Size = n;
+    m_PatchSize = patchSize;
+    m_SpatialStep = patchSize / n;
+    m_HalfSize = 0.5f * (n - 1) * m_SpatialStep;
+    m_Params = params;
+    m_Time = 0.0;
+    m_Revision = 0;
+
+    float windLength = std::sqrt(params.WindDirection.x * params.WindDirection.x +
+        params.WindDirection.y * params.WindDirection.y);
+    if (windLength > 0.0f)
+    {
+        m_Params.WindDirection.x /= windLength;
+        m_Params.WindDirection.y /= windLength;
+    }
+    else
+    {
+        m_Params.WindDirection = XMFLOAT2(1.0f, 0.0f);
+    }
+
+    m_FFT.Init(n);
+
+    UINT count = n * n;
+    m_H0.resize(count);
+    m_H0MinusConj.resize(count);
+    m_Omega.resize(count);
+    m_HeightSlopeXField.resize(count);
+    m_SlopeZDisplacementXField.resize(count);
+    m_DisplacementZField.resize(count);
+    m_Heights.resize(count);
+    m_DisplacementX.resize(count);
+    m_DisplacementZ.resize(count);
+    m_NormalX.resize(count);
+    m_NormalY.resize(count);
+    m_NormalZ.resize(count);
+    m_TangentXX.resize(count);
+    m_TangentXY.resize(count);
+
+    // h0(k) = (xi_r + i xi_i) sqrt(P(k) dk^2 / 4) with xi ~ N(0, 1).  h(k, t) sums the
+    // amplitudes of k and -k, so this makes the height variance the integral of P.
+    // Two draws per bin, in bin order, so a seed always gives the same sea for a
+    // given n.
+    std::mt19937 random(params.Seed);
+    std::normal_distribution<float> gaussian(0.0f, 1.0f);
+    float binArea = (2.0f * MathHelper::Pi / patchSize) * (2.0f * MathHelper::Pi / patchSize);
+
+    for (UINT r = 0; r < n; ++r)
+    {
+        for (UINT c = 0; c < n; ++c)
+        {
+            UINT b = r * n + c;
+            float xiRe = gaussian(random);
+            float xiIm = gaussian(random);
+
+            // The Nyquist row and column have no mirror image in [-N/2, N/2), so they
+            // would leave the packed real fields complex; drop them.
+            if (r == n / 2 || c == n / 2)
+            {
+                m_H0[b].Re = m_H0[b].Im = 0.0f;
+                m_Omega[b] = 0.0f;
+                continue;
+            }
+
+            float kx = Wavenumber(c);
+            float kz = -Wavenumber(r);
+            float amplitude = std::sqrt(0.25f * SpectrumDensity(kx, kz) * binArea);
+            m_H0[b].Re = xiRe * amplitude;
+            m_H0[b].Im = xiIm * amplitude;
+
+            // Deep-water dispersion.
+            m_Omega[b] = std::sqrt(Gravity * std::sqrt(kx * kx + kz * kz));
+        }
+    }
+
+    for (UINT r = 0; r < n; ++r)
+    {
+        for (UINT c = 0; c < n; ++c)
+        {
+            FFT::Complex mirror = m_H0[((n - r) % n) * n + (n - c) % n];
+            m_H0MinusConj[r * n + c].Re = mirror.Re;
+            m_H0MinusConj[r * n + c].Im = -mirror.Im;
+        }
+    }
+
+    Evaluate();
+}
+
+float SpectralOcean::SpectrumDensity(float kx, float kz) const
+{
+    float kSq = kx * kx + kz * kz;
+    if (kSq == 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float k = std::sqrt(kSq);
+    float cosTheta = (kx * m_Params.WindDirection.x + kz * m_Params.WindDirection.y) / k;
+    float damping = std::exp(-kSq * m_Params.SmallWaveCutoff * m_Params.SmallWaveCutoff);
+
+    if (m_Params.Shape == Spectrum::Phillips)
+    {
+        // A exp(-1/(kL)^2) / k^4 |k.w|^2, L the largest wave the wind can raise.
+        float largestWave = m_Params.WindSpeed * m_Params.WindSpeed / Gravity;
+        float kl = k * largestWave;
+
+        return m_Params.Amplitude * std::exp(-1.0f / (kl * kl)) / (kSq * kSq) *
+            cosTheta * cosTheta * damping;
+    }
+
+    // JONSWAP frequency spectrum, mapped to wavenumber through w = sqrt(gk) and
+    // spread over direction with (2/pi) cos^2(theta) downwind.
+    if (cosTheta <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float u = m_Params.WindSpeed;
+    float fetch = m_Params.Fetch;
+    float alpha = 0.076f * std::pow(u * u / (fetch * Gravity), 0.22f);
+    float omegaPeak = 22.0f * std::pow(Gravity * Gravity / (u * fetch), 1.0f / 3.0f);
+
+    float omega = std::sqrt(Gravity * k);
+    float sigma = omega <= omegaPeak ? 0.07f : 0.09f;
+    float peak = (omega - omegaPeak) / (sigma * omegaPeak);
+    float peakRatio = omegaPeak / omega;
+
+    float spectrumOmega = alpha * Gravity * Gravity / std::pow(omega, 5.0f) *
+        std::exp(-1.25f * peakRatio * peakRatio * peakRatio * peakRatio) *
+        std::pow(m_Params.PeakEnhancement, std::exp(-0.5f * peak * peak));
+
+    float dOmegaDk = 0.5f * Gravity / omega;
+    float spreading = 2.0f / MathHelper::Pi * cosTheta * cosTheta;
+
+    return spectrumOmega * dOmegaDk / k * spreading * damping;
+}
+
+void SpectralOcean::Update(float dt)
+{
+    if (dt <= 0.0f)
+    {
+        return;
+    }
+
+    m_Time += dt;
+    Evaluate();
+    ++m_Revision;
+}
+
+void SpectralOcean::Evaluate()
+{
+    ForEachRowBand([this](UINT rowBegin, UINT rowEnd) { EvaluateSpectrum(rowBegin, rowEnd); });
+
+    m_FFT.Inverse2D(m_HeightSlopeXField.data(), m_WorkerPool);
+    m_FFT.Inverse2D(m_SlopeZDisplacementXField.data(), m_WorkerPool);
+    if (m_Params.Choppiness != 0.0f)
+    {
+        m_FFT.Inverse2D(m_DisplacementZField.data(), m_WorkerPool);
+    }
+
+    ForEachRowBand([this](UINT rowBegin, UINT rowEnd) { ResolveRows(rowBegin, rowEnd); });
+}
+
+void SpectralOcean::EvaluateSpectrum(UINT rowBegin, UINT rowEnd)
+{
+    const double TwoPi = 2.0 * 3.14159265358979323846;
+
+    for (UINT r = rowBegin; r < rowEnd; ++r)
+    {
+        float kz = -Wavenumber(r);
+
+        for (UINT c = 0; c < m_Size; ++c)
+        {
+            UINT b = r * m_Size + c;
+            float kx = Wavenumber(c);
+            float k = std::sqrt(kx * kx + kz * kz);
+
+            // h(k, t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt), which keeps h(-k, t) =
+            // conj(h(k, t)) so every field below is real in space.
+            float phase = static_cast<float>(std::fmod(m_Omega[b] * m_Time, TwoPi));
+            float cosPhase = std::cos(phase);
+            float sinPhase = std::sin(phase);
+
+            FFT::Complex h0 = m_H0[b];
+            FFT::Complex h0MinusConj = m_H0MinusConj[b];
+            FFT::Complex h;
+            h.Re = (h0.Re + h0MinusConj.Re) * cosPhase - (h0.Im - h0MinusConj.Im) * sinPhase;
+            h.Im = (h0.Im + h0MinusConj.Im) * cosPhase + (h0.Re - h0MinusConj.Re) * sinPhase;
+
+            // Pack two real fields F and G as F + iG:
+            //   height h and x slope i kx h:           h + i(i kx h) = (1 - kx) h
+            //   z slope i kz h and x displacement -i kx/k h:  (kx/k + i kz) h
+            //   z displacement -i kz/k h.
+            float kxOverK = k > 0.0f ? kx / k : 0.0f;
+            float kzOverK = k > 0.0f ? kz / k : 0.0f;
+
+            m_HeightSlopeXField[b] = Scale(h, 1.0f - kx);
+            m_SlopeZDisplacementXField[b] = MulComplex(kxOverK, kz, h);
+            m_DisplacementZField[b] = MulComplex(0.0f, -kzOverK, h);
+        }
+    }
+}
+
+void SpectralOcean::ResolveRows(UINT rowBegin, UINT rowEnd)
+{
+    float choppiness = m_Params.Choppiness;
+
+    for (UINT k = rowBegin * m_Size; k < rowEnd * m_Size; ++k)
+    {
+        float slopeX = m_HeightSlopeXField[k].Im;
+        float slopeZ = m_SlopeZDisplacementXField[k].Re;
+
+        m_Heights[k] = m_HeightSlopeXField[k].Re;
+        m_DisplacementX[k] = choppiness * m_SlopeZDisplacementXField[k].Im;
+        m_DisplacementZ[k] = choppiness != 0.0f ? choppiness * m_DisplacementZField[k].Re : 0.0f;
+
+        // From the height field's slopes; the horizontal displacement only moves the
+        // vertex, so with choppy waves the normal is the usual approximation.
+        float normalScale = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+        m_NormalX[k] = -slopeX * normalScale;
+        m_NormalY[k] = normalScale;
+        m_NormalZ[k] = -slopeZ * normalScale;
+
+        float tangentScale = 1.0f / std::sqrt(1.0f + slopeX * slopeX);
+        m_TangentXX[k] = tangentScale;
+        m_TangentXY[k] = slopeX * tangentScale;
+    }
+}
+
+void SpectralOcean::WriteVertices(const Waves::VertexStream& stream) const
+{
+    BYTE* v = static_cast<BYTE*>(stream.Data);
+    for (UINT k = 0; k < VertexCount(); ++k, v += stream.Stride)
+    {
+        XMFLOAT3 p = (*this)[k];
+        float* position = reinterpret_cast<float*>(v + stream.PositionOffset);
+        position[0] = p.x;
+        position[1] = p.y;
+        position[2] = p.z;
+
+        float* normal = reinterpret_cast<float*>(v + stream.NormalOffset);
+        normal[0] = m_NormalX[k];
+        normal[1] = m_NormalY[k];
+        normal[2] = m_NormalZ[k];
+    }
+}
+
+template<typename Body>
+void SpectralOcean::ForEachRowBand(const Body& body)
+{
+    WorkerPool::ForEachBand(m_WorkerPool, 0, m_Size, WorkerPool::MinBandRows,
+        [&](UINT rowBegin, UINT rowEnd, UINT) { body(rowBegin, rowEnd); });
+}
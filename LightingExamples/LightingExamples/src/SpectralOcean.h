@@ -0,0 +1,158 @@
+//***************************************************************************************
+// SpectralOcean.h
+//
+// Open-water surface synthesised from a wave spectrum (Tessendorf, "Simulating
+// Ocean Water").  Random complex amplitudes h0(k) are drawn once from a Phillips
+// or JONSWAP spectrum; each Update advances every wave by its deep-water
+// dispersion w = sqrt(g|k|) and resolves heights, slopes and the choppy horizontal
+// displacement with inverse 2D FFTs.  There is no time step and no stability
+// limit: Update(dt) evaluates the surface at the new time directly, in
+// O(N^2 log N) for an N x N grid.
+//
+// The grid is one period of a tileable patch and is laid out like Waves: vertex
+// i*N+j sits at x = -w/2 + j*dx, z = d/2 - i*dx before displacement, and the
+// accessors match Waves so either can drive the same vertex buffer.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "FFT.h"
+#include "Waves.h"
+using namespace DirectX;
+
+class WorkerPool;
+
+
+class SpectralOcean
+{
+public:
+    enum class Spectrum
+    {
+        Phillips,
+        Jonswap
+    };
+
+    struct Parameters
+    {
+        Parameters();
+
+        Spectrum Shape;
+
+        // Wind speed at 10m in m/s, and the direction it blows towards in the xz
+        // plane (normalised by Init).
+        float WindSpeed;
+        XMFLOAT2 WindDirection;
+
+        // Phillips: spectral constant A.  Energy is per unit area of wavenumber, so
+        // the grid resolution and patch size do not change the wave heights.
+        float Amplitude;
+
+        // JONSWAP: fetch in metres and the peak enhancement factor gamma.
+        float Fetch;
+        float PeakEnhancement;
+
+        // Waves shorter than this (in metres) are suppressed.
+        float SmallWaveCutoff;
+
+        // Scale of the horizontal displacement that sharpens crests; 0 gives a
+        // plain height field and skips one FFT per update.
+        float Choppiness;
+
+        UINT Seed;
+    };
+
+public:
+    SpectralOcean();
+
+    UINT RowCount() const { return m_Size; }
+    UINT ColumnCount() const { return m_Size; }
+    UINT VertexCount() const { return m_Size * m_Size; }
+    UINT TriangleCount() const { return (m_Size - 1) * (m_Size - 1) * 2; }
+
+    // Returns the displaced surface position at the ith grid point.
+    XMFLOAT3 operator[](int i) const;
+
+    // Returns the surface normal at the ith grid point.
+    XMFLOAT3 Normal(int i) const;
+
+    // Returns the unit tangent vector at the ith grid point in the local x-axis direction.
+    XMFLOAT3 TangentX(int i) const;
+
+    float SpatialStep() const { return m_SpatialStep; }
+    float PatchSize() const { return m_PatchSize; }
+    double SimulatedTime() const { return m_Time; }
+
+    // Incremented by every Update that moves the surface.
+    UINT Revision() const { return m_Revision; }
+
+    // Splits the spectrum, FFT and resolve passes into bands on the given pool,
+    // which is not owned; nullptr (the default) runs serially.
+    void SetWorkerPool(WorkerPool* pool) { m_WorkerPool = pool; }
+
+    // n must be a power of two; patchSize is the side of the periodic patch in
+    // metres.  Draws the spectrum amplitudes and resolves the surface at time 0.
+    void Init(UINT n, float patchSize, const Parameters& params);
+
+    // Advances the surface by dt seconds.
+    void Update(float dt);
+
+    // Writes every vertex's position and normal into stream.
+    void WriteVertices(const Waves::VertexStream& stream) const;
+
+private:
+    // Variance of the surface height carried by the wavevector (kx, kz), per unit
+    // area of wavenumber space.
+    float SpectrumDensity(float kx, float kz) const;
+
+    // Fills the FFT inputs for rows [rowBegin, rowEnd) of the spectrum at m_Time.
+    void EvaluateSpectrum(UINT rowBegin, UINT rowEnd);
+
+    // Unpacks the FFT outputs of rows [rowBegin, rowEnd) into the surface planes.
+    void ResolveRows(UINT rowBegin, UINT rowEnd);
+
+    void Evaluate();
+
+    // Calls body(rowBegin, rowEnd) over all rows, one band per task.
+    template<typename Body>
+    void ForEachRowBand(const Body& body);
+
+    // Wavenumber of FFT row or column index t: 2 pi/L times t in [-N/2, N/2).
+    float Wavenumber(UINT t) const;
+
+private:
+    UINT m_Size;
+    float m_PatchSize;
+    float m_SpatialStep;
+    float m_HalfSize;
+    Parameters m_Params;
+
+    double m_Time;
+    UINT m_Revision;
+
+    WorkerPool* m_WorkerPool;
+    FFT m_FFT;
+
+    // Per wavevector: h0(k), conj(h0(-k)) and the angular frequency.
+    std::vector<FFT::Complex> m_H0;
+    std::vector<FFT::Complex> m_H0MinusConj;
+    std::vector<float> m_Omega;
+
+    // Two real fields per complex FFT, one in each of the real and imaginary parts:
+    // (height, x slope), (z slope, x displacement) and (z displacement, -).
+    std::vector<FFT::Complex> m_HeightSlopeXField;
+    std::vector<FFT::Complex> m_SlopeZDisplacementXField;
+    std::vector<FFT::Complex> m_DisplacementZField;
+
+    // The resolved surface, one plane per component.
+    std::vector<float> m_Heights;
+    std::vector<float> m_DisplacementX;
+    std::vector<float> m_DisplacementZ;
+    std::vector<float> m_NormalX;
+    std::vector<float> m_NormalY;
+    std::vector<float> m_NormalZ;
+    std::vector<float> m_TangentXX;
+    std::vector<float> m_TangentXY;
+};
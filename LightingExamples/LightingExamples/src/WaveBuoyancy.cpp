@@ -0,0 +1,336 @@
+//=======================================================================================
+// WaveBuoyancy.cpp
+//=======================================================================================
+
+#include "WaveBuoyancy.h"
+#include "WaveSnapshot.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+    // Bodies sampled and integrated together; the surface samples live on the stack.
+    const UINT ChunkSize = 256;
+
+    // Bodies per WorkerPool task.
+    const UINT BatchSize = 4096;
+
+    // Constants of one step, shared by the scalar and SSE2 paths.
+    struct StepConstants
+    {
+        float Dt;
+        float Gravity;
+        float DragDt;
+        float TiltStiffness;
+        float TiltDamping;
+    };
+
+    // One body; the SSE2 loop below performs the same operations in the same order.
+    inline void IntegrateBody(const StepConstants& c, float h, float nx, float ny, float nz,
+        float radius, float invDiameter, float invDensity,
+        float& x, float& y, float& z, float& vx, float& vy, float& vz,
+        float& ux, float& uz, float& wx, float& wz, float& submerged)
+    {
+        float depth = h - (y - radius);
+        depth = depth > 0.0f ? depth : 0.0f;
+        float diameter = radius + radius;
+        depth = depth < diameter ? depth : diameter;
+        float f = depth * invDiameter;
+
+        // Buoyancy along the normal against gravity; drag applied implicitly so any
+        // dt is stable.
+        float buoyancy = (c.Gravity * invDensity) * f;
+        float damping = 1.0f / (1.0f + c.DragDt * f);
+        vx = (vx + (buoyancy * nx) * c.Dt) * damping;
+        vy = (vy + (buoyancy * ny - c.Gravity) * c.Dt) * damping;
+        vz = (vz + (buoyancy * nz) * c.Dt) * damping;
+        x += vx * c.Dt;
+        y += vy * c.Dt;
+        z += vz * c.Dt;
+
+        // Out of the water the spring lets go and the tilt only damps.
+        float ex = f > 0.0f ? nx - ux : 0.0f;
+        float ez = f > 0.0f ? nz - uz : 0.0f;
+        wx += (c.TiltStiffness * ex - c.TiltDamping * wx) * c.Dt;
+        wz += (c.TiltStiffness * ez - c.TiltDamping * wz) * c.Dt;
+        ux += wx * c.Dt;
+        uz += wz * c.Dt;
+
+        submerged = f;
+    }
+}
+
+WaveBuoyancy::WaveBuoyancy()
+    : m_WorkerPool(nullptr)
+{
+}
+
+UINT WaveBuoyancy::AddBody(const XMFLOAT3& position, float radius, float relativeDensity)
+{
+    m_PositionX.push_back(position.x);
+    m_PositionY.push_back(position.y);
+    m_PositionZ.push_back(position.z);
+    m_VelocityX.push_back(0.0f);
+    m_VelocityY.push_back(0.0f);
+    m_VelocityZ.push_back(0.0f);
+    m_UpX.push_back(0.0f);
+    m_UpZ.push_back(0.0f);
+    m_TiltRateX.push_back(0.0f);
+    m_TiltRateZ.push_back(0.0f);
+    m_Radius.push_back(radius);
+    m_InvDiameter.push_back(0.5f / radius);
+    m_InvDensity.push_back(1.0f / relativeDensity);
+    m_Submerged.push_back(0.0f);
+
+    return BodyCount() - 1;
+}
+
+template<typename Fn>
+void WaveBuoyancy::ForEachPlane(const Fn& fn)
+{
+    std::vector<float>* planes[] =
+    {
+        &m_PositionX, &m_PositionY, &m_PositionZ, &m_VelocityX, &m_VelocityY, &m_VelocityZ,
+        &m_UpX, &m_UpZ, &m_TiltRateX, &m_TiltRateZ, &m_Radius, &m_InvDiameter, &m_InvDensity, &m_Submerged
+    };
+
+    for (std::vector<float>* plane : planes)
+    {
+        fn(*plane);
+    }
+}
+
+void WaveBuoyancy::Clear()
+{
+    ForEachPlane([](std::vector<float>& plane) { plane.clear(); });
+}
+
+void WaveBuoyancy::Reserve(UINT count)
+{
+    ForEachPlane([count](std::vector<float>& plane) { plane.reserve(count); });
+}
+
+XMFLOAT3 WaveBuoyancy::Up(UINT i) const
+{
+    float x = m_UpX[i];
+    float z = m_UpZ[i];
+
+    return XMFLOAT3(x, sqrtf(std::max(1.0f - x * x - z * z, 0.0f)), z);
+}
+
+void WaveBuoyancy::Step(Waves& waves, float dt)
+{
+    GridInfo grid = { waves.RowCount(), waves.ColumnCount(), waves.SpatialStep() };
+    bool withWakes = m_Parameters.WakeGain > 0.0f;
+
+    StepBodies(grid, [&waves](const Waves::SurfaceQuery& query) { waves.SampleSurface(query); },
+        dt, withWakes ? &m_Wakes : nullptr);
+
+    if (withWakes && !m_Wakes.empty())
+    {
+        waves.QueueDisturbances(m_Wakes.data(), static_cast<UINT>(m_Wakes.size()));
+    }
+}
+
+void WaveBuoyancy::Step(const WaveSnapshot& frame, float dt, std::vector<Waves::Disturbance>* wakes)
+{
+    GridInfo grid = { frame.RowCount, frame.ColumnCount, frame.SpatialStep };
+    bool withWakes = wakes && m_Parameters.WakeGain > 0.0f;
+
+    StepBodies(grid, [&frame](const Waves::SurfaceQuery& query) { Waves::SampleSurface(frame, query); },
+        dt, withWakes ? &m_Wakes : nullptr);
+
+    if (withWakes)
+    {
+        wakes->insert(wakes->end(), m_Wakes.begin(), m_Wakes.end());
+    }
+}
+
+template<typename Sample>
+void WaveBuoyancy::StepBodies(const GridInfo& grid, const Sample& sample, float dt, std::vector<Waves::Disturbance>* wakes)
+{
+    UINT count = BodyCount();
+    UINT batchCount = (count + BatchSize - 1) / BatchSize;
+    if (wakes)
+    {
+        m_BatchWakes.resize(batchCount);
+    }
+
+    auto batch = [&](UINT b)
+    {
+        UINT batchEnd = std::min((b + 1) * BatchSize, count);
+        for (UINT begin = b * BatchSize; begin < batchEnd; begin += ChunkSize)
+        {
+            UINT end = std::min(begin + ChunkSize, batchEnd);
+
+            float heights[ChunkSize];
+            float nx[ChunkSize];
+            float ny[ChunkSize];
+            float nz[ChunkSize];
+
+            Waves::SurfaceQuery query;
+            query.X = &m_PositionX[begin];
+            query.Z = &m_PositionZ[begin];
+            query.Count = end - begin;
+            query.Heights = heights;
+            query.NormalX = nx;
+            query.NormalY = ny;
+            query.NormalZ = nz;
+            sample(query);
+
+            Integrate(begin, end, heights, nx, ny, nz, dt);
+        }
+
+        if (wakes)
+        {
+            m_BatchWakes[b].clear();
+            CollectWakes(grid, b * BatchSize, batchEnd, dt, m_BatchWakes[b]);
+        }
+    };
+
+    if (m_WorkerPool && batchCount > 1)
+    {
+        m_WorkerPool->Run(batchCount, batch);
+    }
+    else
+    {
+        for (UINT b = 0; b < batchCount; ++b)
+        {
+            batch(b);
+        }
+    }
+
+    if (wakes)
+    {
+        wakes->clear();
+        for (UINT b = 0; b < batchCount; ++b)
+        {
+            wakes->insert(wakes->end(), m_BatchWakes[b].begin(), m_BatchWakes[b].end());
+        }
+    }
+}
+
+void WaveBuoyancy::Integrate(UINT begin, UINT end, const float* heights, const float* nx, const float* ny, const float* nz, float dt)
+{
+    StepConstants c;
+    c.Dt = dt;
+    c.Gravity = m_Parameters.Gravity;
+    c.DragDt = m_Parameters.LinearDrag * dt;
+    c.TiltStiffness = m_Parameters.TiltStiffness;
+    c.TiltDamping = m_Parameters.TiltDamping;
+
+    float* x = &m_PositionX[begin];
+    float* y = &m_PositionY[begin];
+    float* z = &m_PositionZ[begin];
+    float* vx = &m_VelocityX[begin];
+    float* vy = &m_VelocityY[begin];
+    float* vz = &m_VelocityZ[begin];
+    float* ux = &m_UpX[begin];
+    float* uz = &m_UpZ[begin];
+    float* wx = &m_TiltRateX[begin];
+    float* wz = &m_TiltRateZ[begin];
+    float* submerged = &m_Submerged[begin];
+    const float* radius = &m_Radius[begin];
+    const float* invDiameter = &m_InvDiameter[begin];
+    const float* invDensity = &m_InvDensity[begin];
+    UINT count = end - begin;
+
+    __m128 vDt = _mm_set1_ps(c.Dt);
+    __m128 vGravity = _mm_set1_ps(c.Gravity);
+    __m128 vDragDt = _mm_set1_ps(c.DragDt);
+    __m128 vStiffness = _mm_set1_ps(c.TiltStiffness);
+    __m128 vDamping = _mm_set1_ps(c.TiltDamping);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 zero = _mm_setzero_ps();
+
+    UINT k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        __m128 r = _mm_loadu_ps(radius + k);
+        __m128 py = _mm_loadu_ps(y + k);
+        __m128 depth = _mm_sub_ps(_mm_loadu_ps(heights + k), _mm_sub_ps(py, r));
+        depth = _mm_min_ps(_mm_max_ps(depth, zero), _mm_add_ps(r, r));
+        __m128 f = _mm_mul_ps(depth, _mm_loadu_ps(invDiameter + k));
+
+        __m128 n0 = _mm_loadu_ps(nx + k);
+        __m128 n1 = _mm_loadu_ps(ny + k);
+        __m128 n2 = _mm_loadu_ps(nz + k);
+        __m128 buoyancy = _mm_mul_ps(_mm_mul_ps(vGravity, _mm_loadu_ps(invDensity + k)), f);
+        __m128 damping = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(vDragDt, f)));
+
+        __m128 v0 = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + k), _mm_mul_ps(_mm_mul_ps(buoyancy, n0), vDt)), damping);
+        __m128 v1 = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + k),
+            _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(buoyancy, n1), vGravity), vDt)), damping);
+        __m128 v2 = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vz + k), _mm_mul_ps(_mm_mul_ps(buoyancy, n2), vDt)), damping);
+        _mm_storeu_ps(vx + k, v0);
+        _mm_storeu_ps(vy + k, v1);
+        _mm_storeu_ps(vz + k, v2);
+        _mm_storeu_ps(x + k, _mm_add_ps(_mm_loadu_ps(x + k), _mm_mul_ps(v0, vDt)));
+        _mm_storeu_ps(y + k, _mm_add_ps(py, _mm_mul_ps(v1, vDt)));
+        _mm_storeu_ps(z + k, _mm_add_ps(_mm_loadu_ps(z + k), _mm_mul_ps(v2, vDt)));
+
+        __m128 inWater = _mm_cmpgt_ps(f, zero);
+        __m128 u0 = _mm_loadu_ps(ux + k);
+        __m128 u2 = _mm_loadu_ps(uz + k);
+        __m128 e0 = _mm_and_ps(inWater, _mm_sub_ps(n0, u0));
+        __m128 e2 = _mm_and_ps(inWater, _mm_sub_ps(n2, u2));
+        __m128 w0 = _mm_loadu_ps(wx + k);
+        __m128 w2 = _mm_loadu_ps(wz + k);
+        w0 = _mm_add_ps(w0, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(vStiffness, e0), _mm_mul_ps(vDamping, w0)), vDt));
+        w2 = _mm_add_ps(w2, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(vStiffness, e2), _mm_mul_ps(vDamping, w2)), vDt));
+        _mm_storeu_ps(wx + k, w0);
+        _mm_storeu_ps(wz + k, w2);
+        _mm_storeu_ps(ux + k, _mm_add_ps(u0, _mm_mul_ps(w0, vDt)));
+        _mm_storeu_ps(uz + k, _mm_add_ps(u2, _mm_mul_ps(w2, vDt)));
+
+        _mm_storeu_ps(submerged + k, f);
+    }
+
+    for (; k < count; ++k)
+    {
+        IntegrateBody(c, heights[k], nx[k], ny[k], nz[k], radius[k], invDiameter[k], invDensity[k],
+            x[k], y[k], z[k], vx[k], vy[k], vz[k], ux[k], uz[k], wx[k], wz[k], submerged[k]);
+    }
+}
+
+void WaveBuoyancy::CollectWakes(const GridInfo& grid, UINT begin, UINT end, float dt, std::vector<Waves::Disturbance>& wakes) const
+{
+    float invDx = 1.0f / grid.SpatialStep;
+    float halfWidth = 0.5f * (grid.ColumnCount - 1);
+    float halfDepth = 0.5f * (grid.RowCount - 1);
+    float minSpeedSq = m_Parameters.WakeMinSpeed * m_Parameters.WakeMinSpeed;
+
+    for (UINT k = begin; k < end; ++k)
+    {
+        float f = m_Submerged[k];
+        if (f <= 0.0f)
+        {
+            continue;
+        }
+
+        float vx = m_VelocityX[k];
+        float vy = m_VelocityY[k];
+        float vz = m_VelocityZ[k];
+        float speedSq = vx * vx + vy * vy + vz * vz;
+        if (speedSq <= minSpeedSq)
+        {
+            continue;
+        }
+
+        // Nearest grid point; bodies off the grid leave no wake.
+        float col = floorf(m_PositionX[k] * invDx + halfWidth + 0.5f);
+        float row = floorf(halfDepth - m_PositionZ[k] * invDx + 0.5f);
+        if (col < 0.0f || row < 0.0f || col >= grid.ColumnCount || row >= grid.RowCount)
+        {
+            continue;
+        }
+
+        Waves::Disturbance wake;
+        wake.Row = static_cast<UINT>(row);
+        wake.Col = static_cast<UINT>(col);
+        wake.Magnitude = -m_Parameters.WakeGain * f * sqrtf(speedSq) * dt;
+        wakes.push_back(wake);
+    }
+}
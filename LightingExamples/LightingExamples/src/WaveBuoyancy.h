@@ -0,0 +1,135 @@
+//***************************************************************************************
+// WaveBuoyancy.h
+//
+// Many small rigid floaters on a Waves surface.  Each body is a sphere of some
+// radius and density relative to water, stored structure-of-arrays so a step can
+// sample the surface for a whole batch with Waves::SampleSurface and integrate
+// four bodies per instruction.
+//
+// Per step a body feels gravity, buoyancy proportional to its submerged fraction
+// along the surface normal (so it drifts down wave slopes), and linear drag
+// proportional to the same fraction.  Its up vector is pulled towards the surface
+// normal by a damped spring while it is in the water.  Positions are in the grid's
+// local frame, the one Waves::operator[] positions are in.
+//***************************************************************************************
+
+#pragma once
+
+#include "Waves.h"
+#include <vector>
+
+class WorkerPool;
+struct WaveSnapshot;
+
+
+class WaveBuoyancy
+{
+public:
+    struct Parameters
+    {
+        Parameters()
+            : Gravity(9.8f), LinearDrag(1.5f), TiltStiffness(20.0f), TiltDamping(6.0f)
+            , WakeGain(0.0f), WakeMinSpeed(0.5f) {}
+
+        float Gravity;
+
+        // Velocity decay rate, per second, of a fully submerged body.
+        float LinearDrag;
+
+        // Spring pulling a floating body's up vector towards the surface normal.
+        float TiltStiffness;
+        float TiltDamping;
+
+        // A body moving faster than WakeMinSpeed while in the water disturbs the grid
+        // point under it by -WakeGain * submergedFraction * speed * dt.  0 disables wakes.
+        float WakeGain;
+        float WakeMinSpeed;
+    };
+
+public:
+    WaveBuoyancy();
+
+    void SetParameters(const Parameters& parameters) { m_Parameters = parameters; }
+    const Parameters& GetParameters() const { return m_Parameters; }
+
+    // Splits each step into batches run on the given pool; nullptr (the default)
+    // runs serially.  Results do not depend on the pool.
+    void SetWorkerPool(WorkerPool* pool) { m_WorkerPool = pool; }
+
+    // Adds a body at rest, upright, and returns its index.  relativeDensity is the
+    // body's density over the water's; below 1 it floats.
+    UINT AddBody(const XMFLOAT3& position, float radius, float relativeDensity);
+    void Clear();
+    void Reserve(UINT count);
+
+    UINT BodyCount() const { return static_cast<UINT>(m_PositionX.size()); }
+
+    XMFLOAT3 Position(UINT i) const { return XMFLOAT3(m_PositionX[i], m_PositionY[i], m_PositionZ[i]); }
+    XMFLOAT3 Velocity(UINT i) const { return XMFLOAT3(m_VelocityX[i], m_VelocityY[i], m_VelocityZ[i]); }
+    XMFLOAT3 Up(UINT i) const;
+    float SubmergedFraction(UINT i) const { return m_Submerged[i]; }
+
+    // Position planes, e.g. for filling an instance buffer.
+    const float* PositionX() const { return m_PositionX.data(); }
+    const float* PositionY() const { return m_PositionY.data(); }
+    const float* PositionZ() const { return m_PositionZ.data(); }
+
+    // Advances every body by dt on the live surface of waves.  Wakes are queued on
+    // waves and applied at its next step.
+    void Step(Waves& waves, float dt);
+
+    // The same on a published frame, e.g. from the render thread while the
+    // simulation thread owns the Waves.  Wakes are appended to wakes, if given, for
+    // the owner to pass to Waves::QueueDisturbances.
+    void Step(const WaveSnapshot& frame, float dt, std::vector<Waves::Disturbance>* wakes);
+
+private:
+    // Grid placement for turning positions into wake grid points.
+    struct GridInfo
+    {
+        UINT RowCount;
+        UINT ColumnCount;
+        float SpatialStep;
+    };
+
+    template<typename Sample>
+    void StepBodies(const GridInfo& grid, const Sample& sample, float dt, std::vector<Waves::Disturbance>* wakes);
+
+    // Integrates bodies [begin, end) given their sampled surface.
+    void Integrate(UINT begin, UINT end, const float* heights, const float* nx, const float* ny, const float* nz, float dt);
+
+    // Appends the wakes of bodies [begin, end) to wakes.
+    void CollectWakes(const GridInfo& grid, UINT begin, UINT end, float dt, std::vector<Waves::Disturbance>& wakes) const;
+
+    // Calls fn(plane) for every per-body plane.
+    template<typename Fn>
+    void ForEachPlane(const Fn& fn);
+
+private:
+    Parameters m_Parameters;
+    WorkerPool* m_WorkerPool;
+
+    std::vector<float> m_PositionX;
+    std::vector<float> m_PositionY;
+    std::vector<float> m_PositionZ;
+    std::vector<float> m_VelocityX;
+    std::vector<float> m_VelocityY;
+    std::vector<float> m_VelocityZ;
+
+    // x and z of the up vector and their rates of change; y is implied.
+    std::vector<float> m_UpX;
+    std::vector<float> m_UpZ;
+    std::vector<float> m_TiltRateX;
+    std::vector<float> m_TiltRateZ;
+
+    std::vector<float> m_Radius;
+    std::vector<float> m_InvDiameter;
+    std::vector<float> m_InvDensity;
+
+    // Fraction of the body below the surface after the last step, in [0, 1].
+    std::vector<float> m_Submerged;
+
+    // One wake list per batch, merged in batch order so results are deterministic.
+    std::vector<std::vector<Waves::Disturbance>> m_BatchWakes;
+    std::vector<Waves::Disturbance> m_Wakes;
+};
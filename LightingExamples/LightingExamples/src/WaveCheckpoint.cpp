@@ -0,0 +1,252 @@
+//=======================================================================================
+// WaveCheckpoint.cpp
+//=======================================================================================
+
+#include "WaveCheckpoint.h"
+#include <algorithm>
+
+#if !defined(_MSC_VER)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    // The header is written as-is, so its layout must not depend on the compiler.
+    static_assert(sizeof(WaveCheckpoint::Header) == 64, "WaveCheckpoint::Header must have no padding.");
+
+    UINT64 AlignUp(UINT64 bytes, UINT64 alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    // Written in place of padding.
+    const BYTE ZeroBlock[WaveCheckpoint::PlaneAlignment] = {};
+
+    FILE* CreateForWriting(const char* path)
+    {
+#if defined(_MSC_VER)
+        FILE* file = nullptr;
+        return fopen_s(&file, path, "wb") == 0 ? file : nullptr;
+#else
+        return fopen(path, "wb");
+#endif
+    }
+}
+
+UINT64 WaveCheckpoint::PlaneBytes(const Header& header)
+{
+    return AlignUp(static_cast<UINT64>(header.RowCount) * header.RowPitch * sizeof(float), PlaneAlignment);
+}
+
+WaveCheckpoint::WaveCheckpoint()
+    : m_View(nullptr), m_ViewBytes(0)
+{
+}
+
+WaveCheckpoint::~WaveCheckpoint()
+{
+    Close();
+}
+
+bool WaveCheckpoint::Open(const char* path)
+{
+    Close();
+
+    void* view = nullptr;
+    UINT64 viewBytes = 0;
+
+#if defined(_MSC_VER)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(Header)))
+    {
+        // The view keeps the mapping, and the mapping the file, alive once mapped.
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (mapping)
+        {
+            view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            viewBytes = static_cast<UINT64>(fileSize.QuadPart);
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) == 0 && fileStat.st_size >= static_cast<off_t>(sizeof(Header)))
+    {
+        // A private mapping may be writable even though the file is opened read-only.
+        void* p = mmap(nullptr, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+        if (p != MAP_FAILED)
+        {
+            view = p;
+            viewBytes = static_cast<UINT64>(fileStat.st_size);
+        }
+    }
+
+    close(file);
+#endif
+
+    if (!view)
+    {
+        return false;
+    }
+
+    m_View = view;
+    m_ViewBytes = viewBytes;
+
+    const Header& header = GetHeader();
+    bool valid = header.Magic == Magic && header.Version == CurrentVersion && header.Complete != 0 &&
+        header.HeaderBytes >= sizeof(Header) && header.HeaderBytes % PlaneAlignment == 0 &&
+        header.RowPitch >= header.ColumnCount &&
+        header.HeaderBytes + header.PlaneCount * PlaneBytes(header) <= m_ViewBytes;
+
+    if (!valid)
+    {
+        Close();
+    }
+
+    return valid;
+}
+
+void WaveCheckpoint::Close()
+{
+    if (!m_View)
+    {
+        return;
+    }
+
+#if defined(_MSC_VER)
+    UnmapViewOfFile(m_View);
+#else
+    munmap(m_View, m_ViewBytes);
+#endif
+
+    m_View = nullptr;
+    m_ViewBytes = 0;
+}
+
+float* WaveCheckpoint::Plane(UINT index) const
+{
+    const Header& header = GetHeader();
+    return reinterpret_cast<float*>(static_cast<BYTE*>(m_View) + header.HeaderBytes + index * PlaneBytes(header));
+}
+
+WaveCheckpointWriter::WaveCheckpointWriter()
+    : m_File(nullptr), m_Header(), m_Plane(0), m_Row(0), m_Failed(false)
+{
+}
+
+WaveCheckpointWriter::~WaveCheckpointWriter()
+{
+    if (m_File)
+    {
+        fclose(m_File);
+    }
+}
+
+bool WaveCheckpointWriter::Open(const char* path, const WaveCheckpoint::Header& header)
+{
+    if (m_File)
+    {
+        fclose(m_File);
+        m_File = nullptr;
+    }
+
+    m_Header = header;
+    m_Header.Magic = WaveCheckpoint::Magic;
+    m_Header.Version = WaveCheckpoint::CurrentVersion;
+    m_Header.HeaderBytes = static_cast<UINT>(AlignUp(sizeof(WaveCheckpoint::Header), WaveCheckpoint::PlaneAlignment));
+    m_Header.Complete = 0;
+
+    m_Plane = 0;
+    m_Row = 0;
+    m_Failed = false;
+
+    m_File = CreateForWriting(path);
+    if (!m_File)
+    {
+        return false;
+    }
+
+    m_Failed = fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1 ||
+        !WritePadding(m_Header.HeaderBytes - sizeof(m_Header));
+
+    return !m_Failed;
+}
+
+bool WaveCheckpointWriter::WriteRows(const float* rows, UINT rowCount)
+{
+    if (!m_File || m_Failed || m_Plane >= m_Header.PlaneCount || m_Row + rowCount > m_Header.RowCount)
+    {
+        m_Failed = true;
+        return false;
+    }
+
+    size_t floatCount = static_cast<size_t>(rowCount) * m_Header.RowPitch;
+    m_Failed = fwrite(rows, sizeof(float), floatCount, m_File) != floatCount;
+    m_Row += rowCount;
+
+    if (!m_Failed && m_Row == m_Header.RowCount)
+    {
+        UINT64 dataBytes = static_cast<UINT64>(m_Header.RowCount) * m_Header.RowPitch * sizeof(float);
+        m_Failed = !WritePadding(WaveCheckpoint::PlaneBytes(m_Header) - dataBytes);
+        ++m_Plane;
+        m_Row = 0;
+    }
+
+    return !m_Failed;
+}
+
+bool WaveCheckpointWriter::Close()
+{
+    if (!m_File)
+    {
+        return false;
+    }
+
+    // The header goes out last so the file only claims to be complete once the
+    // planes are in it.
+    bool complete = !m_Failed && m_Plane == m_Header.PlaneCount && fflush(m_File) == 0;
+    if (complete)
+    {
+        m_Header.Complete = 1;
+        complete = fseek(m_File, 0, SEEK_SET) == 0 &&
+            fwrite(&m_Header, sizeof(m_Header), 1, m_File) == 1;
+    }
+
+    complete = fclose(m_File) == 0 && complete;
+    m_File = nullptr;
+
+    return complete;
+}
+
+bool WaveCheckpointWriter::WritePadding(UINT64 byteCount)
+{
+    while (byteCount > 0)
+    {
+        size_t chunk = static_cast<size_t>(std::min<UINT64>(byteCount, sizeof(ZeroBlock)));
+        if (fwrite(ZeroBlock, 1, chunk, m_File) != chunk)
+        {
+            return false;
+        }
+
+        byteCount -= chunk;
+    }
+
+    return true;
+}
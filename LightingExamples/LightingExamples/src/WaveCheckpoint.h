@@ -0,0 +1,119 @@
+//***************************************************************************************
+// WaveCheckpoint.h
+//
+// A binary checkpoint of a Waves simulation, for resuming from a warmed-up sea state.
+// The file is a Header padded to PlaneAlignment bytes followed by PlaneCount planes
+// of RowCount rows of RowPitch floats each, exactly as Waves keeps them in memory:
+// previous heights, current heights, normal x, y, z, tangent x, y.  Every plane
+// starts on a page boundary, so a mapped file can be used as the solver's storage
+// without copying.  Little-endian only.
+//
+// WaveCheckpointWriter streams the planes out a band of rows at a time and only
+// marks the file complete once the last one is written, so a crash mid-write leaves
+// a checkpoint WaveCheckpoint refuses to open rather than a torn one.
+//
+// Waves::SaveCheckpoint and Waves::LoadCheckpoint wrap both.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <cstdio>
+
+
+class WaveCheckpoint
+{
+public:
+    static const UINT Magic = 0x4B435657;   // "WVCK"
+    static const UINT CurrentVersion = 1;
+
+    // Offset of the first plane and size of every plane are multiples of this.
+    static const UINT PlaneAlignment = 4096;
+
+    struct Header
+    {
+        UINT Magic;
+        UINT Version;
+
+        // Offset of the first plane.
+        UINT HeaderBytes;
+
+        // Nonzero once every plane has been written.
+        UINT Complete;
+
+        UINT RowCount;
+        UINT ColumnCount;
+        UINT RowPitch;
+        UINT PlaneCount;
+
+        float SpatialStep;
+        float TimeStep;
+        float K1;
+        float K2;
+        float K3;
+
+        // Waves' unsimulated time and step count, so a restored run keeps its clock.
+        float Accumulator;
+        UINT64 TotalStepCount;
+    };
+
+    // Bytes each plane takes in the file, padding included.
+    static UINT64 PlaneBytes(const Header& header);
+
+public:
+    WaveCheckpoint();
+    ~WaveCheckpoint();
+
+    WaveCheckpoint(const WaveCheckpoint&) = delete;
+    WaveCheckpoint& operator=(const WaveCheckpoint&) = delete;
+
+    // Maps path copy-on-write: pages are read from the file on first touch and
+    // copied on first write, and the file itself is never modified.  Returns false
+    // if the file cannot be mapped, is truncated or incomplete, or has another magic
+    // or version.
+    bool Open(const char* path);
+    void Close();
+
+    bool IsOpen() const { return m_View != nullptr; }
+    const Header& GetHeader() const { return *static_cast<const Header*>(m_View); }
+
+    // Start of plane index; PlaneBytes() apart and page aligned.
+    float* Plane(UINT index) const;
+
+private:
+    void* m_View;
+    UINT64 m_ViewBytes;
+};
+
+
+class WaveCheckpointWriter
+{
+public:
+    WaveCheckpointWriter();
+    ~WaveCheckpointWriter();
+
+    WaveCheckpointWriter(const WaveCheckpointWriter&) = delete;
+    WaveCheckpointWriter& operator=(const WaveCheckpointWriter&) = delete;
+
+    // Creates path and writes header, with Magic, Version, HeaderBytes and Complete
+    // filled in.  Returns false if the file cannot be created.
+    bool Open(const char* path, const WaveCheckpoint::Header& header);
+
+    // Appends rowCount rows of RowPitch floats, starting at rows, to the plane being
+    // written.  A plane is finished, and padded, once it has RowCount rows.
+    bool WriteRows(const float* rows, UINT rowCount);
+
+    // Marks the checkpoint complete if every plane was written in full, and closes
+    // the file.  Returns false if it was not, or if any write failed.  Destroying an
+    // open writer closes the file without marking it complete.
+    bool Close();
+
+private:
+    bool WritePadding(UINT64 byteCount);
+
+    FILE* m_File;
+    WaveCheckpoint::Header m_Header;
+    UINT m_Plane;
+    UINT m_Row;
+    bool m_Failed;
+};
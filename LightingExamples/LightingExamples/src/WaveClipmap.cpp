@@ -0,0 +1,360 @@
+//=======================================================================================
+// WaveClipmap.cpp
+//=======================================================================================
+
+#include "WaveClipmap.h"
+#include "MathHelper.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+    int RoundToEven(float v)
+    {
+        return 2 * static_cast<int>(std::floor(0.5f * v + 0.5f));
+    }
+}
+
+WaveClipmap::WaveClipmap()
+    : m_Size(0), m_SpatialStep(0.0f), m_TimeStep(0.0f)
+    , m_Ticks(0), m_LayoutRevision(0)
+{
+}
+
+void WaveClipmap::Init(UINT levelCount, UINT n, float dx, float dt, float speed, float damping)
+{
+    assert(levelCount > 0);
+    assert(n >= 9 && (n - 1) % 4 == 0);
+
+    m_Size = n;
+    m_SpatialStep = dx;
+    m_TimeStep = dt;
+    m_Clock.Reset();
+    m_Ticks = 0;
+
+    // Built in place: Waves owns its planes and must not be copied.
+    std::vector<LevelState>(levelCount).swap(m_Levels);
+
+    for (UINT level = 0; level < levelCount; ++level)
+    {
+        float scale = static_cast<float>(1u << level);
+        LevelState& state = m_Levels[level];
+        state.Grid.Init(n, n, dx * scale, dt * scale, speed, damping);
+        state.Ticks = 0;
+        state.Col0 = RoundToEven(-0.5f * (n - 1));
+        state.Row0 = RoundToEven(0.5f * (n - 1));
+    }
+
+    ++m_LayoutRevision;
+}
+
+XMFLOAT2 WaveClipmap::LevelCenter(UINT level) const
+{
+    const LevelState& state = m_Levels[level];
+    float dx = m_SpatialStep * (1u << level);
+    float half = 0.5f * (m_Size - 1);
+
+    return XMFLOAT2((state.Col0 + half) * dx, (state.Row0 - half) * dx);
+}
+
+void WaveClipmap::SetWorkerPool(WorkerPool* pool)
+{
+    for (LevelState& state : m_Levels)
+    {
+        state.Grid.SetWorkerPool(pool);
+    }
+}
+
+void WaveClipmap::SetCenter(float x, float z)
+{
+    // Coarse to fine, so uncovered points are filled from a level already in place.
+    bool moved = false;
+    for (UINT level = LevelCount(); level-- > 0;)
+    {
+        LevelState& state = m_Levels[level];
+        float dx = m_SpatialStep * (1u << level);
+
+        int col0 = RoundToEven(x / dx - 0.5f * (m_Size - 1));
+        int row0 = RoundToEven(z / dx + 0.5f * (m_Size - 1));
+        if (col0 == state.Col0 && row0 == state.Row0)
+        {
+            continue;
+        }
+
+        int rowOffset = state.Row0 - row0;
+        int colOffset = col0 - state.Col0;
+        state.Grid.Shift(rowOffset, colOffset);
+        state.Col0 = col0;
+        state.Row0 = row0;
+        moved = true;
+
+        if (level + 1 < LevelCount())
+        {
+            // The level around this one is ahead in time or level with it; fill
+            // with its solution at this level's time.
+            const LevelState& coarse = m_Levels[level + 1];
+            float coarseStep = static_cast<float>(1u << (level + 1));
+            float alpha = MathHelper::Clamp((state.Ticks - (coarse.Ticks - coarseStep)) / coarseStep, 0.0f, 1.0f);
+            float previousAlpha = MathHelper::Max(alpha - 0.5f, 0.0f);
+
+            int n = static_cast<int>(m_Size);
+            int rowBegin = rowOffset > 0 ? std::max(n - rowOffset, 0) : 0;
+            int rowEnd = rowOffset > 0 ? n : std::min(-rowOffset, n);
+            int colBegin = colOffset > 0 ? std::max(n - colOffset, 0) : 0;
+            int colEnd = colOffset > 0 ? n : std::min(-colOffset, n);
+
+            for (int i = 0; i < n; ++i)
+            {
+                bool rowUncovered = i >= rowBegin && i < rowEnd;
+                for (int j = 0; j < n; ++j)
+                {
+                    if (rowUncovered || (j >= colBegin && j < colEnd))
+                    {
+                        state.Grid.SetHeight(i, j, SampleCoarse(level, i, j, alpha),
+                            SampleCoarse(level, i, j, previousAlpha));
+                    }
+                }
+            }
+        }
+
+        state.Grid.RecomputeNormals();
+    }
+
+    if (moved)
+    {
+        ++m_LayoutRevision;
+    }
+}
+
+void WaveClipmap::Update(float dt)
+{
+    UINT stepCount = m_Clock.Advance(dt, m_TimeStep);
+    for (UINT step = 0; step < stepCount; ++step)
+    {
+        Tick();
+    }
+
+    if (stepCount > 0)
+    {
+        for (UINT level = 0; level + 1 < LevelCount(); ++level)
+        {
+            SyncBoundary(level);
+        }
+    }
+}
+
+void WaveClipmap::Tick()
+{
+    // A level is due when the finest level reaches the time of its solution; it
+    // then steps ahead to that time plus its own step.  Coarse levels go first so
+    // the finer ones can interpolate their boundary from them.
+    for (UINT level = LevelCount(); level-- > 0;)
+    {
+        LevelState& state = m_Levels[level];
+        if (state.Ticks != m_Ticks)
+        {
+            continue;
+        }
+
+        if (level + 1 < LevelCount())
+        {
+            FeedBoundary(level);
+        }
+
+        state.Grid.Step(1);
+        state.Ticks += 1u << level;
+    }
+
+    ++m_Ticks;
+
+    // Once every level inside the level around it has caught up, hand their
+    // solution outward, finest first.
+    for (UINT level = 0; level + 1 < LevelCount(); ++level)
+    {
+        if (m_Levels[level + 1].Ticks == m_Ticks)
+        {
+            Restrict(level);
+        }
+    }
+}
+
+void WaveClipmap::FeedBoundary(UINT level)
+{
+    // Step() reads the boundary from the current plane and then swaps the planes,
+    // so the current plane gets the coarse solution at this level's time and the
+    // previous plane its solution one step later, which is what the boundary
+    // shows (and the normal pass sees) after the step.
+    const LevelState& state = m_Levels[level];
+    const LevelState& coarse = m_Levels[level + 1];
+    float coarseStep = static_cast<float>(1u << (level + 1));
+    float alpha = (state.Ticks - (coarse.Ticks - coarseStep)) / coarseStep;
+
+    Waves& grid = m_Levels[level].Grid;
+    ForEachBoundaryPoint([&](UINT i, UINT j)
+    {
+        grid.SetHeight(i, j, SampleCoarse(level, i, j, alpha), SampleCoarse(level, i, j, alpha + 0.5f));
+    });
+}
+
+void WaveClipmap::SyncBoundary(UINT level)
+{
+    Waves& grid = m_Levels[level].Grid;
+    ForEachBoundaryPoint([&](UINT i, UINT j)
+    {
+        float h = SampleCoarse(level, i, j, 1.0f);
+        grid.SetHeight(i, j, h, h);
+    });
+}
+
+void WaveClipmap::Restrict(UINT level)
+{
+    // Coarse points two or more fine points inside the boundary are overwritten;
+    // their previous height is extrapolated from the fine level's velocity, since
+    // the coarse step spans two fine ones.
+    const Waves& fine = m_Levels[level].Grid;
+    Waves& coarse = m_Levels[level + 1].Grid;
+    int row2 = CoarseRow2(level);
+    int col2 = CoarseCol2(level);
+
+    for (UINT i = 2; i + 2 < m_Size; i += 2)
+    {
+        UINT coarseRow = static_cast<UINT>((row2 + static_cast<int>(i)) / 2);
+        for (UINT j = 2; j + 2 < m_Size; j += 2)
+        {
+            UINT coarseCol = static_cast<UINT>((col2 + static_cast<int>(j)) / 2);
+            float h = fine.Height(i, j);
+            coarse.SetHeight(coarseRow, coarseCol, h, 2.0f * fine.PreviousHeight(i, j) - h);
+        }
+    }
+}
+
+float WaveClipmap::SampleCoarse(UINT level, UINT i, UINT j, float alpha) const
+{
+    const Waves& coarse = m_Levels[level + 1].Grid;
+    int row2 = CoarseRow2(level) + static_cast<int>(i);
+    int col2 = CoarseCol2(level) + static_cast<int>(j);
+    assert(row2 >= 0 && col2 >= 0 && row2 <= 2 * static_cast<int>(m_Size - 1) && col2 <= 2 * static_cast<int>(m_Size - 1));
+
+    // Odd half-point coordinates fall between two coarse points.
+    UINT rows[2] = { static_cast<UINT>(row2 / 2), static_cast<UINT>((row2 + 1) / 2) };
+    UINT cols[2] = { static_cast<UINT>(col2 / 2), static_cast<UINT>((col2 + 1) / 2) };
+
+    float sum = 0.0f;
+    for (UINT r : rows)
+    {
+        for (UINT c : cols)
+        {
+            float previous = coarse.PreviousHeight(r, c);
+            sum += previous + alpha * (coarse.Height(r, c) - previous);
+        }
+    }
+
+    return 0.25f * sum;
+}
+
+int WaveClipmap::CoarseRow2(UINT level) const
+{
+    return 2 * m_Levels[level + 1].Row0 - m_Levels[level].Row0;
+}
+
+int WaveClipmap::CoarseCol2(UINT level) const
+{
+    return m_Levels[level].Col0 - 2 * m_Levels[level + 1].Col0;
+}
+
+template<typename Fn>
+void WaveClipmap::ForEachBoundaryPoint(const Fn& fn) const
+{
+    UINT last = m_Size - 1;
+    for (UINT j = 0; j <= last; ++j)
+    {
+        fn(0, j);
+        fn(last, j);
+    }
+
+    for (UINT i = 1; i < last; ++i)
+    {
+        fn(i, 0);
+        fn(i, last);
+    }
+}
+
+UINT WaveClipmap::LevelIndexCount(UINT level) const
+{
+    UINT cells = (m_Size - 1) * (m_Size - 1);
+    if (level > 0)
+    {
+        UINT hole = (m_Size - 1) / 2;
+        cells -= hole * hole;
+    }
+
+    return 6 * cells;
+}
+
+void WaveClipmap::GetLevelIndices(UINT level, std::vector<UINT>& indices) const
+{
+    UINT n = m_Size;
+
+    // Cells [holeRow, holeRow + hole) x [holeCol, holeCol + hole) are drawn by the
+    // finer level.
+    UINT hole = level > 0 ? (n - 1) / 2 : 0;
+    UINT holeRow = level > 0 ? static_cast<UINT>(CoarseRow2(level - 1) / 2) : 0;
+    UINT holeCol = level > 0 ? static_cast<UINT>(CoarseCol2(level - 1) / 2) : 0;
+
+    for (UINT i = 0; i < n - 1; ++i)
+    {
+        bool holeRowSpan = i >= holeRow && i < holeRow + hole;
+        for (UINT j = 0; j < n - 1; ++j)
+        {
+            if (holeRowSpan && j >= holeCol && j < holeCol + hole)
+            {
+                continue;
+            }
+
+            indices.push_back(i * n + j);
+            indices.push_back(i * n + j + 1);
+            indices.push_back((i + 1) * n + j);
+
+            indices.push_back((i + 1) * n + j);
+            indices.push_back(i * n + j + 1);
+            indices.push_back((i + 1) * n + j + 1);
+        }
+    }
+}
+
+void WaveClipmap::WriteVertices(UINT level, const Waves::VertexStream& stream) const
+{
+    const Waves& grid = m_Levels[level].Grid;
+    grid.WriteVertices(stream);
+
+    if (level + 1 == LevelCount())
+    {
+        return;
+    }
+
+    const Waves& coarse = m_Levels[level + 1].Grid;
+    int row2 = CoarseRow2(level);
+    int col2 = CoarseCol2(level);
+
+    ForEachBoundaryPoint([&](UINT i, UINT j)
+    {
+        int r2 = row2 + static_cast<int>(i);
+        int c2 = col2 + static_cast<int>(j);
+        UINT rows[2] = { static_cast<UINT>(r2 / 2), static_cast<UINT>((r2 + 1) / 2) };
+        UINT cols[2] = { static_cast<UINT>(c2 / 2), static_cast<UINT>((c2 + 1) / 2) };
+
+        XMVECTOR sum = XMVectorZero();
+        for (UINT r : rows)
+        {
+            for (UINT c : cols)
+            {
+                XMFLOAT3 normal = coarse.Normal(r * m_Size + c);
+                sum = XMVectorAdd(sum, XMLoadFloat3(&normal));
+            }
+        }
+
+        BYTE* v = static_cast<BYTE*>(stream.Data) + static_cast<size_t>(i * m_Size + j) * stream.Stride;
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(v + stream.NormalOffset), XMVector3Normalize(sum));
+    });
+}
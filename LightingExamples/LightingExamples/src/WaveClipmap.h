@@ -0,0 +1,127 @@
+//***************************************************************************************
+// WaveClipmap.h
+//
+// Nested wave grids around a moving centre.  Level 0 is the finest; every level
+// has the same number of points but twice the spacing and twice the time step of
+// the one inside it, so the Courant number, and with it stability, is the same on
+// all levels while each one covers four times the area.  A level therefore steps
+// half as often as the one inside it.
+//
+// Levels are stepped coarse to fine.  Before each step a fine level takes its
+// boundary ring from the level around it, interpolated in space and in time
+// between that level's previous and current solution.  Whenever a fine level
+// catches up with the level around it, its interior is copied down onto the
+// coarse points it covers, so what happens near the centre propagates outward.
+//
+// Each level is drawn as the ring of cells its finer neighbour does not cover.
+// The fine boundary is sampled from the coarse grid along the coarse cell edges,
+// so the seam between levels has no cracks.
+//***************************************************************************************
+
+#pragma once
+
+#include "Waves.h"
+#include "FixedStepClock.h"
+#include <vector>
+
+class WorkerPool;
+
+
+class WaveClipmap
+{
+public:
+    WaveClipmap();
+
+    // levelCount levels of n x n points; (n - 1) must be a multiple of 4 so a level
+    // can sit centred on the cells of the next.  dx, dt are the finest level's.
+    void Init(UINT levelCount, UINT n, float dx, float dt, float speed, float damping);
+
+    UINT LevelCount() const { return static_cast<UINT>(m_Levels.size()); }
+    Waves& Level(UINT level) { return m_Levels[level].Grid; }
+    const Waves& Level(UINT level) const { return m_Levels[level].Grid; }
+
+    // Centre of the level's grid in the clipmap's xz plane.  Waves positions are
+    // relative to it.
+    XMFLOAT2 LevelCenter(UINT level) const;
+
+    // Passed on to every level.
+    void SetWorkerPool(WorkerPool* pool);
+
+    // Re-centres every level as close to (x, z) as it can get while staying on the
+    // points of the level around it.  Levels move by whole points, so the water they
+    // already hold scrolls rather than resets; newly uncovered points are filled
+    // from the level around them.
+    void SetCenter(float x, float z);
+
+    // Bumped whenever a level moves relative to another, i.e. when the index ranges
+    // from GetLevelIndices change.
+    UINT LayoutRevision() const { return m_LayoutRevision; }
+
+    // Advances the finest level by every fixed step dt now owes (up to the same
+    // substep budget as Waves) and the coarser ones with it.
+    void Update(float dt);
+
+    // Appends the triangles of level's visible cells to indices, as vertex indices
+    // into that level's grid: all of level 0, and for the others the ring outside
+    // the next finer level.  LevelIndexCount() does not change with the layout.
+    void GetLevelIndices(UINT level, std::vector<UINT>& indices) const;
+    UINT LevelIndexCount(UINT level) const;
+
+    // Writes level's vertices, as Waves::WriteVertices does, except that the
+    // boundary ring takes the normals of the level around it so the lighting is
+    // continuous across the seam (Waves keeps boundary normals pointing straight up).
+    void WriteVertices(UINT level, const Waves::VertexStream& stream) const;
+
+private:
+    struct LevelState
+    {
+        Waves Grid;
+
+        // World point index of column 0 along x and of row 0 along z, in units of
+        // this level's spacing: point (i, j) lies at ((Col0 + j)*dx, (Row0 - i)*dx).
+        // Both are even so every other point lies on the level around it.
+        int Col0;
+        int Row0;
+
+        // Time of the current solution, in finest-level steps.
+        UINT Ticks;
+    };
+
+    // Advances the finest level by one step, and every level due a step with it.
+    void Tick();
+
+    // Sets level's boundary ring from the level around it, for the next step:
+    // see the comment in the definition.
+    void FeedBoundary(UINT level);
+
+    // Sets level's boundary ring to the current solution of the level around it.
+    void SyncBoundary(UINT level);
+
+    // Copies level's interior onto the points of the level around it.
+    void Restrict(UINT level);
+
+    // Height of the level around level at level's point (i, j), blended between
+    // that level's previous (alpha 0) and current (alpha 1) solution.
+    float SampleCoarse(UINT level, UINT i, UINT j, float alpha) const;
+
+    // Position of level's point (0, 0) on the grid of the level around it, in half
+    // points of that grid.
+    int CoarseRow2(UINT level) const;
+    int CoarseCol2(UINT level) const;
+
+    // Calls fn(i, j) for every point on the outer ring of a level's grid; all levels
+    // share one grid size.
+    template<typename Fn>
+    void ForEachBoundaryPoint(const Fn& fn) const;
+
+private:
+    std::vector<LevelState> m_Levels;
+    UINT m_Size;
+    float m_SpatialStep;
+    float m_TimeStep;
+
+    // Counts finest-level steps.
+    FixedStepClock m_Clock;
+    UINT m_Ticks;
+    UINT m_LayoutRevision;
+};
@@ -0,0 +1,97 @@
+//=======================================================================================
+// WaveHeightDecoder.cpp
+//=======================================================================================
+
+#include "WaveHeightDecoder.h"
+
+
+void WaveHeightDecoder::Decode(const WaveSnapshot& frame, const Waves::VertexStream& stream)
+{
+    Decode(frame, stream, 0, frame.RowCount);
+}
+
+void WaveHeightDecoder::Decode(const WaveSnapshot& frame, const Waves::VertexStream& stream,
+    UINT rowBegin, UINT rowEnd)
+{
+    UINT n = frame.ColumnCount;
+    float halfWidth = 0.5f * (n - 1) * frame.SpatialStep;
+    float halfDepth = 0.5f * (frame.RowCount - 1) * frame.SpatialStep;
+
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        const float* h = &frame.Heights[i * n];
+        float z = halfDepth - i * frame.SpatialStep;
+
+        BYTE* v = static_cast<BYTE*>(stream.Data) + static_cast<size_t>(i) * n * stream.Stride;
+        for (UINT j = 0; j < n; ++j, v += stream.Stride)
+        {
+            float* position = reinterpret_cast<float*>(v + stream.PositionOffset);
+            position[0] = -halfWidth + j * frame.SpatialStep;
+            position[1] = h[j];
+            position[2] = z;
+
+            XMFLOAT3 normal = Normal(frame, i, j);
+            float* out = reinterpret_cast<float*>(v + stream.NormalOffset);
+            out[0] = normal.x;
+            out[1] = normal.y;
+            out[2] = normal.z;
+        }
+    }
+}
+
+void WaveHeightDecoder::WriteVertices(const WaveSnapshot& frame, const Waves::VertexStream& stream)
+{
+    WriteVertices(frame, stream, 0, frame.RowCount);
+}
+
+void WaveHeightDecoder::WriteVertices(const WaveSnapshot& frame, const Waves::VertexStream& stream,
+    UINT rowBegin, UINT rowEnd)
+{
+    if (!frame.HasNormals())
+    {
+        Decode(frame, stream, rowBegin, rowEnd);
+        return;
+    }
+
+    UINT n = frame.ColumnCount;
+    float halfWidth = 0.5f * (n - 1) * frame.SpatialStep;
+    float halfDepth = 0.5f * (frame.RowCount - 1) * frame.SpatialStep;
+
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        const float* h = &frame.Heights[i * n];
+        const XMFLOAT3* normals = &frame.Normals[i * n];
+        float z = halfDepth - i * frame.SpatialStep;
+
+        BYTE* v = static_cast<BYTE*>(stream.Data) + static_cast<size_t>(i) * n * stream.Stride;
+        for (UINT j = 0; j < n; ++j, v += stream.Stride)
+        {
+            float* position = reinterpret_cast<float*>(v + stream.PositionOffset);
+            position[0] = -halfWidth + j * frame.SpatialStep;
+            position[1] = h[j];
+            position[2] = z;
+
+            *reinterpret_cast<XMFLOAT3*>(v + stream.NormalOffset) = normals[j];
+        }
+    }
+}
+
+XMFLOAT3 WaveHeightDecoder::Normal(const WaveSnapshot& frame, UINT i, UINT j)
+{
+    // The boundary is fixed at zero height and never gets a computed normal.
+    if (i == 0 || j == 0 || i + 1 >= frame.RowCount || j + 1 >= frame.ColumnCount)
+    {
+        return XMFLOAT3(0.0f, 1.0f, 0.0f);
+    }
+
+    UINT n = frame.ColumnCount;
+    float l = frame.Heights[i * n + j - 1];
+    float r = frame.Heights[i * n + j + 1];
+    float t = frame.Heights[(i - 1) * n + j];
+    float b = frame.Heights[(i + 1) * n + j];
+
+    XMFLOAT3 normal(-r + l, 2.0f * frame.SpatialStep, b - t);
+    XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+
+    return normal;
+}
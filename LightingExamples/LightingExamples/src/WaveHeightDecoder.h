@@ -0,0 +1,32 @@
+//***************************************************************************************
+// WaveHeightDecoder.h
+//
+// CPU reference decoder for height-only wave frames (Waves::SnapshotFormat::HeightsOnly).
+// Positions come from the grid coordinates and the stored height; normals are
+// rebuilt from central differences of the heights exactly as the solver's scalar
+// kernel computes them, with the fixed boundary keeping the up vector.
+//***************************************************************************************
+
+#pragma once
+
+#include "Waves.h"
+#include "WaveSnapshot.h"
+
+
+class WaveHeightDecoder
+{
+public:
+    // Writes the position and normal of every vertex of frame, or only those of rows
+    // [rowBegin, rowEnd), into stream.  Vertex k goes to offset k*Stride, as with
+    // Waves::WriteVertices.  Any normals the frame carries are ignored.
+    static void Decode(const WaveSnapshot& frame, const Waves::VertexStream& stream);
+    static void Decode(const WaveSnapshot& frame, const Waves::VertexStream& stream, UINT rowBegin, UINT rowEnd);
+
+    // As Decode, but copies the frame's own normals when it carries them, so either
+    // snapshot format can be uploaded through a VertexStream.
+    static void WriteVertices(const WaveSnapshot& frame, const Waves::VertexStream& stream);
+    static void WriteVertices(const WaveSnapshot& frame, const Waves::VertexStream& stream, UINT rowBegin, UINT rowEnd);
+
+    // Returns the unit normal at grid point (i, j) of frame.
+    static XMFLOAT3 Normal(const WaveSnapshot& frame, UINT i, UINT j);
+};
@@ -1,9 +1,27 @@
 #include "WaveModel.h"
+#include "WaveHeightDecoder.h"
+#include "HillTerrain.h"
+#include "MeshOptimizer.h"
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    // Points per side of every clipmap level; (n - 1) must be a multiple of 4.
+    const UINT WavesClipmapSize = 161;
+}
 
 WaveModel::WaveModel()
     : m_GridVertexBuffer(nullptr), m_GridIndexBuffer(nullptr)
     , m_GridWorld(XMMatrixIdentity()), m_WavesWorld(XMMatrixTranslation(0.0f, -3.0f, 0.0f))
     , m_WavesVertexBuffer(nullptr), m_WavesIndexBuffer(nullptr)
+    , m_WavesClipmapLevels(1), m_WavesUploadedLayoutRevision(0)
+    , m_WavesUploadedRevision(0), m_WavesSimulationThread(false), m_SimulationRunning(false)
+    , m_WavesFrame(nullptr)
+    , m_WavesStreamFormat(Waves::SnapshotFormat::HeightsAndNormals)
+    , m_WavesIncrementalUpload(false), m_WavesUploadedBytes(0)
 {
     m_GridMaterial.Ambient = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
     m_GridMaterial.Diffuse = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
@@ -16,14 +34,26 @@ WaveModel::WaveModel()
 
 WaveModel::~WaveModel()
 {
+    StopSimulationThread();
+
     ReleaseCOM(m_GridVertexBuffer);
     ReleaseCOM(m_GridIndexBuffer);
 }
 
 bool WaveModel::InitializeBuffers(ID3D11Device* device)
 {
-    m_Waves.Init(160, 160, 1.0f, 0.03f, 3.25f, 0.4f);
+    m_WavesUploadedBytes = 0;
     BuildLandGeometryBuffers(device);
+
+    if (UsesWavesClipmap())
+    {
+        m_WavesClipmap.Init(m_WavesClipmapLevels, WavesClipmapSize, 1.0f, 0.03f, 3.25f, 0.4f);
+        BuildWavesClipmapBuffers(device);
+        return true;
+    }
+
+    m_Waves.Init(160, 160, 1.0f, 0.03f, 3.25f, 0.4f);
+    m_Waves.SetActiveTileTracking(m_WavesIncrementalUpload);
     BuildWavesGeometryBuffers(device);
 
     return true;
@@ -63,28 +93,21 @@ void WaveModel::RenderWavesBuffers(ID3D11DeviceContext* deviceContext)
 
 void WaveModel::BuildLandGeometryBuffers(ID3D11Device* device)
 {
-    GeometryGenerator::MeshData grid;
+    GeometryGenerator::MeshSize grid = GeometryGenerator::GridSize(50, 50);
 
-    GeometryGenerator geoGen;
-    geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+    m_GridVertexCount = static_cast<int>(grid.VertexCount);
+    m_GridIndexCount = static_cast<int>(grid.IndexCount);
 
-    m_GridVertexCount = static_cast<int>(grid.Vertices.size());
-    m_GridIndexCount = static_cast<int>(grid.Indices.size());
+    // Raise the grid onto the hills, writing positions and normals straight into the
+    // interleaved vertex layout.
 
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
+    std::vector<VertexType> vertices(grid.VertexCount);
+    std::vector<UINT> indices(grid.IndexCount);
 
-    std::vector<VertexType> vertices(grid.Vertices.size());
-    for (size_t i = 0; i < grid.Vertices.size(); ++i)
-    {
-        XMFLOAT3 p = grid.Vertices[i].Position;
+    HillTerrain().BuildGrid(160.0f, 160.0f, 50, 50, &vertices[0].Position, &vertices[0].Normal,
+        sizeof(VertexType), &indices[0]);
 
-        p.y = GetHillHeight(p.x, p.z);
-
-        vertices[i].Position = p;
-        vertices[i].Normal = GetHillNormal(p.x, p.z);
-    }
+    MeshOptimizer::Optimize(&vertices[0], grid.VertexCount, &indices[0], grid.IndexCount);
 
     // Set up the description of the static vertex buffer.
     D3D11_BUFFER_DESC vertexBufferDesc;
@@ -114,28 +137,55 @@ void WaveModel::BuildLandGeometryBuffers(ID3D11Device* device)
 
     // Give the subresource structure a pointer to the index data.
     D3D11_SUBRESOURCE_DATA indexData;
-    indexData.pSysMem = &grid.Indices[0];
+    indexData.pSysMem = &indices[0];
     indexData.SysMemPitch = 0;
     indexData.SysMemSlicePitch = 0;
 
     HR(device->CreateBuffer(&indexBufferDesc, &indexData, &m_GridIndexBuffer));
 }
 
+void WaveModel::SampleWavesSurface(Waves::SurfaceQuery query) const
+{
+    XMStoreFloat3(&query.Origin, m_WavesWorld.r[3]);
+
+    if (UsesWavesClipmap())
+    {
+        XMFLOAT2 center = m_WavesClipmap.LevelCenter(0);
+        query.Origin.x += center.x;
+        query.Origin.z += center.y;
+        m_WavesClipmap.Level(0).SampleSurface(query);
+        return;
+    }
+
+    if (!m_SimulationRunning.load(std::memory_order_relaxed))
+    {
+        m_Waves.SampleSurface(query);
+        return;
+    }
+
+    if (m_WavesFrame)
+    {
+        Waves::SampleSurface(*m_WavesFrame, query);
+        return;
+    }
+
+    std::fill(query.Heights, query.Heights + query.Count, query.Origin.y);
+    if (query.NormalX)
+    {
+        std::fill(query.NormalX, query.NormalX + query.Count, 0.0f);
+        std::fill(query.NormalY, query.NormalY + query.Count, 1.0f);
+        std::fill(query.NormalZ, query.NormalZ + query.Count, 0.0f);
+    }
+}
+
 float WaveModel::GetHillHeight(float x, float z) const
 {
-    return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
+    return HillTerrain::Height(x, z);
 }
 
 XMFLOAT3 WaveModel::GetHillNormal(float x, float z) const
 {
-    // n = (-df/dx, 1, -df/dz)
-    XMFLOAT3 n(-0.03f * z * cosf(0.1f*x) - 0.3f * cosf(0.1f * z), 1.0f
-        , -0.3f * sinf(0.1f * x) + 0.03f * x * sinf(0.1f * z));
-
-    XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-    XMStoreFloat3(&n, unitNormal);
-
-    return n;
+    return HillTerrain::Normal(x, z);
 }
 
 void WaveModel::BuildWavesGeometryBuffers(ID3D11Device* device)
@@ -152,7 +202,28 @@ void WaveModel::BuildWavesGeometryBuffers(ID3D11Device* device)
     vertexBufferDesc.MiscFlags = 0;
     vertexBufferDesc.StructureByteStride = 0;
 
-    HR(device->CreateBuffer(&vertexBufferDesc, 0, &m_WavesVertexBuffer));
+    if (m_WavesIncrementalUpload)
+    {
+        // Updated with UpdateSubresource, which needs default usage.  The buffer
+        // starts out as the initial solution and is patched from then on.
+        m_WavesVertices.resize(m_Waves.VertexCount());
+        m_Waves.WriteVertices(GetWavesVertexStream(&m_WavesVertices[0]));
+        m_WavesUploadedRevision = m_Waves.Revision();
+
+        vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        vertexBufferDesc.CPUAccessFlags = 0;
+
+        D3D11_SUBRESOURCE_DATA vertexData;
+        vertexData.pSysMem = &m_WavesVertices[0];
+        vertexData.SysMemPitch = 0;
+        vertexData.SysMemSlicePitch = 0;
+
+        HR(device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_WavesVertexBuffer));
+    }
+    else
+    {
+        HR(device->CreateBuffer(&vertexBufferDesc, 0, &m_WavesVertexBuffer));
+    }
 
     // Create the index buffer.  The index buffer is fixed, so we only 
     // need to create and set once.
@@ -180,6 +251,9 @@ void WaveModel::BuildWavesGeometryBuffers(ID3D11Device* device)
         }
     }
 
+    // The simulation writes the vertices in grid order, so only the triangles move.
+    MeshOptimizer::OptimizeVertexCache(&indices[0], static_cast<UINT>(indices.size()), m_Waves.VertexCount());
+
     // Set up the description of the static index buffer.
     D3D11_BUFFER_DESC indexBufferDesc;
     indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -198,17 +272,408 @@ void WaveModel::BuildWavesGeometryBuffers(ID3D11Device* device)
     HR(device->CreateBuffer(&indexBufferDesc, &indexData, &m_WavesIndexBuffer));
 }
 
-void WaveModel::WaveVertexBufferUpdate(ID3D11DeviceContext* deviceContext)
+void WaveModel::BuildWavesClipmapBuffers(ID3D11Device* device)
+{
+    UINT levelCount = m_WavesClipmap.LevelCount();
+    m_WaveVertexCount = static_cast<int>(levelCount * m_WavesClipmap.Level(0).VertexCount());
+
+    m_WavesLevelIndexOffsets.resize(levelCount);
+    UINT indexCount = 0;
+    for (UINT level = 0; level < levelCount; ++level)
+    {
+        m_WavesLevelIndexOffsets[level] = indexCount;
+        indexCount += m_WavesClipmap.LevelIndexCount(level);
+    }
+    m_WavesIndexCount = static_cast<int>(indexCount);
+
+    // Both buffers are rewritten from the CPU: the vertices after every step, the
+    // indices whenever a level moves relative to another.
+    D3D11_BUFFER_DESC vertexBufferDesc;
+    vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_WaveVertexCount;
+    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    vertexBufferDesc.MiscFlags = 0;
+    vertexBufferDesc.StructureByteStride = 0;
+
+    HR(device->CreateBuffer(&vertexBufferDesc, 0, &m_WavesVertexBuffer));
+
+    D3D11_BUFFER_DESC indexBufferDesc;
+    indexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    indexBufferDesc.ByteWidth = sizeof(UINT) * indexCount;
+    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    indexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    indexBufferDesc.MiscFlags = 0;
+    indexBufferDesc.StructureByteStride = 0;
+
+    HR(device->CreateBuffer(&indexBufferDesc, 0, &m_WavesIndexBuffer));
+
+    // Forces the first WaveVertexBufferUpdate to fill both.
+    m_WavesUploadedRevision = m_WavesClipmap.Level(0).Revision() - 1;
+    m_WavesUploadedLayoutRevision = m_WavesClipmap.LayoutRevision() - 1;
+}
+
+void WaveModel::UploadWavesClipmap(ID3D11DeviceContext* deviceContext)
+{
+    UINT levelCount = m_WavesClipmap.LevelCount();
+    UINT levelVertexCount = m_WavesClipmap.Level(0).VertexCount();
+    D3D11_MAPPED_SUBRESOURCE mappedData;
+
+    if (m_WavesClipmap.LayoutRevision() != m_WavesUploadedLayoutRevision)
+    {
+        m_WavesUploadedLayoutRevision = m_WavesClipmap.LayoutRevision();
+
+        m_WavesClipmapIndices.clear();
+        for (UINT level = 0; level < levelCount; ++level)
+        {
+            m_WavesClipmap.GetLevelIndices(level, m_WavesClipmapIndices);
+        }
+
+        HR(deviceContext->Map(m_WavesIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+        memcpy(mappedData.pData, &m_WavesClipmapIndices[0], sizeof(UINT) * m_WavesClipmapIndices.size());
+        deviceContext->Unmap(m_WavesIndexBuffer, 0);
+    }
+
+    HR(deviceContext->Map(m_WavesVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+    VertexType* v = reinterpret_cast<VertexType*>(mappedData.pData);
+    for (UINT level = 0; level < levelCount; ++level)
+    {
+        m_WavesClipmap.WriteVertices(level, GetWavesVertexStream(v + level * levelVertexCount));
+    }
+
+    deviceContext->Unmap(m_WavesVertexBuffer, 0);
+    m_WavesUploadedBytes += sizeof(VertexType) * m_WaveVertexCount;
+}
+
+void WaveModel::SetWavesCenter(float x, float z)
+{
+    if (UsesWavesClipmap())
+    {
+        m_WavesClipmap.SetCenter(x, z);
+    }
+}
+
+UINT WaveModel::GetWavesLevelCount() const
+{
+    return UsesWavesClipmap() ? m_WavesClipmap.LevelCount() : 1;
+}
+
+XMMATRIX WaveModel::GetWavesLevelWorld(UINT level) const
+{
+    if (!UsesWavesClipmap())
+    {
+        return m_WavesWorld;
+    }
+
+    // Level vertices are relative to the level's centre.
+    XMFLOAT2 center = m_WavesClipmap.LevelCenter(level);
+    return XMMatrixTranslation(center.x, 0.0f, center.y) * m_WavesWorld;
+}
+
+int WaveModel::GetWavesLevelIndexCount(UINT level) const
+{
+    return UsesWavesClipmap() ? static_cast<int>(m_WavesClipmap.LevelIndexCount(level)) : m_WavesIndexCount;
+}
+
+UINT WaveModel::GetWavesLevelIndexOffset(UINT level) const
+{
+    return UsesWavesClipmap() ? m_WavesLevelIndexOffsets[level] : 0;
+}
+
+int WaveModel::GetWavesLevelVertexOffset(UINT level) const
+{
+    return UsesWavesClipmap() ? static_cast<int>(level * m_WavesClipmap.Level(0).VertexCount()) : 0;
+}
+
+void WaveModel::WaveDisturb(UINT i, UINT j, float mag)
+{
+    Waves::Disturbance disturbance = { i, j, mag };
+
+    if (UsesWavesClipmap())
+    {
+        m_WavesClipmap.Level(0).QueueDisturbances(&disturbance, 1);
+        return;
+    }
+
+    if (m_SimulationRunning.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(m_PendingDisturbancesMutex);
+        m_PendingDisturbances.push_back(disturbance);
+        return;
+    }
+
+    m_Waves.QueueDisturbances(&disturbance, 1);
+}
+
+void WaveModel::WaveUpdate(float dt, ID3D11DeviceContext* deviceContext)
 {
+    if (UsesWavesClipmap())
+    {
+        // Uploaded by WaveVertexBufferUpdate, which also sees any re-centring.
+        m_WavesClipmap.Update(dt);
+        return;
+    }
+
+    if (m_SimulationRunning.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    // WRITE_DISCARD leaves the buffer undefined, so only map when the step will
+    // rewrite every vertex.
+    if (m_Waves.StepsDue(dt) == 0)
+    {
+        m_Waves.Update(dt);
+        return;
+    }
+
+    if (m_WavesIncrementalUpload)
+    {
+        m_Waves.Update(dt);
+
+        m_Waves.GetDirtyRowRanges(m_WavesDirtyRows);
+        for (const Waves::RowRange& rows : m_WavesDirtyRows)
+        {
+            m_Waves.WriteVertices(GetWavesVertexStream(&m_WavesVertices[0]), rows.Begin, rows.End);
+            UploadWavesRows(deviceContext, rows.Begin, rows.End);
+        }
+
+        m_WavesUploadedRevision = m_Waves.Revision();
+        return;
+    }
+
     D3D11_MAPPED_SUBRESOURCE mappedData;
     HR(deviceContext->Map(m_WavesVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
 
-    WaveModel::VertexType* v = reinterpret_cast<VertexType*>(mappedData.pData);
-    for (UINT i = 0; i < m_Waves.VertexCount(); ++i)
+    Waves::VertexStream stream = GetWavesVertexStream(mappedData.pData);
+    m_Waves.Update(dt, &stream);
+
+    deviceContext->Unmap(m_WavesVertexBuffer, 0);
+    m_WavesUploadedBytes += sizeof(VertexType) * m_Waves.VertexCount();
+    m_WavesUploadedRevision = m_Waves.Revision();
+}
+
+Waves::VertexStream WaveModel::GetWavesVertexStream(void* data) const
+{
+    Waves::VertexStream stream;
+    stream.Data = data;
+    stream.Stride = sizeof(VertexType);
+    stream.PositionOffset = offsetof(VertexType, Position);
+    stream.NormalOffset = offsetof(VertexType, Normal);
+
+    return stream;
+}
+
+void WaveModel::UploadWavesRows(ID3D11DeviceContext* deviceContext, UINT rowBegin, UINT rowEnd)
+{
+    // For buffers the box is a byte range along x.
+    UINT n = m_Waves.ColumnCount();
+
+    D3D11_BOX box;
+    box.left = rowBegin * n * sizeof(VertexType);
+    box.right = rowEnd * n * sizeof(VertexType);
+    box.top = 0;
+    box.bottom = 1;
+    box.front = 0;
+    box.back = 1;
+
+    deviceContext->UpdateSubresource(m_WavesVertexBuffer, 0, &box, &m_WavesVertices[rowBegin * n], 0, 0);
+    m_WavesUploadedBytes += box.right - box.left;
+}
+
+void WaveModel::UploadWavesSnapshotRows(ID3D11DeviceContext* deviceContext, const WaveSnapshot& frame,
+    UINT uploadedRevision)
+{
+    Waves::VertexStream stream = GetWavesVertexStream(&m_WavesVertices[0]);
+
+    if (frame.RowRevisions.size() != frame.RowCount)
+    {
+        WaveHeightDecoder::WriteVertices(frame, stream);
+        UploadWavesRows(deviceContext, 0, frame.RowCount);
+        return;
+    }
+
+    UINT i = 0;
+    while (i < frame.RowCount)
+    {
+        if (frame.RowRevisions[i] <= uploadedRevision)
+        {
+            ++i;
+            continue;
+        }
+
+        UINT rowEnd = i + 1;
+        while (rowEnd < frame.RowCount && frame.RowRevisions[rowEnd] > uploadedRevision)
+        {
+            ++rowEnd;
+        }
+
+        // Decoded normals read the heights of the rows either side.
+        UINT begin = i > 0 ? i - 1 : 0;
+        UINT end = std::min(rowEnd + 1, frame.RowCount);
+
+        WaveHeightDecoder::WriteVertices(frame, stream, begin, end);
+        UploadWavesRows(deviceContext, begin, end);
+
+        i = rowEnd;
+    }
+}
+
+void WaveModel::StartSimulationThread()
+{
+    if (!m_WavesSimulationThread || m_SimulationRunning.load(std::memory_order_relaxed) || UsesWavesClipmap())
+    {
+        return;
+    }
+
+    // Publish the current state first so the renderer has a frame right away.
+    m_Waves.CaptureSnapshot(m_WavesSnapshots.BeginWrite(), m_WavesStreamFormat);
+    m_WavesSnapshots.Publish();
+
+    m_SimulationRunning.store(true, std::memory_order_release);
+    m_SimulationThread = std::thread(&WaveModel::SimulationThreadMain, this);
+}
+
+void WaveModel::StopSimulationThread()
+{
+    if (!m_SimulationRunning.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    m_SimulationRunning.store(false, std::memory_order_release);
+    m_SimulationThread.join();
+    m_WavesFrame = nullptr;
+
+    // Hand anything that arrived late to the now caller-owned simulation.
+    if (!m_PendingDisturbances.empty())
+    {
+        m_Waves.QueueDisturbances(m_PendingDisturbances.data(), static_cast<UINT>(m_PendingDisturbances.size()));
+        m_PendingDisturbances.clear();
+    }
+}
+
+void WaveModel::SimulationThreadMain()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<Waves::Disturbance> disturbances;
+    std::vector<Waves::RowRange> dirtyRows;
+    std::vector<UINT> rowRevisions(m_Waves.RowCount(), m_Waves.Revision());
+    Clock::duration timeStep = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<float>(m_Waves.TimeStep()));
+    Clock::time_point lastTime = Clock::now();
+
+    while (m_SimulationRunning.load(std::memory_order_acquire))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_PendingDisturbancesMutex);
+            disturbances.swap(m_PendingDisturbances);
+        }
+
+        if (!disturbances.empty())
+        {
+            m_Waves.QueueDisturbances(disturbances.data(), static_cast<UINT>(disturbances.size()));
+            disturbances.clear();
+        }
+
+        Clock::time_point now = Clock::now();
+        float dt = std::chrono::duration<float>(now - lastTime).count();
+        lastTime = now;
+
+        UINT revision = m_Waves.Revision();
+        m_Waves.Update(dt);
+
+        if (m_Waves.Revision() != revision)
+        {
+            WaveSnapshot& snapshot = m_WavesSnapshots.BeginWrite();
+            m_Waves.CaptureSnapshot(snapshot, m_WavesStreamFormat);
+
+            if (m_WavesIncrementalUpload)
+            {
+                m_Waves.GetDirtyRowRanges(dirtyRows);
+                for (const Waves::RowRange& rows : dirtyRows)
+                {
+                    std::fill(rowRevisions.begin() + rows.Begin, rowRevisions.begin() + rows.End, m_Waves.Revision());
+                }
+
+                snapshot.RowRevisions = rowRevisions;
+            }
+
+            m_WavesSnapshots.Publish();
+        }
+
+        // Wake roughly once per fixed step; Update catches up on any oversleep.
+        std::this_thread::sleep_until(now + timeStep);
+    }
+}
+
+void WaveModel::WaveVertexBufferUpdate(ID3D11DeviceContext* deviceContext)
+{
+    if (UsesWavesClipmap())
+    {
+        // Level 0 steps whenever any level does; a move of any level bumps the layout.
+        if (m_WavesClipmap.Level(0).Revision() != m_WavesUploadedRevision ||
+            m_WavesClipmap.LayoutRevision() != m_WavesUploadedLayoutRevision)
+        {
+            m_WavesUploadedRevision = m_WavesClipmap.Level(0).Revision();
+            UploadWavesClipmap(deviceContext);
+        }
+        return;
+    }
+
+    if (m_SimulationRunning.load(std::memory_order_relaxed))
+    {
+        const WaveSnapshot* snapshot = m_WavesSnapshots.AcquireLatest();
+        m_WavesFrame = snapshot;
+        if (!snapshot || snapshot->Revision == m_WavesUploadedRevision)
+        {
+            return;
+        }
+
+        UINT uploadedRevision = m_WavesUploadedRevision;
+        m_WavesUploadedRevision = snapshot->Revision;
+
+        if (m_WavesIncrementalUpload)
+        {
+            UploadWavesSnapshotRows(deviceContext, *snapshot, uploadedRevision);
+            return;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mappedData;
+        HR(deviceContext->Map(m_WavesVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+        WaveHeightDecoder::WriteVertices(*snapshot, GetWavesVertexStream(mappedData.pData));
+
+        deviceContext->Unmap(m_WavesVertexBuffer, 0);
+        m_WavesUploadedBytes += sizeof(VertexType) * m_Waves.VertexCount();
+        return;
+    }
+
+    // Nothing moved since the last upload (no step this frame, or only calm tiles).
+    if (m_Waves.Revision() == m_WavesUploadedRevision)
+    {
+        return;
+    }
+
+    m_WavesUploadedRevision = m_Waves.Revision();
+
+    // WaveUpdate uploads whatever it steps, so the revision only moves on without it
+    // when the simulation thread has stopped ahead of the last snapshot uploaded.
+    // Which rows changed since then is not known, so rewrite it all.
+    if (m_WavesIncrementalUpload)
     {
-        v[i].Position = m_Waves[i];
-        v[i].Normal = m_Waves.Normal(i);
+        m_Waves.WriteVertices(GetWavesVertexStream(&m_WavesVertices[0]));
+        UploadWavesRows(deviceContext, 0, m_Waves.RowCount());
+        return;
     }
 
+    D3D11_MAPPED_SUBRESOURCE mappedData;
+    HR(deviceContext->Map(m_WavesVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+    m_Waves.WriteVertices(GetWavesVertexStream(mappedData.pData));
+
     deviceContext->Unmap(m_WavesVertexBuffer, 0);
+    m_WavesUploadedBytes += sizeof(VertexType) * m_Waves.VertexCount();
 }
@@ -1,8 +1,14 @@
 #pragma once
 
+#include "D3DUtil.h"
 #include "GeometryGenerator.h"
 #include "Waves.h"
+#include "WaveClipmap.h"
+#include "WaveSnapshot.h"
 #include "LightHelper.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 
 class WaveModel
@@ -34,12 +40,68 @@ public:
     void SetGridMaterial(Material gridMaterial) { m_GridMaterial = gridMaterial; }
     void SetWavesMaterial(Material wavesMaterial) { m_WavesMaterial = wavesMaterial; }
 
-    void WaveDisturb(UINT i, UINT j, float mag) { m_Waves.Disturb(i, j, mag); }
-    void WaveUpdate(float dt) { m_Waves.Update(dt); }
+    void WaveDisturb(UINT i, UINT j, float mag);
+    // Steps the simulation; if it moves, the step writes the new vertices straight
+    // into the mapped wave vertex buffer.
+    void WaveUpdate(float dt, ID3D11DeviceContext* deviceContext);
     void WaveVertexBufferUpdate(ID3D11DeviceContext* deviceContext);
 
-    UINT GetWavesRowCount() const { return m_Waves.RowCount(); }
-    UINT GetWavesColumnCount() const { return m_Waves.ColumnCount(); }
+    // Off by default, in which case WaveUpdate steps the waves on the render thread
+    // straight into the mapped vertex buffer and StartSimulationThread does nothing.
+    void SetWavesSimulationThread(bool enable) { m_WavesSimulationThread = enable; }
+
+    // Runs the wave simulation on its own thread on its own clock.  WaveUpdate then
+    // does nothing, WaveDisturb hands events to the thread, and WaveVertexBufferUpdate
+    // uploads the latest snapshot the thread has published.
+    void StartSimulationThread();
+    void StopSimulationThread();
+
+    // Call before StartSimulationThread.  HeightsOnly publishes one float per vertex
+    // and the render thread rebuilds positions and normals with WaveHeightDecoder,
+    // cutting the per-frame hand-off from 16 to 4 bytes per vertex.
+    void SetWavesStreamFormat(Waves::SnapshotFormat format) { m_WavesStreamFormat = format; }
+
+    // Call before InitializeBuffers.  Keeps the wave vertex buffer in default memory
+    // and, after each step, uploads only the rows Waves reports dirty with
+    // UpdateSubresource instead of rewriting the whole buffer.  Turns on active tile
+    // tracking, without which every row is dirty.  With the simulation thread, each
+    // snapshot carries the revision every row last changed in, so the rows changed
+    // in frames the renderer skipped are uploaded too.
+    void SetWavesIncrementalUpload(bool enable) { m_WavesIncrementalUpload = enable; }
+
+    // Call before InitializeBuffers.  levelCount > 1 replaces the single grid with a
+    // WaveClipmap of that many nested levels, each twice as coarse and covering four
+    // times the area of the one inside it, kept around the eye by SetWavesCenter.
+    // The clipmap steps on the render thread: StartSimulationThread, the stream
+    // format and incremental upload do not apply to it.
+    void SetWavesClipmapLevels(UINT levelCount) { m_WavesClipmapLevels = levelCount; }
+
+    // Re-centres the clipmap on (x, z), in the waves' local xz plane.  Does nothing
+    // for the single grid.
+    void SetWavesCenter(float x, float z);
+
+    // The waves are drawn in GetWavesLevelCount() parts (one for the single grid),
+    // each with its own world matrix and index range; vertex offsets go to
+    // DrawIndexed as BaseVertexLocation.
+    UINT GetWavesLevelCount() const;
+    XMMATRIX GetWavesLevelWorld(UINT level) const;
+    int GetWavesLevelIndexCount(UINT level) const;
+    UINT GetWavesLevelIndexOffset(UINT level) const;
+    int GetWavesLevelVertexOffset(UINT level) const;
+
+    // Bytes written to the wave vertex buffer since InitializeBuffers.
+    UINT64 GetWavesUploadedBytes() const { return m_WavesUploadedBytes; }
+
+    // Of the finest clipmap level in clipmap mode; WaveDisturb indexes the same grid.
+    UINT GetWavesRowCount() const { return GetDisturbedWaves().RowCount(); }
+    UINT GetWavesColumnCount() const { return GetDisturbedWaves().ColumnCount(); }
+
+    // Samples the water at query's world-space points; query.Origin is overwritten
+    // with the waves' translation (the waves world matrix is a pure translation).
+    // While the simulation thread runs this reads the frame WaveVertexBufferUpdate
+    // last uploaded, so call it after that on the render thread; before the first
+    // frame the surface is flat.  In clipmap mode it samples the finest level.
+    void SampleWavesSurface(Waves::SurfaceQuery query) const;
 
     float GetHillHeight(float x, float z) const;
     XMFLOAT3 GetHillNormal(float x, float z) const;
@@ -54,6 +116,35 @@ private:
 
     Waves m_Waves;
 
+    // Clipmap mode: m_WavesClipmap replaces m_Waves.  Level l's vertices start at
+    // vertex l times the level vertex count and its indices at m_WavesLevelIndexOffsets[l]; the index
+    // buffer is rewritten whenever the layout revision changes.
+    UINT m_WavesClipmapLevels;
+    WaveClipmap m_WavesClipmap;
+    std::vector<UINT> m_WavesLevelIndexOffsets;
+    std::vector<UINT> m_WavesClipmapIndices;
+    UINT m_WavesUploadedLayoutRevision;
+
+    // Waves::Revision() last copied into m_WavesVertexBuffer.
+    UINT m_WavesUploadedRevision;
+
+    // While m_SimulationRunning, m_Waves belongs to m_SimulationThread.
+    bool m_WavesSimulationThread;
+    std::thread m_SimulationThread;
+    std::atomic<bool> m_SimulationRunning;
+    WaveSnapshotBuffer m_WavesSnapshots;
+    const WaveSnapshot* m_WavesFrame;
+    std::mutex m_PendingDisturbancesMutex;
+    std::vector<Waves::Disturbance> m_PendingDisturbances;
+
+    // Incremental upload: CPU copy of the vertex buffer that dirty rows are
+    // refreshed in and uploaded from.
+    Waves::SnapshotFormat m_WavesStreamFormat;
+    bool m_WavesIncrementalUpload;
+    std::vector<VertexType> m_WavesVertices;
+    std::vector<Waves::RowRange> m_WavesDirtyRows;
+    UINT64 m_WavesUploadedBytes;
+
     XMMATRIX m_GridWorld;
     XMMATRIX m_WavesWorld;
 
@@ -62,5 +153,13 @@ private:
 
     void BuildLandGeometryBuffers(ID3D11Device* device);
     void BuildWavesGeometryBuffers(ID3D11Device* device);
+    void BuildWavesClipmapBuffers(ID3D11Device* device);
+    void UploadWavesClipmap(ID3D11DeviceContext* deviceContext);
+    bool UsesWavesClipmap() const { return m_WavesClipmapLevels > 1; }
+    const Waves& GetDisturbedWaves() const { return UsesWavesClipmap() ? m_WavesClipmap.Level(0) : m_Waves; }
+    void SimulationThreadMain();
+    Waves::VertexStream GetWavesVertexStream(void* data) const;
+    void UploadWavesRows(ID3D11DeviceContext* deviceContext, UINT rowBegin, UINT rowEnd);
+    void UploadWavesSnapshotRows(ID3D11DeviceContext* deviceContext, const WaveSnapshot& frame, UINT uploadedRevision);
 };
 
@@ -0,0 +1,31 @@
+//=======================================================================================
+// WaveSnapshot.cpp
+//=======================================================================================
+
+#include "WaveSnapshot.h"
+
+
+WaveSnapshotBuffer::WaveSnapshotBuffer()
+    : m_Latest(1), m_WriteIndex(0), m_ReadIndex(2), m_ReaderHasSnapshot(false)
+{
+}
+
+void WaveSnapshotBuffer::Publish()
+{
+    // Release makes the slot's contents visible to the reader that picks it up; the
+    // slot we get back is either the stale latest or one the reader has let go of.
+    UINT previous = m_Latest.exchange(m_WriteIndex | FreshBit, std::memory_order_acq_rel);
+    m_WriteIndex = previous & IndexMask;
+}
+
+const WaveSnapshot* WaveSnapshotBuffer::AcquireLatest()
+{
+    if (m_Latest.load(std::memory_order_relaxed) & FreshBit)
+    {
+        UINT previous = m_Latest.exchange(m_ReadIndex, std::memory_order_acq_rel);
+        m_ReadIndex = previous & IndexMask;
+        m_ReaderHasSnapshot = true;
+    }
+
+    return m_ReaderHasSnapshot ? &m_Slots[m_ReadIndex] : nullptr;
+}
@@ -0,0 +1,88 @@
+//***************************************************************************************
+// WaveSnapshot.h
+//
+// A completed Waves frame, and a triple buffer that hands such frames from the
+// simulation thread to the render thread.  The writer always owns one slot, the
+// reader one, and the third holds the latest published frame; publishing and
+// acquiring swap slot indices with a single atomic exchange, so neither side ever
+// waits on the other and the reader never sees a half-written frame.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <atomic>
+#include <vector>
+using namespace DirectX;
+
+
+struct WaveSnapshot
+{
+    WaveSnapshot() : RowCount(0), ColumnCount(0), SpatialStep(0.0f), Revision(0), SimulatedTime(0.0) {}
+
+    UINT RowCount;
+    UINT ColumnCount;
+    float SpatialStep;
+
+    // Waves::Revision() and Waves::SimulatedTime() when the frame was captured.
+    UINT Revision;
+    double SimulatedTime;
+
+    // RowCount * ColumnCount entries, row-major without padding.  Normals is empty
+    // in a Waves::SnapshotFormat::HeightsOnly frame.
+    std::vector<float> Heights;
+    std::vector<XMFLOAT3> Normals;
+
+    // Optional, RowCount entries: the Revision in which each row last changed.  A
+    // reader that last uploaded revision r refreshes the rows whose entry is above r,
+    // however many published frames it skipped in between.
+    std::vector<UINT> RowRevisions;
+
+    bool HasNormals() const { return !Normals.empty(); }
+
+    // Returns the solution at the ith grid point, as Waves::operator[] did.
+    XMFLOAT3 Position(UINT i) const
+    {
+        UINT row = i / ColumnCount;
+        UINT col = i % ColumnCount;
+
+        return XMFLOAT3(-0.5f * (ColumnCount - 1) * SpatialStep + col * SpatialStep, Heights[i],
+            0.5f * (RowCount - 1) * SpatialStep - row * SpatialStep);
+    }
+};
+
+
+class WaveSnapshotBuffer
+{
+public:
+    WaveSnapshotBuffer();
+
+    WaveSnapshotBuffer(const WaveSnapshotBuffer&) = delete;
+    WaveSnapshotBuffer& operator=(const WaveSnapshotBuffer&) = delete;
+
+    // Writer side, one thread only: fill the slot BeginWrite() returns, then Publish()
+    // it.  The slot's vectors keep their capacity, so steady-state publishing does
+    // not allocate.
+    WaveSnapshot& BeginWrite() { return m_Slots[m_WriteIndex]; }
+    void Publish();
+
+    // Reader side, one thread only: returns the newest published snapshot, or nullptr
+    // if nothing has been published yet.  The snapshot stays valid and unchanged
+    // until the next AcquireLatest() call.
+    const WaveSnapshot* AcquireLatest();
+
+private:
+    static const UINT IndexMask = 0x3;
+    static const UINT FreshBit = 0x4;
+
+    WaveSnapshot m_Slots[3];
+
+    // Slot index of the latest frame, plus FreshBit if the reader has not taken it.
+    alignas(64) std::atomic<UINT> m_Latest;
+
+    // Each index is touched by its own side only.
+    alignas(64) UINT m_WriteIndex;
+    alignas(64) UINT m_ReadIndex;
+    bool m_ReaderHasSnapshot;
+};
@@ -3,172 +3,965 @@
 //=======================================================================================
 
 #include "Waves.h"
+#include "WorkerPool.h"
+#include "AlignedPlanes.h"
+#include "WaveSnapshot.h"
+#include "WaveCheckpoint.h"
+#include "MathHelper.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <cmath>
+
+namespace
+{
+    const UINT FloatsPerLine = AlignedPlanes::Alignment / sizeof(float);
+
+    // Default number of steps advanced per temporally blocked sweep.
+    const UINT DefaultStepsPerBlock = 8;
+
+    // Previous and current heights, normal x, y, z and tangent x, y.
+    const UINT PlaneCount = 7;
+}
 
 Waves::Waves()
     : m_NumRows(0), m_NumCols(0), m_VertexCount(0), m_TriangleCount(0)
     , m_K1(0.0f), m_K2(0.0f), m_K3(0.0f), m_TimeStep(0.0f), m_SpatialStep(0.0f)
-    , m_PrevSolution(0), m_CurrSolution(0), m_Normals(0), m_TangentX(0)
+    , m_HalfWidth(0.0f), m_HalfDepth(0.0f), m_RowPitch(0), m_Storage(0), m_Checkpoint(nullptr)
+    , m_PrevHeights(0), m_CurrHeights(0), m_NormalX(0), m_NormalY(0), m_NormalZ(0)
+    , m_TangentXX(0), m_TangentXY(0)
+    , m_Kernels(WavesKernels::Select(WavesKernels::Isa::AVX512)), m_WorkerPool(nullptr)
+    , m_StepsPerBlock(DefaultStepsPerBlock)
+    , m_TotalStepCount(0)
+    , m_TrackActiveTiles(false), m_ActivityEpsilon(0.0f), m_TileRowCount(0), m_TileColCount(0)
+    , m_Revision(0), m_FusedKernel(false), m_VertexStream(nullptr)
 {
 }
 
 Waves::~Waves()
 {
-	delete[] m_PrevSolution;
-	delete[] m_CurrSolution;
-    delete[] m_Normals;
-    delete[] m_TangentX;
+    ReleasePlanes();
 }
 
 UINT Waves::RowCount()const
 {
-	return m_NumRows;
+    return m_NumRows;
 }
 
 UINT Waves::ColumnCount()const
 {
-	return m_NumCols;
+    return m_NumCols;
 }
 
 UINT Waves::VertexCount()const
 {
-	return m_VertexCount;
+    return m_VertexCount;
 }
 
 UINT Waves::TriangleCount()const
 {
-	return m_TriangleCount;
+    return m_TriangleCount;
+}
+
+XMFLOAT3 Waves::operator[](int i) const
+{
+    UINT row = i / m_NumCols;
+    UINT col = i % m_NumCols;
+
+    return XMFLOAT3(GridX(col), m_CurrHeights[row * m_RowPitch + col], GridZ(row));
+}
+
+XMFLOAT3 Waves::Normal(int i) const
+{
+    UINT k = (i / m_NumCols) * m_RowPitch + i % m_NumCols;
+
+    return XMFLOAT3(m_NormalX[k], m_NormalY[k], m_NormalZ[k]);
+}
+
+XMFLOAT3 Waves::TangentX(int i) const
+{
+    UINT k = (i / m_NumCols) * m_RowPitch + i % m_NumCols;
+
+    return XMFLOAT3(m_TangentXX[k], m_TangentXY[k], 0.0f);
+}
+
+void Waves::SampleSurface(const SurfaceQuery& query) const
+{
+    assert(m_NumRows >= 2 && m_NumCols >= 2);
+
+    WavesKernels::HeightField field;
+    field.Heights = m_CurrHeights;
+    field.RowCount = m_NumRows;
+    field.ColumnCount = m_NumCols;
+    field.Pitch = m_RowPitch;
+    field.X0 = query.Origin.x - m_HalfWidth;
+    field.Z0 = query.Origin.z + m_HalfDepth;
+    field.Y0 = query.Origin.y;
+    field.InvDx = 1.0f / m_SpatialStep;
+    field.TwoDx = 2.0f * m_SpatialStep;
+
+    m_Kernels.Sample(field, query.X, query.Z, query.Count,
+        query.Heights, query.NormalX, query.NormalY, query.NormalZ);
+}
+
+void Waves::SampleSurface(const WaveSnapshot& frame, const SurfaceQuery& query)
+{
+    assert(frame.RowCount >= 2 && frame.ColumnCount >= 2);
+
+    // Initialized once, thread-safely, on first use.
+    static const WavesKernels kernels = WavesKernels::Select(WavesKernels::DetectIsa());
+
+    WavesKernels::HeightField field;
+    field.Heights = frame.Heights.data();
+    field.RowCount = frame.RowCount;
+    field.ColumnCount = frame.ColumnCount;
+    field.Pitch = frame.ColumnCount;
+    field.X0 = query.Origin.x - 0.5f * (frame.ColumnCount - 1) * frame.SpatialStep;
+    field.Z0 = query.Origin.z + 0.5f * (frame.RowCount - 1) * frame.SpatialStep;
+    field.Y0 = query.Origin.y;
+    field.InvDx = 1.0f / frame.SpatialStep;
+    field.TwoDx = 2.0f * frame.SpatialStep;
+
+    kernels.Sample(field, query.X, query.Z, query.Count,
+        query.Heights, query.NormalX, query.NormalY, query.NormalZ);
+}
+
+void Waves::CaptureSnapshot(WaveSnapshot& snapshot, SnapshotFormat format) const
+{
+    snapshot.RowCount = m_NumRows;
+    snapshot.ColumnCount = m_NumCols;
+    snapshot.SpatialStep = m_SpatialStep;
+    snapshot.Revision = m_Revision;
+    snapshot.SimulatedTime = SimulatedTime();
+
+    bool withNormals = format == SnapshotFormat::HeightsAndNormals;
+    snapshot.Heights.resize(m_VertexCount);
+    snapshot.Normals.resize(withNormals ? m_VertexCount : 0);
+
+    for (UINT i = 0; i < m_NumRows; ++i)
+    {
+        const float* h = m_CurrHeights + i * m_RowPitch;
+        std::copy(h, h + m_NumCols, snapshot.Heights.begin() + i * m_NumCols);
+
+        if (!withNormals)
+        {
+            continue;
+        }
+
+        XMFLOAT3* n = &snapshot.Normals[i * m_NumCols];
+        for (UINT j = 0; j < m_NumCols; ++j)
+        {
+            UINT k = i * m_RowPitch + j;
+            n[j] = XMFLOAT3(m_NormalX[k], m_NormalY[k], m_NormalZ[k]);
+        }
+    }
+}
+
+bool Waves::SaveCheckpoint(const char* path) const
+{
+    WaveCheckpoint::Header header = {};
+    header.RowCount = m_NumRows;
+    header.ColumnCount = m_NumCols;
+    header.RowPitch = m_RowPitch;
+    header.PlaneCount = PlaneCount;
+    header.SpatialStep = m_SpatialStep;
+    header.TimeStep = m_TimeStep;
+    header.K1 = m_K1;
+    header.K2 = m_K2;
+    header.K3 = m_K3;
+    header.Accumulator = m_Clock.Accumulator();
+    header.TotalStepCount = m_TotalStepCount;
+
+    WaveCheckpointWriter writer;
+    if (!writer.Open(path, header))
+    {
+        return false;
+    }
+
+    const float* planes[PlaneCount] =
+    {
+        m_PrevHeights, m_CurrHeights, m_NormalX, m_NormalY, m_NormalZ, m_TangentXX, m_TangentXY
+    };
+
+    for (const float* plane : planes)
+    {
+        if (!writer.WriteRows(plane, m_NumRows))
+        {
+            return false;
+        }
+    }
+
+    return writer.Close();
+}
+
+bool Waves::LoadCheckpoint(const char* path)
+{
+    std::unique_ptr<WaveCheckpoint> checkpoint(new WaveCheckpoint());
+    if (!checkpoint->Open(path))
+    {
+        return false;
+    }
+
+    // The planes are used in place, so their rows must be laid out as Init would.
+    const WaveCheckpoint::Header& header = checkpoint->GetHeader();
+    UINT m = header.RowCount;
+    UINT n = header.ColumnCount;
+    if (m < 2 || n < 2 || header.PlaneCount != PlaneCount ||
+        header.RowPitch != (n + FloatsPerLine - 1) / FloatsPerLine * FloatsPerLine)
+    {
+        return false;
+    }
+
+    // The comparisons are false for NaN, so a NaN step is rejected too.
+    if (!(header.TimeStep > 0.0f) || !(header.SpatialStep > 0.0f) ||
+        !std::isfinite(header.TimeStep) || !std::isfinite(header.SpatialStep) ||
+        !std::isfinite(header.K1) || !std::isfinite(header.K2) || !std::isfinite(header.K3) ||
+        !(header.Accumulator >= 0.0f && header.Accumulator < header.TimeStep))
+    {
+        return false;
+    }
+
+    ReleasePlanes();
+
+    m_NumRows = m;
+    m_NumCols = n;
+    m_VertexCount = m * n;
+    m_TriangleCount = (m - 1) * (n - 1) * 2;
+
+    m_TimeStep = header.TimeStep;
+    m_SpatialStep = header.SpatialStep;
+    m_K1 = header.K1;
+    m_K2 = header.K2;
+    m_K3 = header.K3;
+
+    m_Clock.Reset(header.Accumulator);
+    m_TotalStepCount = header.TotalStepCount;
+
+    m_HalfWidth = (n - 1) * m_SpatialStep * 0.5f;
+    m_HalfDepth = (m - 1) * m_SpatialStep * 0.5f;
+
+    m_RowPitch = header.RowPitch;
+
+    // Each plane starts on its own page in the file, so they need not be contiguous.
+    m_Checkpoint = checkpoint.release();
+    m_PrevHeights = m_Checkpoint->Plane(0);
+    m_CurrHeights = m_Checkpoint->Plane(1);
+    m_NormalX = m_Checkpoint->Plane(2);
+    m_NormalY = m_Checkpoint->Plane(3);
+    m_NormalZ = m_Checkpoint->Plane(4);
+    m_TangentXX = m_Checkpoint->Plane(5);
+    m_TangentXY = m_Checkpoint->Plane(6);
+
+    m_TileRowCount = (m + TileSize - 1) / TileSize;
+    m_TileColCount = (n + TileSize - 1) / TileSize;
+    m_ActiveTiles.assign(m_TileRowCount * m_TileColCount, 1);
+    m_StepTiles.assign(m_TileRowCount * m_TileColCount, 0);
+    m_DirtyTiles.assign(m_TileRowCount * m_TileColCount, 1);
+
+    m_DisturbQueue.clear();
+
+    ++m_Revision;
+    return true;
 }
 
 void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 {
-	m_NumRows  = m;
-	m_NumCols  = n;
-
-	m_VertexCount   = m * n;
-	m_TriangleCount = (m - 1) * (n - 1) * 2;
-
-	m_TimeStep    = dt;
-	m_SpatialStep = dx;
-
-	float d = damping * dt + 2.0f;
-	float e = (speed * speed) * (dt * dt)/(dx * dx);
-	m_K1     = (damping * dt - 2.0f)/ d;
-	m_K2     = (4.0f - 8.0f * e) / d;
-	m_K3     = (2.0f * e) / d;
-
-	// In case Init() called again.
-	delete[] m_PrevSolution;
-	delete[] m_CurrSolution;
-    delete[] m_Normals;
-    delete[] m_TangentX;
-
-	m_PrevSolution = new XMFLOAT3[m * n];
-	m_CurrSolution = new XMFLOAT3[m * n];
-    m_Normals = new XMFLOAT3[m * n];
-    m_TangentX = new XMFLOAT3[m * n];
-
-	// Generate grid vertices in system memory.
-
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
-	for (UINT i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i * dx;
-		for(UINT j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j * dx;
-
-			m_PrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			m_CurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-            m_Normals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            m_TangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		}
-	}
-}
-
-void Waves::Update(float dt)
-{
-	static float t = 0;
-
-	// Accumulate time.
-	t += dt;
-
-	// Only update the simulation at the specified time step.
-	if( t >= m_TimeStep )
-	{
-		// Only update interior points; we use zero boundary conditions.
-		for(DWORD i = 1; i < m_NumRows-1; ++i)
-		{
-			for(DWORD j = 1; j < m_NumCols-1; ++j)
-			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				m_PrevSolution[i * m_NumCols + j].y =
-					m_K1 * m_PrevSolution[i * m_NumCols + j].y +
-					m_K2 * m_CurrSolution[i * m_NumCols + j].y +
-					m_K3 * (m_CurrSolution[(i + 1) * m_NumCols + j].y +
-					     m_CurrSolution[(i - 1) * m_NumCols + j].y +
-					     m_CurrSolution[i * m_NumCols + j + 1].y +
-						 m_CurrSolution[i * m_NumCols + j - 1].y);
-			}
-		}
-
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(m_PrevSolution, m_CurrSolution);
-
-		t = 0.0f; // reset time
-
-        //
-        // Compute normals using finite difference scheme.
-        //
-        for (UINT i = 1; i < m_NumRows - 1; ++i)
-        {
-            for (UINT j = 1; j < m_NumCols - 1; ++j)
+    m_NumRows  = m;
+    m_NumCols  = n;
+
+    m_VertexCount   = m * n;
+    m_TriangleCount = (m - 1) * (n - 1) * 2;
+
+    m_TimeStep    = dt;
+    m_SpatialStep = dx;
+
+    m_Clock.Reset();
+    m_TotalStepCount = 0;
+
+    float d = damping * dt + 2.0f;
+    float e = (speed * speed) * (dt * dt)/(dx * dx);
+    m_K1     = (damping * dt - 2.0f)/ d;
+    m_K2     = (4.0f - 8.0f * e) / d;
+    m_K3     = (2.0f * e) / d;
+
+    m_HalfWidth = (n - 1) * dx * 0.5f;
+    m_HalfDepth = (m - 1) * dx * 0.5f;
+
+    // In case Init() called again.
+    ReleasePlanes();
+
+    // Two height planes, three normal planes and two tangent planes.
+    m_RowPitch = (n + FloatsPerLine - 1) / FloatsPerLine * FloatsPerLine;
+    size_t planeSize = static_cast<size_t>(m_RowPitch) * m;
+
+    m_Storage = static_cast<float*>(AlignedPlanes::Alloc(PlaneCount * planeSize * sizeof(float)));
+    m_PrevHeights = m_Storage;
+    m_CurrHeights = m_Storage + planeSize;
+    m_NormalX = m_Storage + 2 * planeSize;
+    m_NormalY = m_Storage + 3 * planeSize;
+    m_NormalZ = m_Storage + 4 * planeSize;
+    m_TangentXX = m_Storage + 5 * planeSize;
+    m_TangentXY = m_Storage + 6 * planeSize;
+
+    // Start from flat water; the row padding is zeroed too so it never holds garbage.
+    std::fill(m_PrevHeights, m_PrevHeights + planeSize, 0.0f);
+    std::fill(m_CurrHeights, m_CurrHeights + planeSize, 0.0f);
+    std::fill(m_NormalX, m_NormalX + planeSize, 0.0f);
+    std::fill(m_NormalY, m_NormalY + planeSize, 1.0f);
+    std::fill(m_NormalZ, m_NormalZ + planeSize, 0.0f);
+    std::fill(m_TangentXX, m_TangentXX + planeSize, 1.0f);
+    std::fill(m_TangentXY, m_TangentXY + planeSize, 0.0f);
+
+    // Flat water has no active tiles.
+    m_TileRowCount = (m + TileSize - 1) / TileSize;
+    m_TileColCount = (n + TileSize - 1) / TileSize;
+    m_ActiveTiles.assign(m_TileRowCount * m_TileColCount, 0);
+    m_StepTiles.assign(m_TileRowCount * m_TileColCount, 0);
+    m_DirtyTiles.assign(m_TileRowCount * m_TileColCount, 0);
+
+    // Events queued before a re-Init belong to the old grid.  The stencils go too,
+    // so that repeated re-Inits do not keep growing the list.
+    m_DisturbQueue.clear();
+    m_DisturbKernels.clear();
+
+    ++m_Revision;
+}
+
+void Waves::SetActiveTileTracking(bool enable, float epsilon)
+{
+    m_TrackActiveTiles = enable;
+    m_ActivityEpsilon = epsilon;
+
+    // Start with everything active so motion already on the grid is not frozen;
+    // quiet tiles drop out after the first step.
+    std::fill(m_ActiveTiles.begin(), m_ActiveTiles.end(), static_cast<unsigned char>(1));
+}
+
+bool Waves::IsTileActive(UINT tileRow, UINT tileCol) const
+{
+    return !m_TrackActiveTiles || m_ActiveTiles[tileRow * m_TileColCount + tileCol] != 0;
+}
+
+UINT Waves::ActiveTileCount() const
+{
+    if (!m_TrackActiveTiles)
+    {
+        return m_TileRowCount * m_TileColCount;
+    }
+
+    return static_cast<UINT>(std::count(m_ActiveTiles.begin(), m_ActiveTiles.end(), 1));
+}
+
+bool Waves::IsTileDirty(UINT tileRow, UINT tileCol) const
+{
+    return m_DirtyTiles[tileRow * m_TileColCount + tileCol] != 0;
+}
+
+UINT Waves::StepsDue(float dt) const
+{
+    return m_Clock.StepsDue(dt, m_TimeStep);
+}
+
+void Waves::GetDirtyRowRanges(std::vector<RowRange>& ranges) const
+{
+    ranges.clear();
+
+    for (UINT ty = 0; ty < m_TileRowCount; ++ty)
+    {
+        const unsigned char* tiles = &m_DirtyTiles[ty * m_TileColCount];
+        if (std::find(tiles, tiles + m_TileColCount, 1) == tiles + m_TileColCount)
+        {
+            continue;
+        }
+
+        UINT rowBegin = ty * TileSize;
+        UINT rowEnd = std::min(rowBegin + TileSize, m_NumRows);
+
+        if (!ranges.empty() && ranges.back().End == rowBegin)
+        {
+            ranges.back().End = rowEnd;
+        }
+        else
+        {
+            RowRange range = { rowBegin, rowEnd };
+            ranges.push_back(range);
+        }
+    }
+}
+
+void Waves::Update(float dt, const VertexStream* stream)
+{
+    // Only update the simulation at the specified time step.
+    Step(m_Clock.Advance(dt, m_TimeStep), stream);
+}
+
+void Waves::Step(UINT stepCount, const VertexStream* stream)
+{
+    if (stepCount == 0)
+    {
+        return;
+    }
+
+    m_VertexStream = stream;
+
+    m_TotalStepCount += stepCount;
+
+    ApplyQueuedDisturbances();
+
+    std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), static_cast<unsigned char>(0));
+
+    while (stepCount > 0)
+    {
+        UINT blockSteps = 1;
+        if (stepCount > 1 && m_StepsPerBlock > 1 && !m_WorkerPool)
+        {
+            blockSteps = std::min(stepCount, m_StepsPerBlock);
+        }
+
+        // Normals are only needed after the final step, so only that sweep is fused.
+        bool fuse = m_FusedKernel && blockSteps == stepCount;
+
+        BeginTileSteps(blockSteps);
+
+        if (blockSteps > 1)
+        {
+            StepHeightsBlocked(blockSteps, fuse);
+        }
+        else if (fuse)
+        {
+            ForEachRowBand([this](UINT rowBegin, UINT rowEnd) { StepHeightsFused(rowBegin, rowEnd); });
+            std::swap(m_PrevHeights, m_CurrHeights);
+
+            // The first and last row of each band need a row from the neighbouring
+            // band, which is only final once every band has finished.
+            ForEachRowBand([this](UINT rowBegin, UINT rowEnd)
             {
-                float l = m_CurrSolution[i * m_NumCols + j - 1].y;
-                float r = m_CurrSolution[i * m_NumCols + j + 1].y;
-                float t = m_CurrSolution[(i - 1) * m_NumCols + j].y;
-                float b = m_CurrSolution[(i + 1) * m_NumCols + j].y;
-                m_Normals[i * m_NumCols + j].x = -r + l;
-                m_Normals[i * m_NumCols + j].y = 2.0f * m_SpatialStep;
-                m_Normals[i * m_NumCols + j].z = b - t;
-
-                XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&m_Normals[i * m_NumCols + j]));
-                XMStoreFloat3(&m_Normals[i * m_NumCols + j], n);
-
-                m_TangentX[i * m_NumCols + j] = XMFLOAT3(2.0f * m_SpatialStep, r - l, 0.0f);
-                XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&m_TangentX[i * m_NumCols + j]));
-                XMStoreFloat3(&m_TangentX[i * m_NumCols + j], T);
+                ComputeNormals(m_CurrHeights, rowBegin, rowBegin + 1);
+                if (rowEnd - 1 > rowBegin)
+                {
+                    ComputeNormals(m_CurrHeights, rowEnd - 1, rowEnd);
+                }
+            });
+        }
+        else
+        {
+            // Only update interior points; we use zero boundary conditions.
+            ForEachRowBand([this](UINT rowBegin, UINT rowEnd) { StepHeights(rowBegin, rowEnd); });
+
+            // We just overwrote the previous buffer with the new data, so
+            // this data needs to become the current solution and the old
+            // current solution becomes the new previous solution.
+            std::swap(m_PrevHeights, m_CurrHeights);
+        }
+
+        EndTileSteps();
+        stepCount -= blockSteps;
+    }
+
+    //
+    // Compute normals using finite difference scheme.
+    //
+    if (!m_FusedKernel)
+    {
+        ForEachRowBand([this](UINT rowBegin, UINT rowEnd) { ComputeNormals(m_CurrHeights, rowBegin, rowEnd); });
+    }
+
+    // The normal pass wrote the interior rows; the fixed boundary rows are left.
+    if (stream)
+    {
+        WriteVertexRow(*stream, m_CurrHeights, 0);
+        WriteVertexRow(*stream, m_CurrHeights, m_NumRows - 1);
+        m_VertexStream = nullptr;
+    }
+
+    if (std::find(m_DirtyTiles.begin(), m_DirtyTiles.end(), 1) != m_DirtyTiles.end())
+    {
+        ++m_Revision;
+    }
+}
+
+void Waves::StepHeights(UINT rowBegin, UINT rowEnd)
+{
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        // After this update we will be discarding the old previous
+        // buffer, so overwrite that buffer with the new update.
+        // Note how we can do this inplace (read/write to same element)
+        // because we won't need prev_ij again and the assignment happens last.
+
+        // Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+        // Moreover, our +z axis goes "down"; this is just to
+        // keep consistent with our row indices going down.
+
+        ForEachColumnRun(m_StepTiles, i, [&](UINT colBegin, UINT colEnd)
+        {
+            UINT k = i * m_RowPitch + colBegin;
+            m_Kernels.StepRow(m_PrevHeights + k, m_CurrHeights + k,
+                m_CurrHeights + k - m_RowPitch, m_CurrHeights + k + m_RowPitch,
+                colEnd - colBegin, m_K1, m_K2, m_K3);
+        });
+    }
+}
+
+void Waves::StepHeightsFused(UINT rowBegin, UINT rowEnd)
+{
+    // New heights go into the previous buffer.  Once row i is written, rows i-2..i
+    // are final, so the normals of row i-1 can be computed while those rows are
+    // still in cache.  Rows whose neighbours live in another band are left for
+    // the caller.
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        StepHeights(i, i + 1);
+
+        if (i > rowBegin + 1)
+        {
+            ComputeNormals(m_PrevHeights, i - 1, i);
+        }
+    }
+}
+
+void Waves::StepHeightsBlocked(UINT stepCount, bool fused)
+{
+    // Sub-step s writes into the buffer sub-step s-2 wrote, so row i of sub-step s
+    // may only run once sub-step s-1 has finished rows i-1, i and i+1 (the last
+    // readers of the value it overwrites).  Walking a cursor down the grid and
+    // running sub-step s on row cursor-s, in increasing s, satisfies that with a
+    // one row lag per sub-step.
+    UINT firstRow = 1;
+    UINT lastRow = m_NumRows - 1;
+
+    for (UINT cursor = firstRow; cursor + 1 < lastRow + stepCount; ++cursor)
+    {
+        for (UINT s = 0; s < stepCount && cursor >= firstRow + s; ++s)
+        {
+            UINT row = cursor - s;
+            if (row >= lastRow)
+            {
+                continue;
+            }
+
+            // Even sub-steps write the previous buffer, odd ones the current buffer.
+            float* dst = (s % 2 == 0) ? m_PrevHeights : m_CurrHeights;
+            const float* src = (s % 2 == 0) ? m_CurrHeights : m_PrevHeights;
+
+            ForEachColumnRun(m_StepTiles, row, [&](UINT colBegin, UINT colEnd)
+            {
+                UINT k = row * m_RowPitch + colBegin;
+                m_Kernels.StepRow(dst + k, src + k, src + k - m_RowPitch, src + k + m_RowPitch,
+                    colEnd - colBegin, m_K1, m_K2, m_K3);
+            });
+
+            // The last sub-step's rows are final, so trail it with the normal pass.
+            if (fused && s == stepCount - 1 && row > firstRow)
+            {
+                ComputeNormals(dst, row - 1, row);
+            }
+        }
+    }
+
+    if (fused)
+    {
+        const float* final = (stepCount % 2 == 1) ? m_PrevHeights : m_CurrHeights;
+        ComputeNormals(final, lastRow - 1, lastRow);
+    }
+
+    // The last sub-step wrote the previous buffer when stepCount is odd.
+    if (stepCount % 2 == 1)
+    {
+        std::swap(m_PrevHeights, m_CurrHeights);
+    }
+}
+
+void Waves::ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd)
+{
+    ComputeNormals(heights, rowBegin, rowEnd, m_FusedKernel ? m_Kernels.NormalRowFast : m_Kernels.NormalRow);
+}
+
+void Waves::ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd, WavesKernels::NormalRowFn normalRow)
+{
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        ForEachColumnRun(m_DirtyTiles, i, [&](UINT colBegin, UINT colEnd)
+        {
+            UINT k = i * m_RowPitch + colBegin;
+            normalRow(heights + k, heights + k - m_RowPitch,
+                heights + k + m_RowPitch, colEnd - colBegin, 2.0f * m_SpatialStep,
+                m_NormalX + k, m_NormalY + k, m_NormalZ + k, m_TangentXX + k, m_TangentXY + k);
+        });
+
+        if (m_VertexStream)
+        {
+            WriteVertexRow(*m_VertexStream, heights, i);
+        }
+    }
+}
+
+void Waves::WriteVertexRow(const VertexStream& stream, const float* heights, UINT i) const
+{
+    const float* h = heights + i * m_RowPitch;
+    const float* nx = m_NormalX + i * m_RowPitch;
+    const float* ny = m_NormalY + i * m_RowPitch;
+    const float* nz = m_NormalZ + i * m_RowPitch;
+    float z = GridZ(i);
+
+    // Written strictly in order and never read back, which suits write-combined
+    // memory such as a mapped dynamic buffer.
+    BYTE* v = static_cast<BYTE*>(stream.Data) + static_cast<size_t>(i) * m_NumCols * stream.Stride;
+    for (UINT j = 0; j < m_NumCols; ++j, v += stream.Stride)
+    {
+        float* position = reinterpret_cast<float*>(v + stream.PositionOffset);
+        position[0] = GridX(j);
+        position[1] = h[j];
+        position[2] = z;
+
+        float* normal = reinterpret_cast<float*>(v + stream.NormalOffset);
+        normal[0] = nx[j];
+        normal[1] = ny[j];
+        normal[2] = nz[j];
+    }
+}
+
+void Waves::WriteVertices(const VertexStream& stream) const
+{
+    WriteVertices(stream, 0, m_NumRows);
+}
+
+void Waves::WriteVertices(const VertexStream& stream, UINT rowBegin, UINT rowEnd) const
+{
+    for (UINT i = rowBegin; i < rowEnd; ++i)
+    {
+        WriteVertexRow(stream, m_CurrHeights, i);
+    }
+}
+
+void Waves::BeginTileSteps(UINT stepCount)
+{
+    if (!m_TrackActiveTiles)
+    {
+        std::fill(m_StepTiles.begin(), m_StepTiles.end(), static_cast<unsigned char>(1));
+        std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), static_cast<unsigned char>(1));
+        return;
+    }
+
+    // The stencil moves information one cell per step, so growing the active set by
+    // one tile covers everywhere the motion can reach in up to TileSize steps.
+    int reach = static_cast<int>((stepCount + TileSize - 1) / TileSize);
+    int rows = static_cast<int>(m_TileRowCount);
+    int cols = static_cast<int>(m_TileColCount);
+
+    std::fill(m_StepTiles.begin(), m_StepTiles.end(), static_cast<unsigned char>(0));
+    for (int ty = 0; ty < rows; ++ty)
+    {
+        for (int tx = 0; tx < cols; ++tx)
+        {
+            if (!m_ActiveTiles[ty * cols + tx])
+            {
+                continue;
+            }
+
+            for (int y = std::max(ty - reach, 0); y <= std::min(ty + reach, rows - 1); ++y)
+            {
+                for (int x = std::max(tx - reach, 0); x <= std::min(tx + reach, cols - 1); ++x)
+                {
+                    m_StepTiles[y * cols + x] = 1;
+                    m_DirtyTiles[y * cols + x] = 1;
+                }
+            }
+        }
+    }
+}
+
+void Waves::EndTileSteps()
+{
+    if (!m_TrackActiveTiles)
+    {
+        return;
+    }
+
+    auto measure = [this](UINT ty)
+    {
+        UINT rowBegin = ty * TileSize;
+        UINT rowEnd = std::min(rowBegin + TileSize, m_NumRows);
+
+        for (UINT tx = 0; tx < m_TileColCount; ++tx)
+        {
+            UINT tile = ty * m_TileColCount + tx;
+            if (!m_StepTiles[tile])
+            {
+                continue;
+            }
+
+            UINT colBegin = tx * TileSize;
+            UINT colEnd = std::min(colBegin + TileSize, m_NumCols);
+
+            float peak = 0.0f;
+            for (UINT i = rowBegin; i < rowEnd; ++i)
+            {
+                const float* curr = m_CurrHeights + i * m_RowPitch;
+                const float* prev = m_PrevHeights + i * m_RowPitch;
+                for (UINT j = colBegin; j < colEnd; ++j)
+                {
+                    peak = std::max(peak, std::max(fabsf(curr[j]), fabsf(prev[j])));
+                }
+            }
+
+            m_ActiveTiles[tile] = peak > m_ActivityEpsilon ? 1 : 0;
+        }
+    };
+
+    if (m_WorkerPool)
+    {
+        m_WorkerPool->Run(m_TileRowCount, measure);
+    }
+    else
+    {
+        for (UINT ty = 0; ty < m_TileRowCount; ++ty)
+        {
+            measure(ty);
+        }
+    }
+}
+
+void Waves::ActivateTiles(UINT rowBegin, UINT rowEnd, UINT colBegin, UINT colEnd)
+{
+    if (!m_TrackActiveTiles)
+    {
+        return;
+    }
+
+    for (UINT ty = rowBegin / TileSize; ty <= (rowEnd - 1) / TileSize; ++ty)
+    {
+        for (UINT tx = colBegin / TileSize; tx <= (colEnd - 1) / TileSize; ++tx)
+        {
+            m_ActiveTiles[ty * m_TileColCount + tx] = 1;
+        }
+    }
+}
+
+template<typename Fn>
+void Waves::ForEachColumnRun(const std::vector<unsigned char>& mask, UINT i, const Fn& fn) const
+{
+    const unsigned char* tiles = &mask[(i / TileSize) * m_TileColCount];
+
+    UINT tx = 0;
+    while (tx < m_TileColCount)
+    {
+        if (!tiles[tx])
+        {
+            ++tx;
+            continue;
+        }
+
+        UINT firstTile = tx;
+        while (tx < m_TileColCount && tiles[tx])
+        {
+            ++tx;
+        }
+
+        UINT colBegin = std::max(firstTile * TileSize, 1u);
+        UINT colEnd = std::min(tx * TileSize, m_NumCols - 1);
+        if (colBegin < colEnd)
+        {
+            fn(colBegin, colEnd);
+        }
+    }
+}
+
+template<typename Body>
+void Waves::ForEachRowBand(const Body& body)
+{
+    WorkerPool::ForEachBand(m_WorkerPool, 1, m_NumRows - 1, WorkerPool::MinBandRows,
+        [&](UINT rowBegin, UINT rowEnd, UINT) { body(rowBegin, rowEnd); });
+}
+
+void Waves::Shift(int rowOffset, int colOffset)
+{
+    int rows = static_cast<int>(m_NumRows);
+    int cols = static_cast<int>(m_NumCols);
+
+    // Destination columns [colBegin, colEnd) have a source column in the grid.
+    int colBegin = std::max(0, -colOffset);
+    int colEnd = std::min(cols, cols - colOffset);
+
+    float* planes[] = { m_PrevHeights, m_CurrHeights };
+    for (float* plane : planes)
+    {
+        // Walk rows away from the direction data moves so no source row is
+        // overwritten before it is read.
+        for (int k = 0; k < rows; ++k)
+        {
+            int i = rowOffset >= 0 ? k : rows - 1 - k;
+            int source = i + rowOffset;
+            float* dst = plane + i * m_RowPitch;
+
+            if (source < 0 || source >= rows || colBegin >= colEnd)
+            {
+                std::fill(dst, dst + cols, 0.0f);
+                continue;
             }
+
+            const float* src = plane + source * m_RowPitch;
+            std::memmove(dst + colBegin, src + colBegin + colOffset, (colEnd - colBegin) * sizeof(float));
+            std::fill(dst, dst + colBegin, 0.0f);
+            std::fill(dst + colEnd, dst + cols, 0.0f);
         }
-	}
+    }
+
+    ActivateTiles(0, m_NumRows, 0, m_NumCols);
+    ++m_Revision;
+}
+
+void Waves::RecomputeNormals()
+{
+    std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), static_cast<unsigned char>(1));
+    ForEachRowBand([this](UINT rowBegin, UINT rowEnd)
+    {
+        ComputeNormals(m_CurrHeights, rowBegin, rowEnd, m_Kernels.NormalRow);
+    });
+    ++m_Revision;
 }
 
 void Waves::Disturb(UINT i, UINT j, float magnitude)
 {
-	// Don't disturb boundaries.
-	assert(i > 1 && i < m_NumRows-2);
-	assert(j > 1 && j < m_NumCols-2);
+    // Don't disturb boundaries.
+    assert(i > 1 && i < m_NumRows-2);
+    assert(j > 1 && j < m_NumCols-2);
+
+    float halfMag = 0.5f * magnitude;
+
+    // Disturb the ijth vertex height and its neighbors.
+    float* h = m_CurrHeights + i * m_RowPitch + j;
+    h[0] += magnitude;
+    h[1] += halfMag;
+    h[-1] += halfMag;
+    h[m_RowPitch] += halfMag;
+    h[-static_cast<int>(m_RowPitch)] += halfMag;
+
+    ActivateTiles(i - 1, i + 2, j - 1, j + 2);
+    ++m_Revision;
+}
+
+void Waves::QueueDisturbances(const Disturbance* events, UINT count, const DisturbanceKernel& kernel)
+{
+    // Find or build the weight stencil for this kernel.
+    UINT kernelIndex = 0;
+    while (kernelIndex < m_DisturbKernels.size() &&
+        (m_DisturbKernels[kernelIndex].Kernel.Radius != kernel.Radius ||
+         m_DisturbKernels[kernelIndex].Kernel.Shape != kernel.Shape))
+    {
+        ++kernelIndex;
+    }
+
+    if (kernelIndex == m_DisturbKernels.size())
+    {
+        KernelWeights weights;
+        weights.Kernel = kernel;
+
+        int r = static_cast<int>(kernel.Radius);
+        float sigma = 0.5f * MathHelper::Max(kernel.Radius, 1u);
+        weights.Weights.resize((2 * r + 1) * (2 * r + 1), 0.0f);
+
+        for (int di = -r; di <= r; ++di)
+        {
+            for (int dj = -r; dj <= r; ++dj)
+            {
+                float d = sqrtf(static_cast<float>(di * di + dj * dj));
+                if (d > kernel.Radius)
+                {
+                    continue;
+                }
 
-	float halfMag = 0.5f * magnitude;
+                float w = 0.0f;
+                switch (kernel.Shape)
+                {
+                case DisturbanceKernel::Falloff::Cross:
+                    w = (di == 0 && dj == 0) ? 1.0f : (d == 1.0f ? 0.5f : 0.0f);
+                    break;
+                case DisturbanceKernel::Falloff::Linear:
+                    w = 1.0f - d / (kernel.Radius + 1);
+                    break;
+                case DisturbanceKernel::Falloff::Gaussian:
+                    w = expf(-(d * d) / (2.0f * sigma * sigma));
+                    break;
+                }
+
+                weights.Weights[(di + r) * (2 * r + 1) + (dj + r)] = w;
+            }
+        }
+
+        m_DisturbKernels.push_back(weights);
+    }
+
+    m_DisturbQueue.reserve(m_DisturbQueue.size() + count);
+    for (UINT e = 0; e < count; ++e)
+    {
+        const Disturbance& event = events[e];
+        if (event.Row >= m_NumRows || event.Col >= m_NumCols)
+        {
+            continue;
+        }
+
+        QueuedDisturbance queued;
+        queued.Tile = (event.Row / TileSize) * m_TileColCount + event.Col / TileSize;
+        queued.Row = event.Row;
+        queued.Col = event.Col;
+        queued.Magnitude = event.Magnitude;
+        queued.Kernel = kernelIndex;
+        m_DisturbQueue.push_back(queued);
+    }
+}
+
+void Waves::ApplyQueuedDisturbances()
+{
+    if (m_DisturbQueue.empty())
+    {
+        return;
+    }
+
+    std::stable_sort(m_DisturbQueue.begin(), m_DisturbQueue.end(),
+        [](const QueuedDisturbance& a, const QueuedDisturbance& b) { return a.Tile < b.Tile; });
+
+    for (const QueuedDisturbance& event : m_DisturbQueue)
+    {
+        const KernelWeights& kernel = m_DisturbKernels[event.Kernel];
+        int r = static_cast<int>(kernel.Kernel.Radius);
+        int width = 2 * r + 1;
+
+        // Clip to the interior; the boundary stays fixed at zero.
+        int rowBegin = MathHelper::Max(static_cast<int>(event.Row) - r, 1);
+        int rowEnd = MathHelper::Min(static_cast<int>(event.Row) + r + 1, static_cast<int>(m_NumRows) - 1);
+        int colBegin = MathHelper::Max(static_cast<int>(event.Col) - r, 1);
+        int colEnd = MathHelper::Min(static_cast<int>(event.Col) + r + 1, static_cast<int>(m_NumCols) - 1);
+        if (rowBegin >= rowEnd || colBegin >= colEnd)
+        {
+            continue;
+        }
+
+        for (int i = rowBegin; i < rowEnd; ++i)
+        {
+            float* h = m_CurrHeights + i * m_RowPitch;
+            const float* w = &kernel.Weights[(i - static_cast<int>(event.Row) + r) * width + r];
+            for (int j = colBegin; j < colEnd; ++j)
+            {
+                h[j] += event.Magnitude * w[j - static_cast<int>(event.Col)];
+            }
+        }
+
+        ActivateTiles(rowBegin, rowEnd, colBegin, colEnd);
+    }
+
+    m_DisturbQueue.clear();
+    ++m_Revision;
+}
+
+void Waves::ReleasePlanes()
+{
+    AlignedPlanes::Free(m_Storage);
+    m_Storage = nullptr;
 
-	// Disturb the ijth vertex height and its neighbors.
-	m_CurrSolution[i * m_NumCols + j].y += magnitude;
-	m_CurrSolution[i * m_NumCols + j + 1].y += halfMag;
-	m_CurrSolution[i * m_NumCols + j - 1].y += halfMag;
-	m_CurrSolution[(i + 1) * m_NumCols + j].y += halfMag;
-	m_CurrSolution[(i - 1) * m_NumCols + j].y += halfMag;
+    delete m_Checkpoint;
+    m_Checkpoint = nullptr;
 }
-	
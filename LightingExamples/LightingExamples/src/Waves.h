@@ -6,11 +6,94 @@
 
 #include <Windows.h>
 #include <DirectXMath.h>
+#include <vector>
+#include "WavesKernels.h"
+#include "FixedStepClock.h"
 using namespace DirectX;
 
+class WorkerPool;
+class WaveCheckpoint;
+struct WaveSnapshot;
+
 
 class Waves
 {
+public:
+    // One queued bump of the water surface centred on grid point (Row, Col).
+    struct Disturbance
+    {
+        UINT Row;
+        UINT Col;
+        float Magnitude;
+    };
+
+    // Shape of the bump a queued disturbance adds.  Weights are 1 at the centre:
+    //   Cross    - 0.5 on the four neighbours at distance 1, like Disturb().
+    //   Linear   - 1 - d/(Radius+1), a cone.
+    //   Gaussian - exp(-d^2 / (2 sigma^2)) with sigma = Radius/2.
+    // Cells farther than Radius from the centre are untouched.
+    struct DisturbanceKernel
+    {
+        enum class Falloff
+        {
+            Cross,
+            Linear,
+            Gaussian
+        };
+
+        DisturbanceKernel() : Radius(1), Shape(Falloff::Cross) {}
+        DisturbanceKernel(UINT radius, Falloff shape) : Radius(radius), Shape(shape) {}
+
+        UINT Radius;
+        Falloff Shape;
+    };
+
+    // Interleaved vertex destination, e.g. a mapped dynamic vertex buffer.  Vertex
+    // k = i*ColumnCount()+j starts Stride bytes after vertex k-1; its position and
+    // normal are three floats each at the given byte offsets.
+    struct VertexStream
+    {
+        void* Data;
+        UINT Stride;
+        UINT PositionOffset;
+        UINT NormalOffset;
+    };
+
+    // What CaptureSnapshot copies.  HeightsOnly ships 4 bytes per vertex instead of
+    // 16; positions and normals are rebuilt by the consumer (WaveHeightDecoder).
+    enum class SnapshotFormat
+    {
+        HeightsAndNormals,
+        HeightsOnly
+    };
+
+    // A batch of surface samples.  Point k is (X[k], Z[k]) in the space the grid's
+    // centre sits at Origin in, and Heights[k] comes back in that space too.  The
+    // normal outputs may be null to sample heights only.
+    struct SurfaceQuery
+    {
+        SurfaceQuery()
+            : X(nullptr), Z(nullptr), Count(0), Origin(0.0f, 0.0f, 0.0f)
+            , Heights(nullptr), NormalX(nullptr), NormalY(nullptr), NormalZ(nullptr) {}
+
+        const float* X;
+        const float* Z;
+        UINT Count;
+        XMFLOAT3 Origin;
+
+        float* Heights;
+        float* NormalX;
+        float* NormalY;
+        float* NormalZ;
+    };
+
+    // Half-open range of grid rows.
+    struct RowRange
+    {
+        UINT Begin;
+        UINT End;
+    };
+
 public:
 	Waves();
 	~Waves();
@@ -21,18 +104,203 @@ public:
 	UINT TriangleCount() const;
 
 	// Returns the solution at the ith grid point.
-	const XMFLOAT3& operator[](int i) const { return m_CurrSolution[i]; }
+	XMFLOAT3 operator[](int i) const;
 
     // Returns the solution normal at the ith grid point.
-    const XMFLOAT3& Normal(int i) const { return m_Normals[i]; }
+    XMFLOAT3 Normal(int i) const;
 
     // Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-    const XMFLOAT3& TangentX(int i) const { return m_TangentX[i]; }
+    XMFLOAT3 TangentX(int i) const;
+
+    // The state is kept as structure-of-arrays planes of m rows, each row padded
+    // to RowPitch() floats so every row starts on a 64-byte boundary.  Only the
+    // heights change over time; x and z are derived from the grid spacing.
+    UINT RowPitch() const { return m_RowPitch; }
+    const float* Heights() const { return m_CurrHeights; }
+    float Height(UINT i, UINT j) const { return m_CurrHeights[i * m_RowPitch + j]; }
+    float PreviousHeight(UINT i, UINT j) const { return m_PrevHeights[i * m_RowPitch + j]; }
+
+    // Overwrites the current and previous height at (i, j), including on the
+    // boundary, which the solver otherwise holds at zero.  Normals, tile activity
+    // and Revision are left alone; the next Step() or RecomputeNormals() catches up.
+    void SetHeight(UINT i, UINT j, float height, float previousHeight)
+    {
+        m_CurrHeights[i * m_RowPitch + j] = height;
+        m_PrevHeights[i * m_RowPitch + j] = previousHeight;
+    }
+
+    // Moves the solution by whole grid points: point (i, j) takes the heights that
+    // were at (i + rowOffset, j + colOffset), and points with no source become flat.
+    // Used to scroll a grid that follows a moving centre.
+    void Shift(int rowOffset, int colOffset);
+
+    // Recomputes every normal and tangent from the current heights with the exact
+    // NormalRow kernels, even when the fused sweep is on, and marks the whole grid
+    // dirty.
+    void RecomputeNormals();
+
+    float GridX(UINT j) const { return -m_HalfWidth + j * m_SpatialStep; }
+    float GridZ(UINT i) const { return m_HalfDepth - i * m_SpatialStep; }
+
+    float TimeStep() const { return m_TimeStep; }
+    float SpatialStep() const { return m_SpatialStep; }
+
+    // Writes every vertex's position and normal into stream, or only those of rows
+    // [rowBegin, rowEnd).  Vertex k still goes to offset k*Stride.
+    void WriteVertices(const VertexStream& stream) const;
+    void WriteVertices(const VertexStream& stream, UINT rowBegin, UINT rowEnd) const;
+
+    // Bilinearly interpolated heights and normals of the water at query's points,
+    // clamped to the grid (see WavesKernels::SampleFn), using this instance's
+    // kernels.  Reads the live solution, so call it between steps on the thread
+    // that owns this instance.
+    void SampleSurface(const SurfaceQuery& query) const;
+
+    // The same on a captured frame.  A frame is not written once published, so any
+    // number of threads may sample it at once, e.g. in batches on a WorkerPool while
+    // it is the reader's latest snapshot.  Uses the widest kernels the CPU supports.
+    static void SampleSurface(const WaveSnapshot& frame, const SurfaceQuery& query);
+
+    // Copies the current heights, and normals unless format is HeightsOnly, into
+    // snapshot, reusing its storage.
+    void CaptureSnapshot(WaveSnapshot& snapshot, SnapshotFormat format = SnapshotFormat::HeightsAndNormals) const;
+
+    // Writes both height buffers, the normals and tangents, the simulation constants
+    // and the clock to path in the WaveCheckpoint format, one plane at a time.
+    // Queued disturbances are not saved.  Returns false if the file could not be
+    // written in full.
+    bool SaveCheckpoint(const char* path) const;
+
+    // Replaces the whole state, as Init does, with a checkpoint SaveCheckpoint wrote;
+    // later steps continue exactly as the saved instance would have.  The file is
+    // mapped copy-on-write and its planes become this instance's storage, so no
+    // plane is copied up front: pages are read as the first step touches them.  The
+    // file must not be truncated while loaded.  Tile activity is not saved; every
+    // tile starts active and settles at the next step.  Returns false, leaving this
+    // instance unchanged, if the file is missing, incomplete, from another version,
+    // has another row pitch than this build would use, or holds constants no Init
+    // could have produced (non-positive steps, non-finite coefficients, or an
+    // accumulator outside [0, TimeStep)).
+    bool LoadCheckpoint(const char* path);
 
 	void Init(UINT m, UINT n, float dx, float dt, float speed, float damping);
-	void Update(float dt);
+
+    // Selects the row kernels used by Update.  The widest instruction set the CPU
+    // supports is used by default; WavesKernels::Isa::Scalar gives the reference path.
+    void SetKernelIsa(WavesKernels::Isa isa) { m_Kernels = WavesKernels::Select(isa); }
+    WavesKernels::Isa KernelIsa() const { return m_Kernels.Level; }
+
+    // Splits each pass of Update into bands of whole rows run on the given pool.
+    // Rows are cache-line aligned so no two bands write the same line, and every
+    // cell is computed exactly as in the serial path.  The pool is not owned and
+    // may be shared; nullptr (the default) runs serially.
+    void SetWorkerPool(WorkerPool* pool) { m_WorkerPool = pool; }
+
+    // When Step() has several steps to take, advance up to this many of them per
+    // sweep with a time-skewed wavefront: sub-step s trails sub-step s-1 by one row,
+    // so only ~2*(stepsPerBlock+2) rows are live and they stay in L2 instead of
+    // streaming the whole grid through memory once per step.  Results are
+    // bit-identical to stepping one at a time.  Values below 2 disable blocking.
+    // The blocked sweep is serial; with a worker pool set, steps run one at a time
+    // in parallel bands instead.
+    void SetTemporalBlocking(UINT stepsPerBlock) { m_StepsPerBlock = stepsPerBlock; }
+
+    // Computes the normals and tangents in the same sweep as the final step's
+    // heights, trailing the height row by one, instead of in a second pass over the
+    // grid.  Heights are unchanged; normals use the NormalRowFast kernels
+    // (reciprocal square root estimate plus one Newton step), except in
+    // RecomputeNormals().  Off by default.
+    void SetFusedKernel(bool enable) { m_FusedKernel = enable; }
+
+    // Most fixed steps a single Update may take.
+    void SetMaxSubsteps(UINT maxSubsteps) { m_Clock.SetMaxSubsteps(maxSubsteps); }
+
+    // Number of fixed steps the last Update took.
+    UINT LastStepCount() const { return m_Clock.LastStepCount(); }
+
+    // Fraction of a time step left in the accumulator after the last Update, in
+    // [0, 1); use it to blend between the previous and current solution.  0 before
+    // Init.
+    float InterpolationAlpha() const { return m_Clock.Alpha(m_TimeStep); }
+
+    // Simulated time in seconds since Init, i.e. steps taken times the time step.
+    double SimulatedTime() const { return m_TotalStepCount * static_cast<double>(m_TimeStep); }
+
+    // The grid is divided into TileSize x TileSize tiles.  With tracking enabled a
+    // tile is active while the largest |height| in either buffer exceeds epsilon;
+    // Disturb() activates tiles, and each step also runs on the ring of tiles
+    // around the active ones so waves can spread into them.  Quiet tiles are frozen: the
+    // stencil and normal passes skip them, so the cost follows the disturbed area.
+    // Disabled by default, in which case every tile is stepped.
+    static const UINT TileSize = 32;
+    void SetActiveTileTracking(bool enable, float epsilon = 1.0e-4f);
+    UINT TileRowCount() const { return m_TileRowCount; }
+    UINT TileColumnCount() const { return m_TileColCount; }
+    bool IsTileActive(UINT tileRow, UINT tileCol) const;
+    UINT ActiveTileCount() const;
+
+    // True if the tile's heights or normals changed during the last Step().
+    bool IsTileDirty(UINT tileRow, UINT tileCol) const;
+
+    // Replaces ranges with the rows holding a dirty tile, in order, adjacent tile
+    // rows merged.  In a row-major vertex buffer each range is one contiguous span.
+    void GetDirtyRowRanges(std::vector<RowRange>& ranges) const;
+
+    // Bumped whenever the solution changes, so consumers can skip redundant uploads.
+    UINT Revision() const { return m_Revision; }
+
+	// Adds dt to this instance's clock and runs every fixed step that is now owed,
+    // up to the max substep budget.  Time beyond the budget is dropped rather than
+    // carried, so a long stall cannot cause an ever-growing catch-up.
+	void Update(float dt, const VertexStream* stream = nullptr);
+
+    // Number of fixed steps Update(dt) would take now.
+    UINT StepsDue(float dt) const;
+
+    // Advances the simulation by stepCount fixed time steps, then recomputes the
+    // normals once from the final heights.  If stream is given and stepCount > 0,
+    // the normal pass also writes every vertex of the result into it, each row right
+    // after its normals are computed, so no separate copy sweep is needed.
+    void Step(UINT stepCount, const VertexStream* stream = nullptr);
 	void Disturb(UINT i, UINT j, float magnitude);
 
+    // Queues events to be applied in bulk at the start of the next step, sorted by
+    // tile so the writes land in cache-friendly order.  Events within a tile keep
+    // their submission order, so results are deterministic.  Unlike Disturb(),
+    // kernels are clipped at the boundary instead of asserting.
+    void QueueDisturbances(const Disturbance* events, UINT count,
+        const DisturbanceKernel& kernel = DisturbanceKernel());
+    UINT QueuedDisturbanceCount() const { return static_cast<UINT>(m_DisturbQueue.size()); }
+
+private:
+    void StepHeights(UINT rowBegin, UINT rowEnd);
+    void StepHeightsFused(UINT rowBegin, UINT rowEnd);
+    void StepHeightsBlocked(UINT stepCount, bool fused);
+    // The step's normal kernel: NormalRowFast with the fused sweep, else NormalRow.
+    void ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd);
+    void ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd, WavesKernels::NormalRowFn normalRow);
+    void WriteVertexRow(const VertexStream& stream, const float* heights, UINT i) const;
+
+    // Selects the tiles the next stepCount steps run on: the active set grown by
+    // stepCount tiles.  Afterwards, keeps active only the tiles that still move.
+    void BeginTileSteps(UINT stepCount);
+    void EndTileSteps();
+    void ActivateTiles(UINT rowBegin, UINT rowEnd, UINT colBegin, UINT colEnd);
+
+    void ApplyQueuedDisturbances();
+
+    // Frees the planes, or unmaps them if they came from a checkpoint.
+    void ReleasePlanes();
+
+    // Calls fn(colBegin, colEnd) for every run of consecutive tiles set in mask on
+    // the tile row containing grid row i, clipped to the interior columns.
+    template<typename Fn>
+    void ForEachColumnRun(const std::vector<unsigned char>& mask, UINT i, const Fn& fn) const;
+
+    // Calls body(rowBegin, rowEnd) over the interior rows, one band per task.
+    template<typename Body>
+    void ForEachRowBand(const Body& body);
+
 private:
 	UINT m_NumRows;
 	UINT m_NumCols;
@@ -48,8 +316,67 @@ private:
 	float m_TimeStep;
 	float m_SpatialStep;
 
-	XMFLOAT3* m_PrevSolution;
-	XMFLOAT3* m_CurrSolution;
-    XMFLOAT3* m_Normals;
-    XMFLOAT3* m_TangentX;
+    float m_HalfWidth;
+    float m_HalfDepth;
+
+    // Floats per row in every plane (m_NumCols rounded up to a cache line).
+    UINT m_RowPitch;
+
+    // One aligned block holding all planes below, or null while they lie in
+    // m_Checkpoint's mapping.
+    float* m_Storage;
+    WaveCheckpoint* m_Checkpoint;
+
+    float* m_PrevHeights;
+    float* m_CurrHeights;
+    float* m_NormalX;
+    float* m_NormalY;
+    float* m_NormalZ;
+
+    // TangentX lies in the xy-plane, so its z component is always zero.
+    float* m_TangentXX;
+    float* m_TangentXY;
+
+    WavesKernels m_Kernels;
+    WorkerPool* m_WorkerPool;
+    UINT m_StepsPerBlock;
+
+    // Unsimulated time carried between Update calls.
+    FixedStepClock m_Clock;
+    unsigned long long m_TotalStepCount;
+
+    // Active tile tracking; one byte per tile, row-major.
+    bool m_TrackActiveTiles;
+    float m_ActivityEpsilon;
+    UINT m_TileRowCount;
+    UINT m_TileColCount;
+    std::vector<unsigned char> m_ActiveTiles;
+    std::vector<unsigned char> m_StepTiles;
+    std::vector<unsigned char> m_DirtyTiles;
+
+    UINT m_Revision;
+
+    bool m_FusedKernel;
+
+    // Destination of the normal pass's vertex output; only set during Step().
+    const VertexStream* m_VertexStream;
+
+    struct QueuedDisturbance
+    {
+        UINT Tile;
+        UINT Row;
+        UINT Col;
+        float Magnitude;
+        UINT Kernel;
+    };
+
+    // Weight stencils of (2*Radius+1)^2 floats, one per distinct kernel queued.
+    struct KernelWeights
+    {
+        DisturbanceKernel Kernel;
+        std::vector<float> Weights;
+    };
+
+    std::vector<QueuedDisturbance> m_DisturbQueue;
+    std::vector<KernelWeights> m_DisturbKernels;
 };
\ No newline at end of file
@@ -0,0 +1,812 @@
+//***************************************************************************************
+// WavesKernels.cpp
+//***************************************************************************************
+
+#include "WavesKernels.h"
+#include "SimdTarget.h"
+#include <DirectXMath.h>
+#include <cmath>
+
+#if !defined(_MSC_VER)
+    #include <cpuid.h>
+#endif
+
+using namespace DirectX;
+
+// Keep mul+add separate so the vector kernels round exactly like the scalar reference.
+SIMD_FP_CONTRACT_OFF_BEGIN
+
+namespace
+{
+    //
+    // Scalar reference kernels.
+    //
+
+    inline float StepCell(float prev, float curr, float up, float down, float right, float left,
+        float k1, float k2, float k3)
+    {
+        return k1 * prev + k2 * curr + k3 * (down + up + right + left);
+    }
+
+    // Matches the operation order of the vector kernels below, which in turn match
+    // XMVector3Normalize: ((x*x + y*y) + z*z), sqrt, then divide.
+    inline void NormalCell(float l, float r, float t, float b, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        float x = l - r;
+        float z = b - t;
+        float len = sqrtf((x * x + twoDx * twoDx) + z * z);
+        *nx = x / len;
+        *ny = twoDx / len;
+        *nz = z / len;
+
+        float y = r - l;
+        float tlen = sqrtf((twoDx * twoDx + y * y) + 0.0f);
+        *tx = twoDx / tlen;
+        *ty = y / tlen;
+    }
+
+    void StepRowScalar(float* prev, const float* curr, const float* up, const float* down,
+        UINT count, float k1, float k2, float k3)
+    {
+        const float* left = curr - 1;
+        const float* right = curr + 1;
+
+        for (UINT j = 0; j < count; ++j)
+        {
+            prev[j] = StepCell(prev[j], curr[j], up[j], down[j], right[j], left[j], k1, k2, k3);
+        }
+    }
+
+    void NormalRowScalar(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        const float* left = curr - 1;
+        const float* right = curr + 1;
+
+        for (UINT j = 0; j < count; ++j)
+        {
+            float l = left[j];
+            float r = right[j];
+            float t = up[j];
+            float b = down[j];
+
+            XMFLOAT3 normal(-r + l, twoDx, b - t);
+            XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+            nx[j] = normal.x;
+            ny[j] = normal.y;
+            nz[j] = normal.z;
+
+            XMFLOAT3 tangent(twoDx, r - l, 0.0f);
+            XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
+            tx[j] = tangent.x;
+            ty[j] = tangent.y;
+        }
+    }
+
+    //
+    // SSE2 kernels, 4 cells per instruction.
+    //
+
+    void StepRowSSE2(float* prev, const float* curr, const float* up, const float* down,
+        UINT count, float k1, float k2, float k3)
+    {
+        __m128 vk1 = _mm_set1_ps(k1);
+        __m128 vk2 = _mm_set1_ps(k2);
+        __m128 vk3 = _mm_set1_ps(k3);
+
+        UINT j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+            __m128 h = _mm_mul_ps(vk1, _mm_loadu_ps(prev + j));
+            h = _mm_add_ps(h, _mm_mul_ps(vk2, _mm_loadu_ps(curr + j)));
+            h = _mm_add_ps(h, _mm_mul_ps(vk3, sum));
+            _mm_storeu_ps(prev + j, h);
+        }
+
+        const float* left = curr - 1;
+        const float* right = curr + 1;
+        for (; j < count; ++j)
+        {
+            prev[j] = StepCell(prev[j], curr[j], up[j], down[j], right[j], left[j], k1, k2, k3);
+        }
+    }
+
+    void NormalRowSSE2(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m128 vTwoDx = _mm_set1_ps(twoDx);
+        __m128 vTwoDxSq = _mm_mul_ps(vTwoDx, vTwoDx);
+        __m128 zero = _mm_setzero_ps();
+
+        UINT j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 l = _mm_loadu_ps(curr + j - 1);
+            __m128 r = _mm_loadu_ps(curr + j + 1);
+            __m128 x = _mm_sub_ps(l, r);
+            __m128 z = _mm_sub_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+
+            __m128 lenSq = _mm_add_ps(_mm_mul_ps(x, x), vTwoDxSq);
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(lenSq, _mm_mul_ps(z, z)));
+            _mm_storeu_ps(nx + j, _mm_div_ps(x, len));
+            _mm_storeu_ps(ny + j, _mm_div_ps(vTwoDx, len));
+            _mm_storeu_ps(nz + j, _mm_div_ps(z, len));
+
+            __m128 y = _mm_sub_ps(r, l);
+            __m128 tlen = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(vTwoDxSq, _mm_mul_ps(y, y)), zero));
+            _mm_storeu_ps(tx + j, _mm_div_ps(vTwoDx, tlen));
+            _mm_storeu_ps(ty + j, _mm_div_ps(y, tlen));
+        }
+
+        const float* left = curr - 1;
+        const float* right = curr + 1;
+        for (; j < count; ++j)
+        {
+            NormalCell(left[j], right[j], up[j], down[j], twoDx,
+                nx + j, ny + j, nz + j, tx + j, ty + j);
+        }
+    }
+
+    //
+    // AVX2 kernels, 8 cells per instruction.
+    //
+
+    SIMD_TARGET_AVX2 void StepRowAVX2(float* prev, const float* curr, const float* up, const float* down,
+        UINT count, float k1, float k2, float k3)
+    {
+        __m256 vk1 = _mm256_set1_ps(k1);
+        __m256 vk2 = _mm256_set1_ps(k2);
+        __m256 vk3 = _mm256_set1_ps(k3);
+
+        UINT j = 0;
+        for (; j + 8 <= count; j += 8)
+        {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j + 1));
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j - 1));
+
+            __m256 h = _mm256_mul_ps(vk1, _mm256_loadu_ps(prev + j));
+            h = _mm256_add_ps(h, _mm256_mul_ps(vk2, _mm256_loadu_ps(curr + j)));
+            h = _mm256_add_ps(h, _mm256_mul_ps(vk3, sum));
+            _mm256_storeu_ps(prev + j, h);
+        }
+
+        StepRowSSE2(prev + j, curr + j, up + j, down + j, count - j, k1, k2, k3);
+    }
+
+    SIMD_TARGET_AVX2 void NormalRowAVX2(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m256 vTwoDx = _mm256_set1_ps(twoDx);
+        __m256 vTwoDxSq = _mm256_mul_ps(vTwoDx, vTwoDx);
+        __m256 zero = _mm256_setzero_ps();
+
+        UINT j = 0;
+        for (; j + 8 <= count; j += 8)
+        {
+            __m256 l = _mm256_loadu_ps(curr + j - 1);
+            __m256 r = _mm256_loadu_ps(curr + j + 1);
+            __m256 x = _mm256_sub_ps(l, r);
+            __m256 z = _mm256_sub_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+
+            __m256 lenSq = _mm256_add_ps(_mm256_mul_ps(x, x), vTwoDxSq);
+            __m256 len = _mm256_sqrt_ps(_mm256_add_ps(lenSq, _mm256_mul_ps(z, z)));
+            _mm256_storeu_ps(nx + j, _mm256_div_ps(x, len));
+            _mm256_storeu_ps(ny + j, _mm256_div_ps(vTwoDx, len));
+            _mm256_storeu_ps(nz + j, _mm256_div_ps(z, len));
+
+            __m256 y = _mm256_sub_ps(r, l);
+            __m256 tlen = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(vTwoDxSq, _mm256_mul_ps(y, y)), zero));
+            _mm256_storeu_ps(tx + j, _mm256_div_ps(vTwoDx, tlen));
+            _mm256_storeu_ps(ty + j, _mm256_div_ps(y, tlen));
+        }
+
+        NormalRowSSE2(curr + j, up + j, down + j, count - j, twoDx,
+            nx + j, ny + j, nz + j, tx + j, ty + j);
+    }
+
+    //
+    // AVX-512 kernels, 16 cells per instruction.  The row tail uses masked loads
+    // and stores instead of falling back to narrower kernels.
+    //
+
+    SIMD_TARGET_AVX512 void StepRowAVX512(float* prev, const float* curr, const float* up, const float* down,
+        UINT count, float k1, float k2, float k3)
+    {
+        __m512 vk1 = _mm512_set1_ps(k1);
+        __m512 vk2 = _mm512_set1_ps(k2);
+        __m512 vk3 = _mm512_set1_ps(k3);
+
+        for (UINT j = 0; j < count; j += 16)
+        {
+            __mmask16 mask = count - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - j)) - 1);
+
+            __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, down + j), _mm512_maskz_loadu_ps(mask, up + j));
+            sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(mask, curr + j + 1));
+            sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(mask, curr + j - 1));
+
+            __m512 h = _mm512_mul_ps(vk1, _mm512_maskz_loadu_ps(mask, prev + j));
+            h = _mm512_add_ps(h, _mm512_mul_ps(vk2, _mm512_maskz_loadu_ps(mask, curr + j)));
+            h = _mm512_add_ps(h, _mm512_mul_ps(vk3, sum));
+            _mm512_mask_storeu_ps(prev + j, mask, h);
+        }
+    }
+
+    SIMD_TARGET_AVX512 void NormalRowAVX512(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m512 vTwoDx = _mm512_set1_ps(twoDx);
+        __m512 vTwoDxSq = _mm512_mul_ps(vTwoDx, vTwoDx);
+        __m512 zero = _mm512_setzero_ps();
+
+        for (UINT j = 0; j < count; j += 16)
+        {
+            __mmask16 mask = count - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - j)) - 1);
+
+            __m512 l = _mm512_maskz_loadu_ps(mask, curr + j - 1);
+            __m512 r = _mm512_maskz_loadu_ps(mask, curr + j + 1);
+            __m512 x = _mm512_sub_ps(l, r);
+            __m512 z = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, down + j), _mm512_maskz_loadu_ps(mask, up + j));
+
+            __m512 lenSq = _mm512_add_ps(_mm512_mul_ps(x, x), vTwoDxSq);
+            __m512 len = _mm512_sqrt_ps(_mm512_add_ps(lenSq, _mm512_mul_ps(z, z)));
+            _mm512_mask_storeu_ps(nx + j, mask, _mm512_div_ps(x, len));
+            _mm512_mask_storeu_ps(ny + j, mask, _mm512_div_ps(vTwoDx, len));
+            _mm512_mask_storeu_ps(nz + j, mask, _mm512_div_ps(z, len));
+
+            __m512 y = _mm512_sub_ps(r, l);
+            __m512 tlen = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(vTwoDxSq, _mm512_mul_ps(y, y)), zero));
+            _mm512_mask_storeu_ps(tx + j, mask, _mm512_div_ps(vTwoDx, tlen));
+            _mm512_mask_storeu_ps(ty + j, mask, _mm512_div_ps(y, tlen));
+        }
+    }
+
+    //
+    // Fast normal kernels: reciprocal square root estimate refined by one
+    // Newton-Raphson step, y' = y * (1.5 - 0.5 * x * y * y), instead of sqrt and
+    // three divides.  The refined estimate is within ~2e-7 relative of 1/sqrt(x).
+    //
+
+    inline void NormalCellFast(float l, float r, float t, float b, float twoDx,
+        float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        float x = l - r;
+        float z = b - t;
+        __m128 lenSq = _mm_set_ss((x * x + twoDx * twoDx) + z * z);
+        __m128 est = _mm_rsqrt_ss(lenSq);
+        est = _mm_mul_ss(est, _mm_sub_ss(_mm_set_ss(1.5f),
+            _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), lenSq), _mm_mul_ss(est, est))));
+        float inv = _mm_cvtss_f32(est);
+        *nx = x * inv;
+        *ny = twoDx * inv;
+        *nz = z * inv;
+
+        float y = r - l;
+        __m128 tlenSq = _mm_set_ss(twoDx * twoDx + y * y);
+        est = _mm_rsqrt_ss(tlenSq);
+        est = _mm_mul_ss(est, _mm_sub_ss(_mm_set_ss(1.5f),
+            _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), tlenSq), _mm_mul_ss(est, est))));
+        inv = _mm_cvtss_f32(est);
+        *tx = twoDx * inv;
+        *ty = y * inv;
+    }
+
+    void NormalRowFastScalar(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        const float* left = curr - 1;
+        const float* right = curr + 1;
+
+        for (UINT j = 0; j < count; ++j)
+        {
+            NormalCellFast(left[j], right[j], up[j], down[j], twoDx,
+                nx + j, ny + j, nz + j, tx + j, ty + j);
+        }
+    }
+
+    void NormalRowFastSSE2(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m128 vTwoDx = _mm_set1_ps(twoDx);
+        __m128 vTwoDxSq = _mm_mul_ps(vTwoDx, vTwoDx);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 threeHalves = _mm_set1_ps(1.5f);
+
+        UINT j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 l = _mm_loadu_ps(curr + j - 1);
+            __m128 r = _mm_loadu_ps(curr + j + 1);
+            __m128 x = _mm_sub_ps(l, r);
+            __m128 z = _mm_sub_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+
+            __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), vTwoDxSq), _mm_mul_ps(z, z));
+            __m128 inv = _mm_rsqrt_ps(lenSq);
+            inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, lenSq), _mm_mul_ps(inv, inv))));
+            _mm_storeu_ps(nx + j, _mm_mul_ps(x, inv));
+            _mm_storeu_ps(ny + j, _mm_mul_ps(vTwoDx, inv));
+            _mm_storeu_ps(nz + j, _mm_mul_ps(z, inv));
+
+            __m128 y = _mm_sub_ps(r, l);
+            __m128 tlenSq = _mm_add_ps(vTwoDxSq, _mm_mul_ps(y, y));
+            inv = _mm_rsqrt_ps(tlenSq);
+            inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, tlenSq), _mm_mul_ps(inv, inv))));
+            _mm_storeu_ps(tx + j, _mm_mul_ps(vTwoDx, inv));
+            _mm_storeu_ps(ty + j, _mm_mul_ps(y, inv));
+        }
+
+        NormalRowFastScalar(curr + j, up + j, down + j, count - j, twoDx,
+            nx + j, ny + j, nz + j, tx + j, ty + j);
+    }
+
+    SIMD_TARGET_AVX2 void NormalRowFastAVX2(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m256 vTwoDx = _mm256_set1_ps(twoDx);
+        __m256 vTwoDxSq = _mm256_mul_ps(vTwoDx, vTwoDx);
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+        UINT j = 0;
+        for (; j + 8 <= count; j += 8)
+        {
+            __m256 l = _mm256_loadu_ps(curr + j - 1);
+            __m256 r = _mm256_loadu_ps(curr + j + 1);
+            __m256 x = _mm256_sub_ps(l, r);
+            __m256 z = _mm256_sub_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+
+            __m256 lenSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), vTwoDxSq), _mm256_mul_ps(z, z));
+            __m256 inv = _mm256_rsqrt_ps(lenSq);
+            inv = _mm256_mul_ps(inv, _mm256_sub_ps(threeHalves, _mm256_mul_ps(_mm256_mul_ps(half, lenSq), _mm256_mul_ps(inv, inv))));
+            _mm256_storeu_ps(nx + j, _mm256_mul_ps(x, inv));
+            _mm256_storeu_ps(ny + j, _mm256_mul_ps(vTwoDx, inv));
+            _mm256_storeu_ps(nz + j, _mm256_mul_ps(z, inv));
+
+            __m256 y = _mm256_sub_ps(r, l);
+            __m256 tlenSq = _mm256_add_ps(vTwoDxSq, _mm256_mul_ps(y, y));
+            inv = _mm256_rsqrt_ps(tlenSq);
+            inv = _mm256_mul_ps(inv, _mm256_sub_ps(threeHalves, _mm256_mul_ps(_mm256_mul_ps(half, tlenSq), _mm256_mul_ps(inv, inv))));
+            _mm256_storeu_ps(tx + j, _mm256_mul_ps(vTwoDx, inv));
+            _mm256_storeu_ps(ty + j, _mm256_mul_ps(y, inv));
+        }
+
+        NormalRowFastSSE2(curr + j, up + j, down + j, count - j, twoDx,
+            nx + j, ny + j, nz + j, tx + j, ty + j);
+    }
+
+    // _mm512_rsqrt14_ps is a 14-bit estimate, so the refined result is slightly
+    // more accurate than the SSE2/AVX2 ones (which start from 12 bits).
+    SIMD_TARGET_AVX512 void NormalRowFastAVX512(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+    {
+        __m512 vTwoDx = _mm512_set1_ps(twoDx);
+        __m512 vTwoDxSq = _mm512_mul_ps(vTwoDx, vTwoDx);
+        __m512 half = _mm512_set1_ps(0.5f);
+        __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+        for (UINT j = 0; j < count; j += 16)
+        {
+            __mmask16 mask = count - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - j)) - 1);
+
+            __m512 l = _mm512_maskz_loadu_ps(mask, curr + j - 1);
+            __m512 r = _mm512_maskz_loadu_ps(mask, curr + j + 1);
+            __m512 x = _mm512_sub_ps(l, r);
+            __m512 z = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, down + j), _mm512_maskz_loadu_ps(mask, up + j));
+
+            __m512 lenSq = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, x), vTwoDxSq), _mm512_mul_ps(z, z));
+            __m512 inv = _mm512_rsqrt14_ps(lenSq);
+            inv = _mm512_mul_ps(inv, _mm512_sub_ps(threeHalves, _mm512_mul_ps(_mm512_mul_ps(half, lenSq), _mm512_mul_ps(inv, inv))));
+            _mm512_mask_storeu_ps(nx + j, mask, _mm512_mul_ps(x, inv));
+            _mm512_mask_storeu_ps(ny + j, mask, _mm512_mul_ps(vTwoDx, inv));
+            _mm512_mask_storeu_ps(nz + j, mask, _mm512_mul_ps(z, inv));
+
+            __m512 y = _mm512_sub_ps(r, l);
+            __m512 tlenSq = _mm512_add_ps(vTwoDxSq, _mm512_mul_ps(y, y));
+            inv = _mm512_rsqrt14_ps(tlenSq);
+            inv = _mm512_mul_ps(inv, _mm512_sub_ps(threeHalves, _mm512_mul_ps(_mm512_mul_ps(half, tlenSq), _mm512_mul_ps(inv, inv))));
+            _mm512_mask_storeu_ps(tx + j, mask, _mm512_mul_ps(vTwoDx, inv));
+            _mm512_mask_storeu_ps(ty + j, mask, _mm512_mul_ps(y, inv));
+        }
+    }
+
+    //
+    // Surface sampling.  Corner c of a cell is point (i + c/2, j + c%2); each
+    // kernel blends the corners' heights and normals with the same operations in
+    // the same order, so all of them round alike.
+    //
+
+    inline float Lerp(float a, float b, float t)
+    {
+        return a + t * (b - a);
+    }
+
+    void SampleScalar(const WavesKernels::HeightField& field, const float* x, const float* z, UINT count,
+        float* h, float* nx, float* ny, float* nz)
+    {
+        const float* H = field.Heights;
+        UINT pitch = field.Pitch;
+        UINT lastRow = field.RowCount - 1;
+        UINT lastCol = field.ColumnCount - 1;
+        float maxU = static_cast<float>(lastCol);
+        float maxV = static_cast<float>(lastRow);
+
+        for (UINT k = 0; k < count; ++k)
+        {
+            float u = (x[k] - field.X0) * field.InvDx;
+            float v = (field.Z0 - z[k]) * field.InvDx;
+            // Written as the vector max/min are defined, so NaN clamps to 0 alike.
+            u = u > 0.0f ? u : 0.0f;
+            v = v > 0.0f ? v : 0.0f;
+            u = u < maxU ? u : maxU;
+            v = v < maxV ? v : maxV;
+
+            UINT j = static_cast<UINT>(u);
+            UINT i = static_cast<UINT>(v);
+            j = j < lastCol - 1 ? j : lastCol - 1;
+            i = i < lastRow - 1 ? i : lastRow - 1;
+            float fx = u - static_cast<float>(j);
+            float fz = v - static_cast<float>(i);
+
+            UINT row0 = i * pitch;
+            UINT row1 = row0 + pitch;
+            float h00 = H[row0 + j];
+            float h01 = H[row0 + j + 1];
+            float h10 = H[row1 + j];
+            float h11 = H[row1 + j + 1];
+            h[k] = Lerp(Lerp(h00, h01, fx), Lerp(h10, h11, fx), fz) + field.Y0;
+
+            if (!nx)
+            {
+                continue;
+            }
+
+            // Neighbours outside the cell, clamped to the grid; they are only used
+            // by interior corners, for which no clamping happens.
+            UINT colM = j > 0 ? j - 1 : 0;
+            UINT colP = j + 2 < lastCol ? j + 2 : lastCol;
+            UINT rowM = (i > 0 ? i - 1 : 0) * pitch;
+            UINT rowP = (i + 2 < lastRow ? i + 2 : lastRow) * pitch;
+
+            bool top = i > 0;
+            bool bottom = i + 1 < lastRow;
+            bool left = j > 0;
+            bool right = j + 1 < lastCol;
+
+            float sx00 = top && left ? H[row0 + colM] - h01 : 0.0f;
+            float sz00 = top && left ? h10 - H[rowM + j] : 0.0f;
+            float sx01 = top && right ? h00 - H[row0 + colP] : 0.0f;
+            float sz01 = top && right ? h11 - H[rowM + j + 1] : 0.0f;
+            float sx10 = bottom && left ? H[row1 + colM] - h11 : 0.0f;
+            float sz10 = bottom && left ? H[rowP + j] - h00 : 0.0f;
+            float sx11 = bottom && right ? h10 - H[row1 + colP] : 0.0f;
+            float sz11 = bottom && right ? H[rowP + j + 1] - h01 : 0.0f;
+
+            float ax = Lerp(Lerp(sx00, sx01, fx), Lerp(sx10, sx11, fx), fz);
+            float az = Lerp(Lerp(sz00, sz01, fx), Lerp(sz10, sz11, fx), fz);
+            float len = sqrtf((ax * ax + field.TwoDx * field.TwoDx) + az * az);
+            nx[k] = ax / len;
+            ny[k] = field.TwoDx / len;
+            nz[k] = az / len;
+        }
+    }
+
+    SIMD_TARGET_AVX2 inline __m256 Lerp8(__m256 a, __m256 b, __m256 t)
+    {
+        return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+    }
+
+    SIMD_TARGET_AVX2 inline __m256 Gather8(const float* base, __m256i index)
+    {
+        return _mm256_i32gather_ps(base, index, 4);
+    }
+
+    SIMD_TARGET_AVX2 void SampleAVX2(const WavesKernels::HeightField& field, const float* x, const float* z, UINT count,
+        float* h, float* nx, float* ny, float* nz)
+    {
+        const float* H = field.Heights;
+        __m256 x0 = _mm256_set1_ps(field.X0);
+        __m256 z0 = _mm256_set1_ps(field.Z0);
+        __m256 y0 = _mm256_set1_ps(field.Y0);
+        __m256 invDx = _mm256_set1_ps(field.InvDx);
+        __m256 twoDx = _mm256_set1_ps(field.TwoDx);
+        __m256 twoDxSq = _mm256_mul_ps(twoDx, twoDx);
+        __m256 maxU = _mm256_set1_ps(static_cast<float>(field.ColumnCount - 1));
+        __m256 maxV = _mm256_set1_ps(static_cast<float>(field.RowCount - 1));
+        __m256 zero = _mm256_setzero_ps();
+
+        __m256i pitch = _mm256_set1_epi32(static_cast<int>(field.Pitch));
+        __m256i one = _mm256_set1_epi32(1);
+        __m256i two = _mm256_set1_epi32(2);
+        __m256i zeroi = _mm256_setzero_si256();
+        __m256i lastCol = _mm256_set1_epi32(static_cast<int>(field.ColumnCount - 1));
+        __m256i lastRow = _mm256_set1_epi32(static_cast<int>(field.RowCount - 1));
+        __m256i maxJ = _mm256_sub_epi32(lastCol, one);
+        __m256i maxI = _mm256_sub_epi32(lastRow, one);
+
+        UINT k = 0;
+        for (; k + 8 <= count; k += 8)
+        {
+            __m256 u = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + k), x0), invDx);
+            __m256 v = _mm256_mul_ps(_mm256_sub_ps(z0, _mm256_loadu_ps(z + k)), invDx);
+            u = _mm256_min_ps(_mm256_max_ps(u, zero), maxU);
+            v = _mm256_min_ps(_mm256_max_ps(v, zero), maxV);
+
+            __m256i j = _mm256_min_epi32(_mm256_cvttps_epi32(u), maxJ);
+            __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(v), maxI);
+            __m256 fx = _mm256_sub_ps(u, _mm256_cvtepi32_ps(j));
+            __m256 fz = _mm256_sub_ps(v, _mm256_cvtepi32_ps(i));
+
+            __m256i row0 = _mm256_mullo_epi32(i, pitch);
+            __m256i row1 = _mm256_add_epi32(row0, pitch);
+            __m256i p00 = _mm256_add_epi32(row0, j);
+            __m256i p10 = _mm256_add_epi32(row1, j);
+            __m256 h00 = Gather8(H, p00);
+            __m256 h01 = Gather8(H + 1, p00);
+            __m256 h10 = Gather8(H, p10);
+            __m256 h11 = Gather8(H + 1, p10);
+            _mm256_storeu_ps(h + k, _mm256_add_ps(Lerp8(Lerp8(h00, h01, fx), Lerp8(h10, h11, fx), fz), y0));
+
+            if (!nx)
+            {
+                continue;
+            }
+
+            __m256i colM = _mm256_max_epi32(_mm256_sub_epi32(j, one), zeroi);
+            __m256i colP = _mm256_min_epi32(_mm256_add_epi32(j, two), lastCol);
+            __m256i rowM = _mm256_mullo_epi32(_mm256_max_epi32(_mm256_sub_epi32(i, one), zeroi), pitch);
+            __m256i rowP = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_add_epi32(i, two), lastRow), pitch);
+
+            __m256i top = _mm256_cmpgt_epi32(i, zeroi);
+            __m256i bottom = _mm256_cmpgt_epi32(maxI, i);
+            __m256i left = _mm256_cmpgt_epi32(j, zeroi);
+            __m256i right = _mm256_cmpgt_epi32(maxJ, j);
+            __m256 m00 = _mm256_castsi256_ps(_mm256_and_si256(top, left));
+            __m256 m01 = _mm256_castsi256_ps(_mm256_and_si256(top, right));
+            __m256 m10 = _mm256_castsi256_ps(_mm256_and_si256(bottom, left));
+            __m256 m11 = _mm256_castsi256_ps(_mm256_and_si256(bottom, right));
+
+            __m256 sx00 = _mm256_and_ps(m00, _mm256_sub_ps(Gather8(H, _mm256_add_epi32(row0, colM)), h01));
+            __m256 sz00 = _mm256_and_ps(m00, _mm256_sub_ps(h10, Gather8(H, _mm256_add_epi32(rowM, j))));
+            __m256 sx01 = _mm256_and_ps(m01, _mm256_sub_ps(h00, Gather8(H, _mm256_add_epi32(row0, colP))));
+            __m256 sz01 = _mm256_and_ps(m01, _mm256_sub_ps(h11, Gather8(H + 1, _mm256_add_epi32(rowM, j))));
+            __m256 sx10 = _mm256_and_ps(m10, _mm256_sub_ps(Gather8(H, _mm256_add_epi32(row1, colM)), h11));
+            __m256 sz10 = _mm256_and_ps(m10, _mm256_sub_ps(Gather8(H, _mm256_add_epi32(rowP, j)), h00));
+            __m256 sx11 = _mm256_and_ps(m11, _mm256_sub_ps(h10, Gather8(H, _mm256_add_epi32(row1, colP))));
+            __m256 sz11 = _mm256_and_ps(m11, _mm256_sub_ps(Gather8(H + 1, _mm256_add_epi32(rowP, j)), h01));
+
+            __m256 ax = Lerp8(Lerp8(sx00, sx01, fx), Lerp8(sx10, sx11, fx), fz);
+            __m256 az = Lerp8(Lerp8(sz00, sz01, fx), Lerp8(sz10, sz11, fx), fz);
+            __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, ax), twoDxSq), _mm256_mul_ps(az, az)));
+            _mm256_storeu_ps(nx + k, _mm256_div_ps(ax, len));
+            _mm256_storeu_ps(ny + k, _mm256_div_ps(twoDx, len));
+            _mm256_storeu_ps(nz + k, _mm256_div_ps(az, len));
+        }
+
+        SampleScalar(field, x + k, z + k, count - k, h + k,
+            nx ? nx + k : nullptr, ny ? ny + k : nullptr, nz ? nz + k : nullptr);
+    }
+
+    SIMD_TARGET_AVX512 inline __m512 Lerp16(__m512 a, __m512 b, __m512 t)
+    {
+        return _mm512_add_ps(a, _mm512_mul_ps(t, _mm512_sub_ps(b, a)));
+    }
+
+    // The tail lanes load zeros, which clamp to a valid cell, so every gather
+    // stays inside the grid and only the stores are masked.
+    SIMD_TARGET_AVX512 void SampleAVX512(const WavesKernels::HeightField& field, const float* x, const float* z, UINT count,
+        float* h, float* nx, float* ny, float* nz)
+    {
+        const float* H = field.Heights;
+        __m512 x0 = _mm512_set1_ps(field.X0);
+        __m512 z0 = _mm512_set1_ps(field.Z0);
+        __m512 y0 = _mm512_set1_ps(field.Y0);
+        __m512 invDx = _mm512_set1_ps(field.InvDx);
+        __m512 twoDx = _mm512_set1_ps(field.TwoDx);
+        __m512 twoDxSq = _mm512_mul_ps(twoDx, twoDx);
+        __m512 maxU = _mm512_set1_ps(static_cast<float>(field.ColumnCount - 1));
+        __m512 maxV = _mm512_set1_ps(static_cast<float>(field.RowCount - 1));
+        __m512 zero = _mm512_setzero_ps();
+
+        __m512i pitch = _mm512_set1_epi32(static_cast<int>(field.Pitch));
+        __m512i one = _mm512_set1_epi32(1);
+        __m512i two = _mm512_set1_epi32(2);
+        __m512i zeroi = _mm512_setzero_si512();
+        __m512i lastCol = _mm512_set1_epi32(static_cast<int>(field.ColumnCount - 1));
+        __m512i lastRow = _mm512_set1_epi32(static_cast<int>(field.RowCount - 1));
+        __m512i maxJ = _mm512_sub_epi32(lastCol, one);
+        __m512i maxI = _mm512_sub_epi32(lastRow, one);
+
+        for (UINT k = 0; k < count; k += 16)
+        {
+            __mmask16 mask = count - k >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - k)) - 1);
+
+            __m512 u = _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + k), x0), invDx);
+            __m512 v = _mm512_mul_ps(_mm512_sub_ps(z0, _mm512_maskz_loadu_ps(mask, z + k)), invDx);
+            u = _mm512_min_ps(_mm512_max_ps(u, zero), maxU);
+            v = _mm512_min_ps(_mm512_max_ps(v, zero), maxV);
+
+            __m512i j = _mm512_min_epi32(_mm512_cvttps_epi32(u), maxJ);
+            __m512i i = _mm512_min_epi32(_mm512_cvttps_epi32(v), maxI);
+            __m512 fx = _mm512_sub_ps(u, _mm512_cvtepi32_ps(j));
+            __m512 fz = _mm512_sub_ps(v, _mm512_cvtepi32_ps(i));
+
+            __m512i row0 = _mm512_mullo_epi32(i, pitch);
+            __m512i row1 = _mm512_add_epi32(row0, pitch);
+            __m512i p00 = _mm512_add_epi32(row0, j);
+            __m512i p10 = _mm512_add_epi32(row1, j);
+            __m512 h00 = _mm512_i32gather_ps(p00, H, 4);
+            __m512 h01 = _mm512_i32gather_ps(p00, H + 1, 4);
+            __m512 h10 = _mm512_i32gather_ps(p10, H, 4);
+            __m512 h11 = _mm512_i32gather_ps(p10, H + 1, 4);
+            _mm512_mask_storeu_ps(h + k, mask, _mm512_add_ps(Lerp16(Lerp16(h00, h01, fx), Lerp16(h10, h11, fx), fz), y0));
+
+            if (!nx)
+            {
+                continue;
+            }
+
+            __m512i colM = _mm512_max_epi32(_mm512_sub_epi32(j, one), zeroi);
+            __m512i colP = _mm512_min_epi32(_mm512_add_epi32(j, two), lastCol);
+            __m512i rowM = _mm512_mullo_epi32(_mm512_max_epi32(_mm512_sub_epi32(i, one), zeroi), pitch);
+            __m512i rowP = _mm512_mullo_epi32(_mm512_min_epi32(_mm512_add_epi32(i, two), lastRow), pitch);
+
+            __mmask16 top = _mm512_cmpgt_epi32_mask(i, zeroi);
+            __mmask16 bottom = _mm512_cmpgt_epi32_mask(maxI, i);
+            __mmask16 left = _mm512_cmpgt_epi32_mask(j, zeroi);
+            __mmask16 right = _mm512_cmpgt_epi32_mask(maxJ, j);
+            __mmask16 m00 = top & left;
+            __mmask16 m01 = top & right;
+            __mmask16 m10 = bottom & left;
+            __mmask16 m11 = bottom & right;
+
+            __m512 sx00 = _mm512_maskz_sub_ps(m00, _mm512_i32gather_ps(_mm512_add_epi32(row0, colM), H, 4), h01);
+            __m512 sz00 = _mm512_maskz_sub_ps(m00, h10, _mm512_i32gather_ps(_mm512_add_epi32(rowM, j), H, 4));
+            __m512 sx01 = _mm512_maskz_sub_ps(m01, h00, _mm512_i32gather_ps(_mm512_add_epi32(row0, colP), H, 4));
+            __m512 sz01 = _mm512_maskz_sub_ps(m01, h11, _mm512_i32gather_ps(_mm512_add_epi32(rowM, j), H + 1, 4));
+            __m512 sx10 = _mm512_maskz_sub_ps(m10, _mm512_i32gather_ps(_mm512_add_epi32(row1, colM), H, 4), h11);
+            __m512 sz10 = _mm512_maskz_sub_ps(m10, _mm512_i32gather_ps(_mm512_add_epi32(rowP, j), H, 4), h00);
+            __m512 sx11 = _mm512_maskz_sub_ps(m11, h10, _mm512_i32gather_ps(_mm512_add_epi32(row1, colP), H, 4));
+            __m512 sz11 = _mm512_maskz_sub_ps(m11, _mm512_i32gather_ps(_mm512_add_epi32(rowP, j), H + 1, 4), h01);
+
+            __m512 ax = Lerp16(Lerp16(sx00, sx01, fx), Lerp16(sx10, sx11, fx), fz);
+            __m512 az = Lerp16(Lerp16(sz00, sz01, fx), Lerp16(sz10, sz11, fx), fz);
+            __m512 len = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ax, ax), twoDxSq), _mm512_mul_ps(az, az)));
+            _mm512_mask_storeu_ps(nx + k, mask, _mm512_div_ps(ax, len));
+            _mm512_mask_storeu_ps(ny + k, mask, _mm512_div_ps(twoDx, len));
+            _mm512_mask_storeu_ps(nz + k, mask, _mm512_div_ps(az, len));
+        }
+    }
+
+    //
+    // CPU feature detection.
+    //
+
+    void CpuId(int leaf, int subLeaf, int regs[4])
+    {
+#if defined(_MSC_VER)
+        __cpuidex(regs, leaf, subLeaf);
+#else
+        unsigned int a = 0, b = 0, c = 0, d = 0;
+        __cpuid_count(leaf, subLeaf, a, b, c, d);
+        regs[0] = static_cast<int>(a);
+        regs[1] = static_cast<int>(b);
+        regs[2] = static_cast<int>(c);
+        regs[3] = static_cast<int>(d);
+#endif
+    }
+
+    unsigned long long ReadXcr0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned int lo = 0, hi = 0;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    }
+}
+
+SIMD_FP_CONTRACT_OFF_END
+
+WavesKernels::WavesKernels()
+    : Level(Isa::Scalar), StepRow(StepRowScalar), NormalRow(NormalRowScalar)
+    , NormalRowFast(NormalRowFastScalar), Sample(SampleScalar)
+{
+}
+
+WavesKernels::Isa WavesKernels::DetectIsa()
+{
+    int regs[4];
+    CpuId(0, 0, regs);
+    int maxLeaf = regs[0];
+
+    CpuId(1, 0, regs);
+    bool sse2 = (regs[3] & (1 << 26)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+
+    if (!sse2)
+    {
+        return Isa::Scalar;
+    }
+
+    if (!osxsave || !avx || maxLeaf < 7)
+    {
+        return Isa::SSE2;
+    }
+
+    // The OS must save the YMM (bits 1-2) and ZMM/opmask (bits 5-7) state.
+    unsigned long long xcr0 = ReadXcr0();
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+    CpuId(7, 0, regs);
+    bool avx2 = (regs[1] & (1 << 5)) != 0;
+    bool avx512f = (regs[1] & (1 << 16)) != 0;
+
+    if (avx512f && zmmState)
+    {
+        return Isa::AVX512;
+    }
+
+    if (avx2 && ymmState)
+    {
+        return Isa::AVX2;
+    }
+
+    return Isa::SSE2;
+}
+
+WavesKernels WavesKernels::Select(Isa isa)
+{
+    Isa supported = DetectIsa();
+    if (isa > supported)
+    {
+        isa = supported;
+    }
+
+    WavesKernels kernels;
+    kernels.Level = isa;
+
+    switch (isa)
+    {
+    case Isa::SSE2:
+        kernels.StepRow = StepRowSSE2;
+        kernels.NormalRow = NormalRowSSE2;
+        kernels.NormalRowFast = NormalRowFastSSE2;
+        break;
+    case Isa::AVX2:
+        kernels.StepRow = StepRowAVX2;
+        kernels.NormalRow = NormalRowAVX2;
+        kernels.NormalRowFast = NormalRowFastAVX2;
+        kernels.Sample = SampleAVX2;
+        break;
+    case Isa::AVX512:
+        kernels.StepRow = StepRowAVX512;
+        kernels.NormalRow = NormalRowAVX512;
+        kernels.NormalRowFast = NormalRowFastAVX512;
+        kernels.Sample = SampleAVX512;
+        break;
+    default:
+        break;
+    }
+
+    return kernels;
+}
+
+const char* WavesKernels::IsaName(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::SSE2:   return "SSE2";
+    case Isa::AVX2:   return "AVX2";
+    case Isa::AVX512: return "AVX-512";
+    default:          return "Scalar";
+    }
+}
@@ -0,0 +1,85 @@
+//***************************************************************************************
+// WavesKernels.h
+//
+// Row kernels for the Waves finite difference solver.  The scalar kernels are the
+// reference implementation; the SSE2, AVX2 and AVX-512 kernels process 4, 8 and 16
+// cells per instruction and are chosen at runtime from CPUID.
+//
+// Heights produced by the vector kernels are bit-for-bit identical to the scalar
+// kernels (same operations in the same order, no FMA contraction).  Normals and
+// tangents are identical to XMVector3Normalize's SSE2 path and within 1 ulp of
+// its SSE4/AVX dot-product path.  The NormalRowFast kernels trade that exactness
+// for a reciprocal square root estimate plus one Newton step.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+
+
+class WavesKernels
+{
+public:
+    enum class Isa
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+
+    // Advances one row of the wave equation in place:
+    //   prev[j] = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1])
+    // All pointers address the first interior column of their row.
+    typedef void (*StepRowFn)(float* prev, const float* curr, const float* up, const float* down,
+        UINT count, float k1, float k2, float k3);
+
+    // Computes the unit normal (l-r, 2dx, b-t) and unit x-tangent (2dx, r-l, 0) of one row
+    // from the heights of that row and its two neighbours.
+    typedef void (*NormalRowFn)(const float* curr, const float* up, const float* down,
+        UINT count, float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty);
+
+    // A grid of heights sampled by the Sample kernels.  Row i starts at
+    // Heights + i*Pitch; point (i, j) lies at x = X0 + j*dx, z = Z0 - i*dx, and Y0
+    // is added to every sampled height.
+    struct HeightField
+    {
+        const float* Heights;
+        UINT RowCount;
+        UINT ColumnCount;
+        UINT Pitch;
+        float X0;
+        float Z0;
+        float Y0;
+        float InvDx;
+        float TwoDx;
+    };
+
+    // Samples field at count points (x[k], z[k]), clamped to the grid.  h[k] is the
+    // bilinear blend of the four surrounding heights; the normal is the normalized
+    // bilinear blend of those points' unnormalized normals (l-r, 2dx, b-t), which
+    // are (0, 2dx, 0) on the boundary as in the solver.  nx, ny and nz may be null
+    // to skip normals.  The vector kernels gather the heights and give results
+    // identical to the scalar kernel.
+    typedef void (*SampleFn)(const HeightField& field, const float* x, const float* z, UINT count,
+        float* h, float* nx, float* ny, float* nz);
+
+    WavesKernels();
+
+    // Returns the kernels for the given instruction set, or for the widest one the
+    // CPU and OS support if that is lower.
+    static WavesKernels Select(Isa isa);
+
+    // Returns the widest instruction set usable on this machine.
+    static Isa DetectIsa();
+
+    static const char* IsaName(Isa isa);
+
+    Isa Level;
+    StepRowFn StepRow;
+    NormalRowFn NormalRow;
+    NormalRowFn NormalRowFast;
+
+    // SSE2 has no gather, so at that level Sample is the scalar kernel.
+    SampleFn Sample;
+};
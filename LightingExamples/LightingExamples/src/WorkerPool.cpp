@@ -0,0 +1,125 @@
+//***************************************************************************************
+// WorkerPool.cpp
+//***************************************************************************************
+
+#include "WorkerPool.h"
+
+namespace
+{
+    // The pool whose tasks the current thread is running, if any.
+    thread_local const WorkerPool* t_RunningPool = nullptr;
+}
+
+WorkerPool::WorkerPool(UINT threadCount)
+    : m_Task(nullptr), m_TaskCount(0), m_Generation(0), m_BusyWorkers(0), m_Quit(false)
+    , m_NextTask(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    for (UINT i = 1; i < threadCount; ++i)
+    {
+        m_Threads.emplace_back(&WorkerPool::WorkerMain, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Quit = true;
+    }
+    m_WorkReady.notify_all();
+
+    for (std::thread& thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(UINT taskCount, const std::function<void(UINT)>& task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+
+    // Nothing to hand out; skip the wake-up round trip.  A nested Run() would wait
+    // on workers that are busy with the outer one, so it runs inline too.
+    if (m_Threads.empty() || taskCount == 1 || t_RunningPool == this)
+    {
+        for (UINT i = 0; i < taskCount; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(m_RunMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Task = &task;
+        m_TaskCount = taskCount;
+        m_NextTask.store(0, std::memory_order_relaxed);
+        m_BusyWorkers = static_cast<UINT>(m_Threads.size());
+        ++m_Generation;
+    }
+    m_WorkReady.notify_all();
+
+    // The calling thread works too rather than sleeping.
+    const WorkerPool* outerPool = t_RunningPool;
+    t_RunningPool = this;
+    Drain();
+    t_RunningPool = outerPool;
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_WorkDone.wait(lock, [this] { return m_BusyWorkers == 0; });
+    m_Task = nullptr;
+}
+
+void WorkerPool::WorkerMain()
+{
+    t_RunningPool = this;
+
+    UINT seenGeneration = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WorkReady.wait(lock, [&] { return m_Quit || m_Generation != seenGeneration; });
+
+            if (m_Quit)
+            {
+                return;
+            }
+
+            seenGeneration = m_Generation;
+        }
+
+        Drain();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_BusyWorkers;
+        }
+        m_WorkDone.notify_one();
+    }
+}
+
+void WorkerPool::Drain()
+{
+    for (;;)
+    {
+        UINT i = m_NextTask.fetch_add(1, std::memory_order_relaxed);
+        if (i >= m_TaskCount)
+        {
+            return;
+        }
+
+        (*m_Task)(i);
+    }
+}
@@ -0,0 +1,104 @@
+//***************************************************************************************
+// WorkerPool.h
+//
+// A small fixed-size thread pool for data-parallel loops.  Run() hands out task
+// indices to the workers and to the calling thread, and returns once every task
+// has finished.  One pool can be shared by several systems (e.g. multiple Waves), on
+// any threads: concurrent Run() calls take turns, and a Run() made from inside one of
+// the pool's own tasks runs its tasks inline on that thread.
+//***************************************************************************************
+
+#pragma once
+
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkerPool
+{
+public:
+    // threadCount includes the calling thread, so WorkerPool(1) runs everything inline.
+    // Zero picks one thread per hardware thread.
+    explicit WorkerPool(UINT threadCount = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    UINT ThreadCount() const { return static_cast<UINT>(m_Threads.size()) + 1; }
+
+    // Calls task(i) for every i in [0, taskCount) and blocks until all calls return.
+    void Run(UINT taskCount, const std::function<void(UINT)>& task);
+
+    // Fewest grid rows worth handing to another thread: below this the hand-off
+    // costs more than stepping the rows.
+    static const UINT MinBandRows = 16;
+
+    // Number of bands ForEachBand() splits count items into: one per thread, as long
+    // as each gets minPerBand items, and 1 without a pool.
+    static UINT BandCount(const WorkerPool* pool, UINT count, UINT minPerBand);
+
+    // Splits [begin, end) into BandCount() bands of consecutive items and calls
+    // body(bandBegin, bandEnd, band) for each, one band per task.  pool may be null,
+    // and a single band is run on the calling thread.
+    template<typename Body>
+    static void ForEachBand(WorkerPool* pool, UINT begin, UINT end, UINT minPerBand, const Body& body);
+
+private:
+    void WorkerMain();
+    void Drain();
+
+    std::vector<std::thread> m_Threads;
+
+    // Held for the whole of a Run() that hands tasks to the workers.
+    std::mutex m_RunMutex;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkReady;
+    std::condition_variable m_WorkDone;
+
+    const std::function<void(UINT)>* m_Task;
+    UINT m_TaskCount;
+    UINT m_Generation;
+    UINT m_BusyWorkers;
+    bool m_Quit;
+
+    // Claimed by every thread on each task, so keep it off the lines above.
+    alignas(64) std::atomic<UINT> m_NextTask;
+};
+
+
+inline UINT WorkerPool::BandCount(const WorkerPool* pool, UINT count, UINT minPerBand)
+{
+    return pool ? std::max(1u, std::min(pool->ThreadCount(), count / minPerBand)) : 1;
+}
+
+template<typename Body>
+void WorkerPool::ForEachBand(WorkerPool* pool, UINT begin, UINT end, UINT minPerBand, const Body& body)
+{
+    UINT count = end - begin;
+    UINT bandCount = BandCount(pool, count, minPerBand);
+
+    if (bandCount == 1)
+    {
+        body(begin, end, 0u);
+        return;
+    }
+
+    UINT bandItems = (count + bandCount - 1) / bandCount;
+    pool->Run(bandCount, [&](UINT band)
+    {
+        UINT bandBegin = begin + band * bandItems;
+        UINT bandEnd = std::min(bandBegin + bandItems, end);
+        if (bandBegin < bandEnd)
+        {
+            body(bandBegin, bandEnd, band);
+        }
+    });
+}